@@ -46,8 +46,11 @@
 #include "workqueue.h"
 #include "lib/mountcheck.h"
 #include "rate-submit.h"
+#include "sync-pool.h"
+#include "heatmap.h"
 #include "helper_thread.h"
 #include "pshared.h"
+#include "phase.h"
 #include "zone-dist.h"
 
 static struct fio_sem *startup_sem;
@@ -411,6 +414,7 @@ static void check_update_rusage(struct thread_data *td)
 	if (td->update_rusage) {
 		td->update_rusage = 0;
 		update_rusage_stat(td);
+		rate_submit_update_stats(td);
 		fio_sem_up(td->rusage_sem);
 	}
 }
@@ -845,8 +849,23 @@ static long long usec_for_io(struct thread_data *td, enum fio_ddir ddir)
 		uint64_t bytes = td->rate_io_issue_bytes[ddir];
 		uint64_t secs = bytes / bps;
 		uint64_t remainder = bytes % bps;
+		uint64_t usec;
 
-		return remainder * 1000000 / bps + secs * 1000000;
+		usec = remainder * 1000000 / bps + secs * 1000000;
+
+		/*
+		 * For bursty, the linear schedule only runs during the on
+		 * periods. Stretch it out so that every on period is followed
+		 * by an idle off period.
+		 */
+		if (td->o.rate_process == RATE_PROCESS_BURSTY) {
+			uint64_t on = td->o.rate_burst_on;
+
+			usec = (usec / on) * (on + td->o.rate_burst_off) +
+				usec % on;
+		}
+
+		return usec;
 	}
 
 	return 0;
@@ -955,6 +974,8 @@ static void do_io(struct thread_data *td, uint64_t *bytes_done)
 		td_set_runstate(td, TD_RUNNING);
 
 	lat_target_init(td);
+	iodepth_sweep_init(td);
+	phases_init(td);
 
 	total_bytes = td->o.size;
 	/*
@@ -1039,6 +1060,18 @@ static void do_io(struct thread_data *td, uint64_t *bytes_done)
 
 		ddir = io_u->ddir;
 
+		/*
+		 * With an open loop rate, note when the schedule wanted this IO
+		 * to arrive. If we're behind, the time it spent waiting for us
+		 * to get to it is then included in its latency.
+		 */
+		if (td->o.rate_open_loop && ddir_rw(ddir)) {
+			io_u->arrival_time = td->epoch;
+			timespec_add_usec(&io_u->arrival_time,
+					  td->rate_next_io_time[ddir]);
+			io_u_set(td, io_u, IO_U_F_ARRIVAL);
+		}
+
 		/*
 		 * Add verification end_io handler if:
 		 *	- Asked to verify (!td_rw(td))
@@ -1134,6 +1167,10 @@ reap:
 		}
 		if (!in_ramp_time(td) && td->o.latency_target)
 			lat_target_check(td);
+		if (!in_ramp_time(td) && td->o.iodepth_sweep_nr)
+			iodepth_sweep_check(td);
+		if (!in_ramp_time(td) && td->nr_phases)
+			phases_check(td);
 	}
 
 	check_update_rusage(td);
@@ -1161,6 +1198,9 @@ reap:
 				td->error = 0;
 		}
 
+		iodepth_sweep_end(td);
+		phases_end(td);
+
 		if (should_fsync(td) && (td->o.end_fsync || td->o.fsync_on_close)) {
 			td_set_runstate(td, TD_FSYNCING);
 
@@ -1227,6 +1267,8 @@ static void cleanup_io_u(struct thread_data *td)
 {
 	struct io_u *io_u;
 
+	io_u_ssplice(&td->io_u_returns, &td->io_u_freelist);
+
 	while ((io_u = io_u_qpop(&td->io_u_freelist)) != NULL) {
 
 		if (td->io_ops->io_u_free)
@@ -1256,6 +1298,7 @@ static int init_io_u(struct thread_data *td)
 	err += !io_u_rinit(&td->io_u_requeues, td->o.iodepth);
 	err += !io_u_qinit(&td->io_u_freelist, td->o.iodepth, false);
 	err += !io_u_qinit(&td->io_u_all, td->o.iodepth, td_offload_overlap(td));
+	td->io_u_returns.head = NULL;
 
 	if (err) {
 		log_err("fio: failed setting up IO queues\n");
@@ -1724,6 +1767,7 @@ static void *thread_main(void *data)
 	if (fio_option_is_set(o, numa_cpunodes) ||
 	    fio_option_is_set(o, numa_memnodes)) {
 		struct bitmask *mask;
+		int node;
 
 		if (numa_available() < 0) {
 			td_verror(td, errno, "Does not support NUMA API\n");
@@ -1759,6 +1803,15 @@ static void *thread_main(void *data)
 			case MPOL_PREFERRED:
 				numa_set_preferred(o->numa_mem_prefer_node);
 				break;
+			case MPOL_DEVICE:
+				node = disk_util_numa_node(td);
+				if (node >= 0)
+					numa_set_preferred(node);
+				else {
+					log_info("fio: NUMA node of device not found, using local allocation\n");
+					numa_set_localalloc();
+				}
+				break;
 			case MPOL_DEFAULT:
 			default:
 				break;
@@ -1796,7 +1849,8 @@ static void *thread_main(void *data)
 	if (td_io_init(td))
 		goto err;
 
-	if (td_ioengine_flagged(td, FIO_SYNCIO) && td->o.iodepth > 1) {
+	if (td_ioengine_flagged(td, FIO_SYNCIO) && td->o.iodepth > 1 &&
+	    o->io_submit_mode != IO_MODE_POOL) {
 		log_info("note: both iodepth >= 1 and synchronous I/O engine "
 			 "are selected, queue depth will be capped at 1\n");
 	}
@@ -1810,6 +1864,9 @@ static void *thread_main(void *data)
 	if (o->verify_async && verify_async_init(td))
 		goto err;
 
+	if (o->io_submit_mode == IO_MODE_POOL && sync_pool_init(td))
+		goto err;
+
 	if (o->cgroup && cgroup_setup(td, cgroup_list, &cgroup_mnt))
 		goto err;
 
@@ -1828,6 +1885,15 @@ static void *thread_main(void *data)
 	if (!init_random_map(td))
 		goto err;
 
+	if (phases_setup(td))
+		goto err;
+
+	if (o->lat_heatmap && lat_heatmap_init(td))
+		goto err;
+
+	if (o->rate_open_loop && alloc_ilat_plat(&td->ts))
+		goto err;
+
 	if (o->exec_prerun && exec_string(o, o->exec_prerun, "prerun"))
 		goto err;
 
@@ -1987,6 +2053,7 @@ static void *thread_main(void *data)
 
 	iolog_compress_exit(td);
 	rate_submit_exit(td);
+	lat_heatmap_write(td);
 
 	if (o->exec_postrun)
 		exec_string(o, o->exec_postrun, "postrun");
@@ -2001,9 +2068,12 @@ err:
 
 	if (o->verify_async)
 		verify_async_exit(td);
+	sync_pool_exit(td);
 
 	close_and_free_files(td);
 	cleanup_io_u(td);
+	free(td->period_plat);
+	phases_free(td);
 	close_ioengine(td);
 	cgroup_shutdown(td, cgroup_mnt);
 	verify_free_state(td);
@@ -2430,6 +2500,8 @@ reap:
 
 			td->rusage_sem = fio_sem_init(FIO_SEM_LOCKED);
 			td->update_rusage = 0;
+			if (td->o.io_submit_mode == IO_MODE_OFFLOAD)
+				td->offload_ts = smalloc(sizeof(*td->offload_ts));
 
 			/*
 			 * Set state to created. Thread will transition
@@ -2636,6 +2708,9 @@ int fio_backend(struct sk_out *sk_out)
 		struct thread_stat *ts = &td->ts;
 
 		free_clat_prio_stats(ts);
+		free_ilat_plat(ts);
+		lat_heatmap_free(ts->heatmap);
+		ts->heatmap = NULL;
 		steadystate_free(td);
 		fio_options_free(td);
 		fio_dump_options_free(td);
@@ -2643,6 +2718,11 @@ int fio_backend(struct sk_out *sk_out)
 			fio_sem_remove(td->rusage_sem);
 			td->rusage_sem = NULL;
 		}
+		if (td->offload_ts) {
+			free_ilat_plat(td->offload_ts);
+			sfree(td->offload_ts);
+			td->offload_ts = NULL;
+		}
 		fio_sem_remove(td->sem);
 		td->sem = NULL;
 	}
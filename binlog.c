@@ -0,0 +1,207 @@
+/*
+ * Binary bw/iops/lat log writer, see binlog.h for the file layout.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "fio.h"
+#include "binlog.h"
+
+struct binlog {
+	FILE *f;
+	uint64_t pos;
+	uint64_t header_offset;
+	int log_offset;
+	int log_prio;
+	int err;
+
+	struct binlog_index *index;
+	unsigned int nr_chunks;
+	unsigned int max_chunks;
+};
+
+static const struct binlog_column binlog_columns[] = {
+	{ .id = BINLOG_COL_TIME,	.width = 8, },
+	{ .id = BINLOG_COL_VALUE,	.width = 8, },
+	{ .id = BINLOG_COL_BS,		.width = 8, },
+	{ .id = BINLOG_COL_OFFSET,	.width = 8, },
+	{ .id = BINLOG_COL_PRIO,	.width = 2, },
+	{ .id = BINLOG_COL_DDIR,	.width = 1, },
+};
+
+static void binlog_write(struct binlog *bl, const void *buf, size_t len)
+{
+	if (bl->err || !len)
+		return;
+
+	if (fwrite(buf, len, 1, bl->f) != 1) {
+		bl->err = errno ? errno : EIO;
+		log_err("fio: error writing binary log: %s\n",
+			strerror(bl->err));
+		return;
+	}
+
+	bl->pos += len;
+}
+
+static void binlog_pad(struct binlog *bl)
+{
+	static const uint8_t zero[8];
+
+	binlog_write(bl, zero, (8 - (bl->pos & 7)) & 7);
+}
+
+static bool binlog_has_column(struct binlog *bl, unsigned int id)
+{
+	return id != BINLOG_COL_OFFSET || bl->log_offset;
+}
+
+/*
+ * Start a new segment at the end of 'f' and write its header.
+ */
+struct binlog *binlog_open(FILE *f, int log_type, int log_offset, int log_prio)
+{
+	struct binlog_header *hdr;
+	struct binlog *bl;
+	unsigned int i, nr = 0;
+	off_t pos;
+
+	if (fseeko(f, 0, SEEK_END) < 0 || (pos = ftello(f)) < 0) {
+		log_err("fio: failed to seek binary log: %s\n",
+			strerror(errno));
+		return NULL;
+	}
+
+	bl = calloc(1, sizeof(*bl));
+	bl->f = f;
+	bl->pos = bl->header_offset = pos;
+	bl->log_offset = log_offset;
+	bl->log_prio = log_prio;
+
+	hdr = calloc(1, sizeof(*hdr) + sizeof(binlog_columns));
+	memcpy(hdr->magic, BINLOG_MAGIC, sizeof(hdr->magic));
+	hdr->version = __cpu_to_le32(BINLOG_VERSION);
+	hdr->log_type = __cpu_to_le32(log_type);
+	hdr->flags = __cpu_to_le32((log_offset ? BINLOG_F_OFFSET : 0) |
+				 (log_prio ? BINLOG_F_PRIO : 0));
+	for (i = 0; i < FIO_ARRAY_SIZE(binlog_columns); i++) {
+		if (!binlog_has_column(bl, binlog_columns[i].id))
+			continue;
+		hdr->columns[nr].id = cpu_to_le32(binlog_columns[i].id);
+		hdr->columns[nr].width = cpu_to_le32(binlog_columns[i].width);
+		nr++;
+	}
+	hdr->nr_columns = __cpu_to_le32(nr);
+
+	binlog_write(bl, hdr, sizeof(*hdr) + nr * sizeof(hdr->columns[0]));
+	free(hdr);
+	return bl;
+}
+
+static void binlog_fill_column(struct binlog *bl, unsigned int id,
+			       void *samples, uint64_t nr, void *buf)
+{
+	uint64_t *buf64 = buf;
+	uint16_t *buf16 = buf;
+	uint8_t *buf8 = buf;
+	struct io_sample *s;
+	uint64_t i;
+
+	for (i = 0; i < nr; i++) {
+		s = __get_sample(samples, bl->log_offset, i);
+
+		switch (id) {
+		case BINLOG_COL_TIME:
+			buf64[i] = cpu_to_le64(s->time);
+			break;
+		case BINLOG_COL_VALUE:
+			buf64[i] = cpu_to_le64(s->data.val);
+			break;
+		case BINLOG_COL_BS:
+			buf64[i] = cpu_to_le64(s->bs);
+			break;
+		case BINLOG_COL_OFFSET:
+			buf64[i] = cpu_to_le64(((struct io_sample_offset *) s)->offset);
+			break;
+		case BINLOG_COL_PRIO:
+			if (bl->log_prio)
+				buf16[i] = cpu_to_le16(s->priority);
+			else
+				buf16[i] = __cpu_to_le16(ioprio_value_is_class_rt(s->priority));
+			break;
+		case BINLOG_COL_DDIR:
+			buf8[i] = io_sample_ddir(s);
+			break;
+		}
+	}
+}
+
+/*
+ * Write 'sample_size' bytes worth of io_samples as one chunk.
+ */
+int binlog_write_samples(struct binlog *bl, void *samples, uint64_t sample_size)
+{
+	struct binlog_chunk chunk;
+	struct binlog_index *idx;
+	uint64_t nr;
+	unsigned int i;
+	void *buf;
+
+	nr = sample_size / __log_entry_sz(bl->log_offset);
+	if (!nr || bl->err)
+		return bl->err;
+
+	if (bl->nr_chunks == bl->max_chunks) {
+		bl->max_chunks = bl->max_chunks ? 2 * bl->max_chunks : 16;
+		bl->index = realloc(bl->index,
+				    bl->max_chunks * sizeof(*bl->index));
+	}
+
+	idx = &bl->index[bl->nr_chunks++];
+	idx->offset = cpu_to_le64(bl->pos);
+	idx->nr_samples = cpu_to_le64(nr);
+	idx->first_time = cpu_to_le64(__get_sample(samples, bl->log_offset, 0)->time);
+	idx->last_time = cpu_to_le64(__get_sample(samples, bl->log_offset, nr - 1)->time);
+
+	chunk.nr_samples = cpu_to_le64(nr);
+	binlog_write(bl, &chunk, sizeof(chunk));
+
+	buf = malloc(nr * sizeof(uint64_t));
+	for (i = 0; i < FIO_ARRAY_SIZE(binlog_columns); i++) {
+		const struct binlog_column *col = &binlog_columns[i];
+
+		if (!binlog_has_column(bl, col->id))
+			continue;
+
+		binlog_fill_column(bl, col->id, samples, nr, buf);
+		binlog_write(bl, buf, nr * col->width);
+		binlog_pad(bl);
+	}
+	free(buf);
+
+	return bl->err;
+}
+
+/*
+ * Finish the segment with its chunk index and trailer. The stream itself
+ * is left for the caller to close.
+ */
+int binlog_close(struct binlog *bl)
+{
+	struct binlog_trailer trailer;
+	int ret;
+
+	trailer.header_offset = cpu_to_le64(bl->header_offset);
+	trailer.index_offset = cpu_to_le64(bl->pos);
+	trailer.nr_chunks = __cpu_to_le64(bl->nr_chunks);
+	memcpy(trailer.magic, BINLOG_MAGIC, sizeof(trailer.magic));
+
+	binlog_write(bl, bl->index, bl->nr_chunks * sizeof(*bl->index));
+	binlog_write(bl, &trailer, sizeof(trailer));
+
+	ret = bl->err;
+	free(bl->index);
+	free(bl);
+	return ret;
+}
@@ -0,0 +1,78 @@
+#ifndef FIO_BINLOG_H
+#define FIO_BINLOG_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/*
+ * Binary format for bw/iops/lat logs (log_binary=1). All fields are little
+ * endian. A file holds one or more segments, since jobs may append to a
+ * shared log file. A segment is laid out as:
+ *
+ *	struct binlog_header, followed by nr_columns struct binlog_column
+ *	chunks, each a struct binlog_chunk followed by its columns
+ *	nr_chunks struct binlog_index entries
+ *	struct binlog_trailer
+ *
+ * Within a chunk, the values of each column are stored back to back, in
+ * the order given in the header, and every column is padded to a multiple
+ * of 8 bytes. Readers find the last segment through the trailer at the end
+ * of the file, and the one before it through header_offset.
+ */
+#define BINLOG_MAGIC		"fiobinlg"
+#define BINLOG_VERSION		1
+
+enum {
+	BINLOG_COL_TIME = 0,	/* msec */
+	BINLOG_COL_VALUE,
+	BINLOG_COL_BS,
+	BINLOG_COL_OFFSET,	/* only with log_offset */
+	BINLOG_COL_PRIO,
+	BINLOG_COL_DDIR,
+	BINLOG_COL_NR,
+};
+
+enum {
+	BINLOG_F_OFFSET		= 1U << 0,
+	BINLOG_F_PRIO		= 1U << 1,	/* prio is the full ioprio */
+};
+
+struct binlog_column {
+	uint32_t id;
+	uint32_t width;
+};
+
+struct binlog_header {
+	uint8_t magic[8];
+	uint32_t version;
+	uint32_t log_type;
+	uint32_t flags;
+	uint32_t nr_columns;
+	struct binlog_column columns[];
+};
+
+struct binlog_chunk {
+	uint64_t nr_samples;
+};
+
+struct binlog_index {
+	uint64_t offset;
+	uint64_t nr_samples;
+	uint64_t first_time;
+	uint64_t last_time;
+};
+
+struct binlog_trailer {
+	uint64_t header_offset;
+	uint64_t index_offset;
+	uint64_t nr_chunks;
+	uint8_t magic[8];
+};
+
+struct binlog;
+
+extern struct binlog *binlog_open(FILE *, int, int, int);
+extern int binlog_write_samples(struct binlog *, void *, uint64_t);
+extern int binlog_close(struct binlog *);
+
+#endif
@@ -47,6 +47,8 @@ static void free_thread_options_to_cpu(struct thread_options *o)
 	free(o->ioscheduler);
 	free(o->profile);
 	free(o->cgroup);
+	free(o->phases);
+	free(o->lat_heatmap_file);
 
 	free(o->verify_pattern);
 	free(o->buffer_pattern);
@@ -94,6 +96,8 @@ int convert_thread_options_to_cpu(struct thread_options *o,
 	string_to_cpu(&o->ioscheduler, top->ioscheduler);
 	string_to_cpu(&o->profile, top->profile);
 	string_to_cpu(&o->cgroup, top->cgroup);
+	string_to_cpu(&o->phases, top->phases);
+	string_to_cpu(&o->lat_heatmap_file, top->lat_heatmap_file);
 
 	o->allow_create = le32_to_cpu(top->allow_create);
 	o->allow_mounted_write = le32_to_cpu(top->allow_mounted_write);
@@ -212,6 +216,10 @@ int convert_thread_options_to_cpu(struct thread_options *o,
 	o->log_avg_msec = le32_to_cpu(top->log_avg_msec);
 	o->log_hist_msec = le32_to_cpu(top->log_hist_msec);
 	o->log_hist_coarseness = le32_to_cpu(top->log_hist_coarseness);
+	o->log_hist_sparse = le32_to_cpu(top->log_hist_sparse);
+	o->log_binary = le32_to_cpu(top->log_binary);
+	o->log_pctile_msec = le32_to_cpu(top->log_pctile_msec);
+	o->lat_heatmap = le32_to_cpu(top->lat_heatmap);
 	o->log_max = le32_to_cpu(top->log_max);
 	o->log_offset = le32_to_cpu(top->log_offset);
 	o->log_prio = le32_to_cpu(top->log_prio);
@@ -270,6 +278,8 @@ int convert_thread_options_to_cpu(struct thread_options *o,
 	o->loops = le32_to_cpu(top->loops);
 	o->mem_type = le32_to_cpu(top->mem_type);
 	o->mem_align = le32_to_cpu(top->mem_align);
+	o->sg_segments = le32_to_cpu(top->sg_segments);
+	o->sg_segment_size = le32_to_cpu(top->sg_segment_size);
 	o->exit_what = le32_to_cpu(top->exit_what);
 	o->stonewall = le32_to_cpu(top->stonewall);
 	o->new_group = le32_to_cpu(top->new_group);
@@ -320,6 +330,12 @@ int convert_thread_options_to_cpu(struct thread_options *o,
 	o->latency_window = le64_to_cpu(top->latency_window);
 	o->latency_percentile.u.f = fio_uint64_to_double(le64_to_cpu(top->latency_percentile.u.i));
 	o->latency_run = le32_to_cpu(top->latency_run);
+	o->iodepth_sweep_nr = le32_to_cpu(top->iodepth_sweep_nr);
+	for (i = 0; i < IODEPTH_SWEEP_MAX; i++)
+		o->iodepth_sweep[i] = le32_to_cpu(top->iodepth_sweep[i]);
+	o->iodepth_sweep_time = le64_to_cpu(top->iodepth_sweep_time);
+	o->stage_cycles = le32_to_cpu(top->stage_cycles);
+	o->create_threads = le32_to_cpu(top->create_threads);
 	o->compress_percentage = le32_to_cpu(top->compress_percentage);
 	o->compress_chunk = le32_to_cpu(top->compress_chunk);
 	o->dedupe_percentage = le32_to_cpu(top->dedupe_percentage);
@@ -340,6 +356,9 @@ int convert_thread_options_to_cpu(struct thread_options *o,
 	o->trim_backlog = le64_to_cpu(top->trim_backlog);
 	o->rate_process = le32_to_cpu(top->rate_process);
 	o->rate_ign_think = le32_to_cpu(top->rate_ign_think);
+	o->rate_burst_on = le32_to_cpu(top->rate_burst_on);
+	o->rate_burst_off = le32_to_cpu(top->rate_burst_off);
+	o->rate_open_loop = le32_to_cpu(top->rate_open_loop);
 
 	for (i = 0; i < FIO_IO_U_LIST_MAX_LEN; i++)
 		o->percentile_list[i].u.f = fio_uint64_to_double(le64_to_cpu(top->percentile_list[i].u.i));
@@ -388,6 +407,8 @@ void convert_thread_options_to_net(struct thread_options_pack *top,
 	string_to_net(top->ioscheduler, o->ioscheduler);
 	string_to_net(top->profile, o->profile);
 	string_to_net(top->cgroup, o->cgroup);
+	string_to_net(top->phases, o->phases);
+	string_to_net(top->lat_heatmap_file, o->lat_heatmap_file);
 
 	top->allow_create = cpu_to_le32(o->allow_create);
 	top->allow_mounted_write = cpu_to_le32(o->allow_mounted_write);
@@ -444,6 +465,12 @@ void convert_thread_options_to_net(struct thread_options_pack *top,
 	top->rand_seed = __cpu_to_le64(o->rand_seed);
 	top->log_entries = cpu_to_le32(o->log_entries);
 	top->log_avg_msec = cpu_to_le32(o->log_avg_msec);
+	top->log_hist_msec = cpu_to_le32(o->log_hist_msec);
+	top->log_hist_coarseness = cpu_to_le32(o->log_hist_coarseness);
+	top->log_hist_sparse = cpu_to_le32(o->log_hist_sparse);
+	top->log_binary = cpu_to_le32(o->log_binary);
+	top->log_pctile_msec = cpu_to_le32(o->log_pctile_msec);
+	top->lat_heatmap = cpu_to_le32(o->lat_heatmap);
 	top->log_max = cpu_to_le32(o->log_max);
 	top->log_offset = cpu_to_le32(o->log_offset);
 	top->log_prio = cpu_to_le32(o->log_prio);
@@ -480,6 +507,8 @@ void convert_thread_options_to_net(struct thread_options_pack *top,
 	top->loops = cpu_to_le32(o->loops);
 	top->mem_type = cpu_to_le32(o->mem_type);
 	top->mem_align = cpu_to_le32(o->mem_align);
+	top->sg_segments = cpu_to_le32(o->sg_segments);
+	top->sg_segment_size = cpu_to_le32(o->sg_segment_size);
 	top->exit_what = cpu_to_le32(o->exit_what);
 	top->stonewall = cpu_to_le32(o->stonewall);
 	top->new_group = cpu_to_le32(o->new_group);
@@ -531,6 +560,12 @@ void convert_thread_options_to_net(struct thread_options_pack *top,
 	top->latency_window = __cpu_to_le64(o->latency_window);
 	top->latency_percentile.u.i = __cpu_to_le64(fio_double_to_uint64(o->latency_percentile.u.f));
 	top->latency_run = __cpu_to_le32(o->latency_run);
+	top->iodepth_sweep_nr = cpu_to_le32(o->iodepth_sweep_nr);
+	for (i = 0; i < IODEPTH_SWEEP_MAX; i++)
+		top->iodepth_sweep[i] = cpu_to_le32(o->iodepth_sweep[i]);
+	top->iodepth_sweep_time = __cpu_to_le64(o->iodepth_sweep_time);
+	top->stage_cycles = cpu_to_le32(o->stage_cycles);
+	top->create_threads = cpu_to_le32(o->create_threads);
 	top->compress_percentage = cpu_to_le32(o->compress_percentage);
 	top->compress_chunk = cpu_to_le32(o->compress_chunk);
 	top->dedupe_percentage = cpu_to_le32(o->dedupe_percentage);
@@ -629,6 +664,9 @@ void convert_thread_options_to_net(struct thread_options_pack *top,
 	top->number_ios = __cpu_to_le64(o->number_ios);
 	top->rate_process = cpu_to_le32(o->rate_process);
 	top->rate_ign_think = cpu_to_le32(o->rate_ign_think);
+	top->rate_burst_on = cpu_to_le32(o->rate_burst_on);
+	top->rate_burst_off = cpu_to_le32(o->rate_burst_off);
+	top->rate_open_loop = cpu_to_le32(o->rate_open_loop);
 
 	for (i = 0; i < FIO_IO_U_LIST_MAX_LEN; i++)
 		top->percentile_list[i].u.i = __cpu_to_le64(fio_double_to_uint64(o->percentile_list[i].u.f));
@@ -22,6 +22,7 @@
 #include "flist.h"
 #include "hash.h"
 #include "verify-state.h"
+#include "binlog.h"
 
 static void handle_du(struct fio_client *client, struct fio_net_cmd *cmd);
 static void handle_ts(struct fio_client *client, struct fio_net_cmd *cmd);
@@ -951,6 +952,21 @@ static void convert_io_stat(struct io_stat *dst, struct io_stat *src)
 	dst->S.u.f	= fio_uint64_to_double(le64_to_cpu(dst->S.u.i));
 }
 
+static void convert_period_stat(struct period_stat *dst,
+				struct period_stat *src)
+{
+	int i;
+
+	dst->depth	= le32_to_cpu(src->depth);
+	dst->start	= le64_to_cpu(src->start);
+	dst->runtime	= le64_to_cpu(src->runtime);
+	dst->ios	= le64_to_cpu(src->ios);
+	dst->bytes	= le64_to_cpu(src->bytes);
+	dst->clat_sum	= le64_to_cpu(src->clat_sum);
+	for (i = 0; i < FIO_IO_U_LIST_MAX_LEN; i++)
+		dst->clat_percentiles[i] = le64_to_cpu(src->clat_percentiles[i]);
+}
+
 static void convert_ts(struct thread_stat *dst, struct thread_stat *src)
 {
 	int i, j, k;
@@ -1017,6 +1033,7 @@ static void convert_ts(struct thread_stat *dst, struct thread_stat *src)
 	for (i = 0; i < DDIR_RWDIR_CNT; i++) {
 		dst->short_io_u[i]	= le64_to_cpu(src->short_io_u[i]);
 		dst->drop_io_u[i]	= le64_to_cpu(src->drop_io_u[i]);
+		dst->timeout_io_u[i]	= le64_to_cpu(src->timeout_io_u[i]);
 	}
 
 	dst->total_submit	= le64_to_cpu(src->total_submit);
@@ -1076,6 +1093,28 @@ static void convert_ts(struct thread_stat *dst, struct thread_stat *src)
 
 	dst->cachehit		= le64_to_cpu(src->cachehit);
 	dst->cachemiss		= le64_to_cpu(src->cachemiss);
+	dst->inline_complete	= le64_to_cpu(src->inline_complete);
+	dst->deferred_complete	= le64_to_cpu(src->deferred_complete);
+
+	for (i = 0; i < FIO_IO_U_SG_LAT_NR; i++)
+		convert_io_stat(&dst->sg_clat_stat[i], &src->sg_clat_stat[i]);
+	for (i = 0; i < DDIR_RWDIR_CNT; i++)
+		convert_io_stat(&dst->ilat_stat[i], &src->ilat_stat[i]);
+	if (dst->ilat_plat) {
+		for (i = 0; i < FIO_ILAT_PLAT_NR; i++)
+			dst->ilat_plat[i] = le64_to_cpu(src->ilat_plat[i]);
+	}
+
+	dst->nr_sweep_steps	= le32_to_cpu(src->nr_sweep_steps);
+	for (i = 0; i < IODEPTH_SWEEP_MAX; i++)
+		convert_period_stat(&dst->sweep_steps[i], &src->sweep_steps[i]);
+	dst->nr_phases		= le32_to_cpu(src->nr_phases);
+	for (i = 0; i < FIO_PHASES_MAX; i++)
+		convert_period_stat(&dst->phases[i], &src->phases[i]);
+
+	dst->cycles_per_msec	= le64_to_cpu(src->cycles_per_msec);
+	for (i = 0; i < FIO_STAGE_NR; i++)
+		dst->stage_cycles[i] = le64_to_cpu(src->stage_cycles[i]);
 }
 
 static void convert_gs(struct group_run_stats *dst, struct group_run_stats *src)
@@ -1386,14 +1425,15 @@ static void handle_eta(struct fio_client *client, struct fio_net_cmd *cmd)
 	fio_client_dec_jobs_eta(eta, client->ops->eta);
 }
 
-static void client_flush_hist_samples(FILE *f, int hist_coarseness, void *samples,
-				      uint64_t sample_size)
+static void client_flush_hist_samples(FILE *f, int hist_coarseness, bool sparse,
+				      void *samples, uint64_t sample_size)
 {
 	struct io_sample *s;
 	int log_offset;
 	uint64_t i, j, nr_samples;
 	struct io_u_plat_entry *entry;
 	uint64_t *io_u_plat;
+	uint64_t bins[FIO_IO_U_PLAT_NR];
 
 	int stride = 1 << hist_coarseness;
 
@@ -1413,17 +1453,26 @@ static void client_flush_hist_samples(FILE *f, int hist_coarseness, void *sample
 		entry = s->data.plat_entry;
 		io_u_plat = entry->io_u_plat;
 
-		fprintf(f, "%lu, %u, %llu, ", (unsigned long) s->time,
-						io_sample_ddir(s), (unsigned long long) s->bs);
-		for (j = 0; j < FIO_IO_U_PLAT_NR - stride; j += stride) {
-			fprintf(f, "%llu, ", (unsigned long long)hist_sum(j, stride, io_u_plat, NULL));
-		}
-		fprintf(f, "%llu\n", (unsigned long long)
-			hist_sum(FIO_IO_U_PLAT_NR - stride, stride, io_u_plat, NULL));
+		for (j = 0; j < FIO_IO_U_PLAT_NR; j += stride)
+			bins[j / stride] = hist_sum(j, stride, io_u_plat, NULL);
 
+		hist_print_sample(f, s, bins, FIO_IO_U_PLAT_NR / stride, sparse);
 	}
 }
 
+static void client_flush_binlog(FILE *f, struct cmd_iolog_pdu *pdu)
+{
+	struct binlog *bl;
+
+	bl = binlog_open(f, pdu->log_type, pdu->log_offset, pdu->log_prio);
+	if (!bl)
+		return;
+
+	binlog_write_samples(bl, pdu->samples,
+			     pdu->nr_samples * __log_entry_sz(pdu->log_offset));
+	binlog_close(bl);
+}
+
 static int fio_client_handle_iolog(struct fio_client *client,
 				   struct fio_net_cmd *cmd)
 {
@@ -1477,7 +1526,8 @@ static int fio_client_handle_iolog(struct fio_client *client,
 		ret = 0;
 	} else {
 		FILE *f;
-		f = fopen((const char *) log_pathname, "w");
+		f = fopen((const char *) log_pathname,
+				pdu->log_binary ? "wb" : "w");
 		if (!f) {
 			log_err("fio: fopen log %s : %s\n",
 				log_pathname, strerror(errno));
@@ -1486,8 +1536,14 @@ static int fio_client_handle_iolog(struct fio_client *client,
 		}
 
 		if (pdu->log_type == IO_LOG_TYPE_HIST) {
-			client_flush_hist_samples(f, pdu->log_hist_coarseness, pdu->samples,
-					   pdu->nr_samples * sizeof(struct io_sample));
+			client_flush_hist_samples(f, pdu->log_hist_coarseness,
+					pdu->log_hist_sparse, pdu->samples,
+					pdu->nr_samples * sizeof(struct io_sample));
+		} else if (pdu->log_type == IO_LOG_TYPE_PCTILE) {
+			flush_pctile_samples(f, pdu->samples,
+					pdu->nr_samples * sizeof(struct io_sample));
+		} else if (pdu->log_binary) {
+			client_flush_binlog(f, pdu);
 		} else {
 			flush_samples(f, pdu->samples,
 					pdu->nr_samples * sizeof(struct io_sample));
@@ -1696,6 +1752,8 @@ static struct cmd_iolog_pdu *convert_iolog(struct fio_net_cmd *cmd,
 	ret->log_offset		= le32_to_cpu(ret->log_offset);
 	ret->log_prio		= le32_to_cpu(ret->log_prio);
 	ret->log_hist_coarseness = le32_to_cpu(ret->log_hist_coarseness);
+	ret->log_hist_sparse = le32_to_cpu(ret->log_hist_sparse);
+	ret->log_binary = le32_to_cpu(ret->log_binary);
 
 	if (*store_direct)
 		return ret;
@@ -1820,6 +1878,10 @@ int fio_handle_client(struct fio_client *client)
 			}
 		}
 
+		offset = le64_to_cpu(p->ts.ilat_plat_offset);
+		if (offset)
+			p->ts.ilat_plat = (uint64_t *)((char *)p + offset);
+
 		dprint(FD_NET, "client: ts->ss_state = %u\n", (unsigned int) le32_to_cpu(p->ts.ss_state));
 		if (le32_to_cpu(p->ts.ss_state) & FIO_SS_DATA) {
 			dprint(FD_NET, "client: received steadystate ring buffers\n");
@@ -2180,6 +2242,7 @@ int fio_handle_clients(struct client_ops *ops)
 	fio_client_json_fini();
 
 	free_clat_prio_stats(&client_ts);
+	free_ilat_plat(&client_ts);
 	free(pfds);
 	return retval || error_clients;
 }
@@ -0,0 +1,68 @@
+/*
+ * Automatically generated by configure - do not modify
+ * Configured with: * './configure'
+ */
+#define CONFIG_HAVE_OPAQUE_HMAC_CTX
+#define CONFIG_HAVE_REP_CAPACITY
+#define CONFIG_NVME_URING_CMD
+#define CONFIG_64BIT
+#define CONFIG_LITTLE_ENDIAN
+#define CONFIG_ZLIB
+#define CONFIG_POSIXAIO
+#define CONFIG_POSIXAIO_FSYNC
+#define CONFIG_PSHARED
+#define CONFIG_PTHREAD_CONDATTR_SETCLOCK
+#define CONFIG_PTHREAD_SIGMASK
+#define CONFIG_PTHREAD_GETAFFINITY
+#define CONFIG_HAVE_ASPRINTF
+#define CONFIG_HAVE_VASPRINTF
+#define CONFIG_LINUX_FALLOCATE
+#define CONFIG_POSIX_FALLOCATE
+#define CONFIG_FDATASYNC
+#define CONFIG_PIPE
+#define CONFIG_PIPE2
+#define CONFIG_PREAD
+#define CONFIG_SYNC_FILE_RANGE
+#define CONFIG_SFAA
+#define CONFIG_SYNC_SYNC
+#define CONFIG_CMP_SWAP
+#define CONFIG_CLOCK_GETTIME
+#define CONFIG_CLOCK_MONOTONIC
+#define CONFIG_CLOCKID_T
+#define CONFIG_GETTIMEOFDAY
+#define CONFIG_POSIX_FADVISE
+#define CONFIG_3ARG_AFFINITY
+#define CONFIG_STRSEP
+#define CONFIG_STRCASESTR
+#define CONFIG_GETOPT_LONG_ONLY
+#define CONFIG_INET_ATON
+#define CONFIG_SOCKLEN_T
+#define CONFIG_LINUX_EXT4_MOVE_EXTENT
+#define CONFIG_LINUX_SPLICE
+#define CONFIG_LIBNUMA
+#define CONFIG_TLS_THREAD
+#define CONFIG_RUSAGE_THREAD
+#define CONFIG_SCHED_IDLE
+#define CONFIG_TCP_NODELAY
+#define CONFIG_NET_WINDOWSIZE
+#define CONFIG_NET_MSS
+#define CONFIG_RLIMIT_MEMLOCK
+#define CONFIG_PWRITEV
+#define CONFIG_PWRITEV2
+#define CONFIG_IPV6
+#define CONFIG_HTTP
+#define CONFIG_SETVBUF
+#define CONFIG_MTD
+#define CONFIG_GETMNTENT
+#define CONFIG_STATIC_ASSERT
+#define CONFIG_HAVE_BOOL
+#define CONFIG_HAVE_STRNDUP
+#define CONFIG_HAS_BLKZONED
+#define CONFIG_BUILD_NATIVE
+#define CONFIG_HAVE_KERNEL_RWF_T
+#define CONFIG_HAVE_GETTID
+#define CONFIG_HAVE_STATX
+#define CONFIG_HAVE_STATX_SYSCALL
+#define CONFIG_HAVE_TIMERFD_CREATE
+#define CONFIG_HAVE_THP
+#define CONFIG_SEED_BUCKETS 4
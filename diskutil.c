@@ -494,6 +494,65 @@ void init_disk_util(struct thread_data *td)
 		f->du = __init_disk_util(td, f);
 }
 
+/*
+ * Find the NUMA node of the device backing a file. Starting from the
+ * /sys/dev/block entry of the device, walk up the sysfs device hierarchy
+ * to the first ancestor that knows its node, typically the PCI function of
+ * the controller. Returns -1 if the node isn't known.
+ */
+static int file_numa_node(char *file_name)
+{
+	char path[PATH_MAX], real[PATH_MAX], tmp[PATH_MAX + 16];
+	int majdev, mindev, node;
+	FILE *f;
+	char *p;
+
+	if (get_device_numbers(file_name, &majdev, &mindev))
+		return -1;
+
+	sprintf(path, "/sys/dev/block/%d:%d", majdev, mindev);
+	if (!realpath(path, real))
+		return -1;
+
+	while ((p = strrchr(real, '/')) != NULL && p != real) {
+		sprintf(tmp, "%s/numa_node", real);
+		f = fopen(tmp, "r");
+		if (f) {
+			if (fscanf(f, "%d", &node) != 1)
+				node = -1;
+			fclose(f);
+			if (node >= 0)
+				return node;
+		}
+		*p = '\0';
+	}
+
+	return -1;
+}
+
+/*
+ * NUMA node of the first of the job's files that has one, or -1
+ */
+int disk_util_numa_node(struct thread_data *td)
+{
+	struct fio_file *f;
+	unsigned int i;
+	int node;
+
+	if (td_ioengine_flagged(td, FIO_DISKLESSIO))
+		return -1;
+
+	for_each_file(td, f, i) {
+		node = file_numa_node(f->file_name);
+		dprint(FD_DISKUTIL, "%s is on NUMA node %d\n", f->file_name,
+				node);
+		if (node >= 0)
+			return node;
+	}
+
+	return -1;
+}
+
 void disk_util_prune_entries(void)
 {
 	fio_sem_down(disk_util_sem);
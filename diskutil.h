@@ -110,12 +110,18 @@ extern void init_disk_util(struct thread_data *);
 extern int update_io_ticks(void);
 extern void setup_disk_util(void);
 extern void disk_util_prune_entries(void);
+extern int disk_util_numa_node(struct thread_data *);
 #else
 /* keep this as a function to avoid a warning in handle_du() */
 #define disk_util_prune_entries()
 #define init_disk_util(td)
 #define setup_disk_util()
 
+static inline int disk_util_numa_node(struct thread_data *td)
+{
+	return -1;
+}
+
 static inline int update_io_ticks(void)
 {
 	return helper_should_exit();
@@ -11,6 +11,7 @@
 #include <errno.h>
 #include <sys/time.h>
 #include <sys/resource.h>
+#include <poll.h>
 
 #include "../fio.h"
 #include "../lib/pow2.h"
@@ -18,6 +19,8 @@
 #include "../lib/memalign.h"
 #include "../lib/fls.h"
 #include "../lib/roundup.h"
+#include "../verify.h"
+#include "../oslib/statx.h"
 
 #ifdef ARCH_HAVE_IOURING
 
@@ -49,6 +52,12 @@ struct io_cq_ring {
 	struct io_uring_cqe *cqes;
 };
 
+/* same layout as the kernel's struct __kernel_timespec */
+struct ioring_timespec {
+	int64_t tv_sec;
+	long long tv_nsec;
+};
+
 struct ioring_mmap {
 	void *ptr;
 	size_t len;
@@ -57,6 +66,13 @@ struct ioring_mmap {
 struct ioring_data {
 	int ring_fd;
 
+	/*
+	 * fd and flags to pass to io_uring_enter, the registered ring index
+	 * if the ring fd could be registered.
+	 */
+	int enter_fd;
+	unsigned enter_flags;
+
 	struct io_u **io_u_index;
 
 	int *fds;
@@ -77,6 +93,60 @@ struct ioring_data {
 	struct ioring_mmap mmap[3];
 
 	struct cmdprio cmdprio;
+
+	/* provided buffer ring, used for reads if buffer_ring is set */
+	struct io_uring_buf_ring *br;
+	void *br_bufs;
+	bool br_own_bufs;
+	unsigned int br_buf_size;
+	unsigned int br_entries;
+	unsigned int br_mask;
+	unsigned int br_inflight;
+	unsigned short br_tail;
+	unsigned short *br_done;
+	unsigned int br_nr_done;
+
+	/*
+	 * With link_sync, SQEs of the chain that hasn't seen its sync yet are
+	 * held back from the kernel.
+	 */
+	unsigned int link_held;
+
+	struct ioring_sq_share *sq_share;
+
+	/*
+	 * With io_timeout, every IO is followed by a linked timeout SQE, and
+	 * completions are reaped into events[] to skip the timeout CQEs.
+	 */
+	unsigned sqes_per_io;
+	struct ioring_timespec timeout_ts;
+	struct io_u **events;
+
+	/*
+	 * Submit batch that each io_u was last part of, to tell whether it
+	 * completed inline in io_uring_enter or was completed asynchronously.
+	 */
+	unsigned int *submit_seq;
+	unsigned int cur_seq;
+
+	/*
+	 * With rings=N, io_us are sharded over N rings by their index. rings[0]
+	 * is the job's own ioring_data, the others only carry the state that
+	 * is private to a ring and share everything else with it.
+	 */
+	struct ioring_data **rings;
+	unsigned int nr_rings;
+	struct pollfd *ring_pfds;
+	unsigned int inflight;
+
+	/*
+	 * sg_max_segs iovecs per io_u with sg_segments/sg_segment_size. With
+	 * fixedbufs, they're submitted with the vectored fixed buffer ops if
+	 * the kernel has them.
+	 */
+	struct iovec *sg_iovecs;
+	unsigned int sg_max_segs;
+	int sg_fixed;
 };
 
 struct ioring_options {
@@ -92,9 +162,42 @@ struct ioring_options {
 	unsigned int uncached;
 	unsigned int nowait;
 	unsigned int force_async;
+	unsigned int buffer_ring;
+	unsigned int buffer_ring_entries;
+	unsigned int link_sync;
+	unsigned int sqthread_share;
+	unsigned long long io_timeout;
+	unsigned int fileop_dir;
+	unsigned long long complete_timeout;
+	unsigned int iowq_bounded;
+	unsigned int iowq_unbounded;
+	char *iowq_cpus;
+	unsigned int count_inline;
+	unsigned int rings;
 	enum uring_cmd_type cmd_type;
 };
 
+/*
+ * SQPOLL rings that other jobs in this process can attach to with
+ * sqthread_share. Keyed by sqthread_poll_cpu if that is set, by the job
+ * group otherwise.
+ */
+struct ioring_sq_share {
+	struct flist_head list;
+	int cpu;
+	unsigned int groupid;
+	int ring_fd;
+	int refs;
+};
+
+static struct {
+	pthread_mutex_t lock;
+	struct flist_head list;
+} sq_shares = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.list = FLIST_HEAD_INIT(sq_shares.list),
+};
+
 static const int ddir_to_op[2][2] = {
 	{ IORING_OP_READV, IORING_OP_READ },
 	{ IORING_OP_WRITEV, IORING_OP_WRITE }
@@ -105,6 +208,11 @@ static const int fixed_ddir_to_op[2] = {
 	IORING_OP_WRITE_FIXED
 };
 
+static const int vec_fixed_ddir_to_op[2] = {
+	IORING_OP_READV_FIXED,
+	IORING_OP_WRITEV_FIXED
+};
+
 static int fio_ioring_sqpoll_cb(void *data, unsigned long long *val)
 {
 	struct ioring_options *o = data;
@@ -214,6 +322,111 @@ static struct fio_option options[] = {
 		.category = FIO_OPT_C_ENGINE,
 		.group	= FIO_OPT_G_IOURING,
 	},
+	{
+		.name	= "buffer_ring",
+		.lname	= "Provided buffer ring",
+		.type	= FIO_OPT_STR_SET,
+		.off1	= offsetof(struct ioring_options, buffer_ring),
+		.help	= "Let the kernel pick read buffers from a provided buffer ring",
+		.category = FIO_OPT_C_ENGINE,
+		.group	= FIO_OPT_G_IOURING,
+	},
+	{
+		.name	= "buffer_ring_entries",
+		.lname	= "Provided buffer ring entries",
+		.type	= FIO_OPT_INT,
+		.off1	= offsetof(struct ioring_options, buffer_ring_entries),
+		.help	= "Number of buffers in the provided buffer ring (0 = iodepth)",
+		.minval	= 0,
+		.maxval	= 32768,
+		.def	= "0",
+		.category = FIO_OPT_C_ENGINE,
+		.group	= FIO_OPT_G_IOURING,
+	},
+	{
+		.name	= "link_sync",
+		.lname	= "Link IO to the next sync",
+		.type	= FIO_OPT_STR_SET,
+		.off1	= offsetof(struct ioring_options, link_sync),
+		.help	= "Submit IO and the sync that follows it as one linked chain",
+		.category = FIO_OPT_C_ENGINE,
+		.group	= FIO_OPT_G_IOURING,
+	},
+	{
+		.name	= "io_timeout",
+		.lname	= "IO timeout",
+		.type	= FIO_OPT_STR_VAL_TIME,
+		.off1	= offsetof(struct ioring_options, io_timeout),
+		.help	= "Cancel IO that hasn't completed within this time",
+		.def	= "0",
+		.is_time = 1,
+		.category = FIO_OPT_C_ENGINE,
+		.group	= FIO_OPT_G_IOURING,
+	},
+	{
+		.name	= "fileop_dir",
+		.lname	= "File operations on directories",
+		.type	= FIO_OPT_BOOL,
+		.off1	= offsetof(struct ioring_options, fileop_dir),
+		.help	= "Writes create and trims remove directories (io_uring_fileop)",
+		.def	= "0",
+		.category = FIO_OPT_C_ENGINE,
+		.group	= FIO_OPT_G_IOURING,
+	},
+	{
+		.name	= "complete_timeout",
+		.lname	= "Completion wait timeout",
+		.type	= FIO_OPT_STR_VAL_TIME,
+		.off1	= offsetof(struct ioring_options, complete_timeout),
+		.help	= "Wait at most this long for iodepth_batch_complete_min completions",
+		.def	= "0",
+		.is_time = 1,
+		.category = FIO_OPT_C_ENGINE,
+		.group	= FIO_OPT_G_IOURING,
+	},
+	{
+		.name	= "iowq_max_workers",
+		.lname	= "io-wq max workers",
+		.type	= FIO_OPT_INT,
+		.off1	= offsetof(struct ioring_options, iowq_bounded),
+		.off2	= offsetof(struct ioring_options, iowq_unbounded),
+		.help	= "Max number of bounded,unbounded io-wq workers (0 is kernel default)",
+		.def	= "0",
+		.category = FIO_OPT_C_ENGINE,
+		.group	= FIO_OPT_G_IOURING,
+	},
+	{
+		.name	= "rings",
+		.lname	= "Number of rings",
+		.type	= FIO_OPT_INT,
+		.off1	= offsetof(struct ioring_options, rings),
+		.help	= "Number of rings to shard the job's IO over",
+		.def	= "1",
+		.minval	= 1,
+		.category = FIO_OPT_C_ENGINE,
+		.group	= FIO_OPT_G_IOURING,
+	},
+#ifdef FIO_HAVE_CPU_AFFINITY
+	{
+		.name	= "iowq_cpus_allowed",
+		.lname	= "io-wq CPUs allowed",
+		.type	= FIO_OPT_STR_STORE,
+		.off1	= offsetof(struct ioring_options, iowq_cpus),
+		.help	= "CPUs the io-wq workers of the ring may run on",
+		.category = FIO_OPT_C_ENGINE,
+		.group	= FIO_OPT_G_IOURING,
+	},
+#endif
+	{
+		.name	= "count_inline",
+		.lname	= "Count inline completions",
+		.type	= FIO_OPT_BOOL,
+		.off1	= offsetof(struct ioring_options, count_inline),
+		.help	= "Count IO completed before io_uring_enter returned",
+		.def	= "0",
+		.category = FIO_OPT_C_ENGINE,
+		.group	= FIO_OPT_G_IOURING,
+	},
 	{
 		.name	= "registerfiles",
 		.lname	= "Register file set",
@@ -241,6 +454,15 @@ static struct fio_option options[] = {
 		.category = FIO_OPT_C_ENGINE,
 		.group	= FIO_OPT_G_IOURING,
 	},
+	{
+		.name	= "sqthread_share",
+		.lname	= "Share SQ Thread",
+		.type	= FIO_OPT_STR_SET,
+		.off1	= offsetof(struct ioring_options, sqthread_share),
+		.help	= "Share one SQ polling thread between jobs in a group or on the same CPU",
+		.category = FIO_OPT_C_ENGINE,
+		.group	= FIO_OPT_G_IOURING,
+	},
 	{
 		.name	= "nonvectored",
 		.lname	= "Non-vectored",
@@ -299,21 +521,72 @@ static struct fio_option options[] = {
 	},
 };
 
-static int io_uring_enter(struct ioring_data *ld, unsigned int to_submit,
-			 unsigned int min_complete, unsigned int flags)
+static int __io_uring_enter(struct ioring_data *ld, unsigned int to_submit,
+			   unsigned int min_complete, unsigned int flags,
+			   void *arg, size_t argsz)
 {
 #ifdef FIO_ARCH_HAS_SYSCALL
-	return __do_syscall6(__NR_io_uring_enter, ld->ring_fd, to_submit,
-				min_complete, flags, NULL, 0);
+	int ret;
+
+	flags |= ld->enter_flags;
+
+	/* the raw syscall returns -errno, callers expect errno to be set */
+	ret = __do_syscall6(__NR_io_uring_enter, ld->enter_fd, to_submit,
+				min_complete, flags, arg, argsz);
+	if (ret < 0) {
+		errno = -ret;
+		ret = -1;
+	}
+	return ret;
 #else
-	return syscall(__NR_io_uring_enter, ld->ring_fd, to_submit,
-			min_complete, flags, NULL, 0);
+	flags |= ld->enter_flags;
+	return syscall(__NR_io_uring_enter, ld->enter_fd, to_submit,
+			min_complete, flags, arg, argsz);
 #endif
 }
 
-static int fio_ioring_prep(struct thread_data *td, struct io_u *io_u)
+static int io_uring_enter(struct ioring_data *ld, unsigned int to_submit,
+			 unsigned int min_complete, unsigned int flags)
+{
+	return __io_uring_enter(ld, to_submit, min_complete, flags, NULL, 0);
+}
+
+/*
+ * Wait for min_complete completions, but give up after complete_timeout.
+ */
+static int io_uring_enter_timeout(struct ioring_data *ld,
+				  unsigned int min_complete,
+				  unsigned long long usec)
+{
+	struct io_uring_getevents_arg arg = { };
+	struct ioring_timespec ts;
+
+	ts.tv_sec = usec / 1000000;
+	ts.tv_nsec = (usec % 1000000) * 1000;
+	arg.ts = (unsigned long) &ts;
+
+	return __io_uring_enter(ld, 0, min_complete,
+				IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+				&arg, sizeof(arg));
+}
+
+/*
+ * The ring that an io_u is submitted and completed on.
+ */
+static inline struct ioring_data *fio_ioring_ring(struct thread_data *td,
+						  struct io_u *io_u)
 {
 	struct ioring_data *ld = td->io_ops_data;
+
+	if (ld->nr_rings <= 1)
+		return ld;
+
+	return ld->rings[io_u->index % ld->nr_rings];
+}
+
+static int fio_ioring_prep(struct thread_data *td, struct io_u *io_u)
+{
+	struct ioring_data *ld = fio_ioring_ring(td, io_u);
 	struct ioring_options *o = td->eo;
 	struct fio_file *f = io_u->file;
 	struct io_uring_sqe *sqe;
@@ -329,7 +602,30 @@ static int fio_ioring_prep(struct thread_data *td, struct io_u *io_u)
 	}
 
 	if (io_u->ddir == DDIR_READ || io_u->ddir == DDIR_WRITE) {
-		if (o->fixedbufs) {
+		if (io_u->ddir == DDIR_READ && ld->br) {
+			/*
+			 * Buffer is picked by the kernel from the provided
+			 * buffer ring, and attached to the io_u at completion
+			 * time in fio_ioring_event().
+			 */
+			sqe->opcode = IORING_OP_READ;
+			sqe->flags |= IOSQE_BUFFER_SELECT;
+			sqe->addr = 0;
+			sqe->len = io_u->xfer_buflen;
+			sqe->buf_group = 0;
+		} else if (ld->sg_iovecs) {
+			struct iovec *iov;
+
+			iov = &ld->sg_iovecs[io_u->index * ld->sg_max_segs];
+			if (ld->sg_fixed) {
+				sqe->opcode = vec_fixed_ddir_to_op[io_u->ddir];
+				sqe->buf_index = io_u->index;
+			} else {
+				sqe->opcode = ddir_to_op[io_u->ddir][0];
+			}
+			sqe->addr = (unsigned long) iov;
+			sqe->len = io_u_fill_sg(td, io_u, iov);
+		} else if (o->fixedbufs) {
 			sqe->opcode = fixed_ddir_to_op[io_u->ddir];
 			sqe->addr = (unsigned long) io_u->xfer_buf;
 			sqe->len = io_u->xfer_buflen;
@@ -397,6 +693,51 @@ static int fio_ioring_prep(struct thread_data *td, struct io_u *io_u)
 	return 0;
 }
 
+/*
+ * io_uring_fileop maps the data directions to metadata operations on the
+ * file itself: reads stat it, writes create it and trims remove it.
+ */
+static int fio_ioring_fileop_prep(struct thread_data *td, struct io_u *io_u)
+{
+	struct ioring_data *ld = td->io_ops_data;
+	struct ioring_options *o = td->eo;
+	struct fio_file *f = io_u->file;
+	struct io_uring_sqe *sqe;
+
+	sqe = &ld->sqes[io_u->index];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->fd = AT_FDCWD;
+	sqe->addr = (unsigned long) f->file_name;
+
+	switch (io_u->ddir) {
+	case DDIR_READ:
+		sqe->opcode = IORING_OP_STATX;
+		sqe->len = STATX_ALL;
+		sqe->off = (unsigned long) io_u->buf;
+		break;
+	case DDIR_WRITE:
+		if (o->fileop_dir) {
+			sqe->opcode = IORING_OP_MKDIRAT;
+			sqe->len = 0700;
+		} else {
+			sqe->opcode = IORING_OP_OPENAT;
+			sqe->len = 0600;
+			sqe->open_flags = O_CREAT | O_RDWR;
+		}
+		break;
+	case DDIR_TRIM:
+		sqe->opcode = IORING_OP_UNLINKAT;
+		if (o->fileop_dir)
+			sqe->unlink_flags = AT_REMOVEDIR;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	sqe->user_data = (unsigned long) io_u;
+	return 0;
+}
+
 static int fio_ioring_cmd_prep(struct thread_data *td, struct io_u *io_u)
 {
 	struct ioring_data *ld = td->io_ops_data;
@@ -443,18 +784,25 @@ static int fio_ioring_cmd_prep(struct thread_data *td, struct io_u *io_u)
 			o->nonvectored ? NULL : &ld->iovecs[io_u->index]);
 }
 
-static struct io_u *fio_ioring_event(struct thread_data *td, int event)
+static struct io_u *fio_ioring_cqe_io_u(struct thread_data *td,
+					 struct io_uring_cqe *cqe)
 {
 	struct ioring_data *ld = td->io_ops_data;
-	struct io_uring_cqe *cqe;
+	struct ioring_options *o = td->eo;
 	struct io_u *io_u;
-	unsigned index;
-
-	index = (event + ld->cq_ring_off) & ld->cq_ring_mask;
 
-	cqe = &ld->cq_ring.cqes[index];
 	io_u = (struct io_u *) (uintptr_t) cqe->user_data;
 
+	/*
+	 * IO that hit its linked timeout gets cancelled, it is accounted as
+	 * a timeout rather than as an error.
+	 */
+	if (o->io_timeout && (cqe->res == -ECANCELED || cqe->res == -EINTR)) {
+		io_u->error = ETIMEDOUT;
+		io_u_set(td, io_u, IO_U_F_TIMEDOUT);
+		return io_u;
+	}
+
 	if (cqe->res != io_u->xfer_buflen) {
 		if (cqe->res > io_u->xfer_buflen)
 			io_u->error = -cqe->res;
@@ -463,6 +811,55 @@ static struct io_u *fio_ioring_event(struct thread_data *td, int event)
 	} else
 		io_u->error = 0;
 
+	if (io_u->ddir == DDIR_READ && ld->br) {
+		ld->br_inflight--;
+		if (cqe->flags & IORING_CQE_F_BUFFER) {
+			unsigned short bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+
+			io_u->xfer_buf = ld->br_bufs +
+					(unsigned long) bid * ld->br_buf_size;
+			ld->br_done[ld->br_nr_done++] = bid;
+		}
+	}
+
+	return io_u;
+}
+
+static struct io_u *fio_ioring_event(struct thread_data *td, int event)
+{
+	struct ioring_data *ld = td->io_ops_data;
+	unsigned index;
+
+	if (ld->events)
+		return ld->events[event];
+
+	index = (event + ld->cq_ring_off) & ld->cq_ring_mask;
+	return fio_ioring_cqe_io_u(td, &ld->cq_ring.cqes[index]);
+}
+
+static struct io_u *fio_ioring_fileop_event(struct thread_data *td, int event)
+{
+	struct ioring_data *ld = td->io_ops_data;
+	struct ioring_options *o = td->eo;
+	struct io_uring_cqe *cqe;
+	struct io_u *io_u;
+	unsigned index;
+
+	index = (event + ld->cq_ring_off) & ld->cq_ring_mask;
+
+	cqe = &ld->cq_ring.cqes[index];
+	io_u = (struct io_u *) (uintptr_t) cqe->user_data;
+
+	if (cqe->res < 0) {
+		io_u->error = -cqe->res;
+		return io_u;
+	}
+
+	/* only the open is measured, the new file descriptor isn't needed */
+	if (io_u->ddir == DDIR_WRITE && !o->fileop_dir)
+		close(cqe->res);
+
+	io_u->error = 0;
 	return io_u;
 }
 
@@ -489,10 +886,39 @@ static struct io_u *fio_ioring_cmd_event(struct thread_data *td, int event)
 	return io_u;
 }
 
-static int fio_ioring_cqring_reap(struct thread_data *td, unsigned int events,
+static void fio_ioring_br_add(struct ioring_data *ld, unsigned short bid)
+{
+	struct io_uring_buf *buf;
+
+	buf = &ld->br->bufs[ld->br_tail & ld->br_mask];
+	buf->addr = (unsigned long) ld->br_bufs + (unsigned long) bid * ld->br_buf_size;
+	buf->len = ld->br_buf_size;
+	buf->bid = bid;
+	ld->br_tail++;
+}
+
+/*
+ * Hand buffers picked for previously reaped completions back to the kernel.
+ * Completions are fully processed before fio queues new IO, so by the time
+ * we get here their data is no longer needed.
+ */
+static void fio_ioring_br_recycle(struct ioring_data *ld)
+{
+	unsigned int i;
+
+	if (!ld->br_nr_done)
+		return;
+
+	for (i = 0; i < ld->br_nr_done; i++)
+		fio_ioring_br_add(ld, ld->br_done[i]);
+
+	ld->br_nr_done = 0;
+	atomic_store_release(&ld->br->tail, ld->br_tail);
+}
+
+static int fio_ioring_cqring_reap(struct ioring_data *ld, unsigned int events,
 				   unsigned int max)
 {
-	struct ioring_data *ld = td->io_ops_data;
 	struct io_cq_ring *ring = &ld->cq_ring;
 	unsigned head, reaped = 0;
 
@@ -504,12 +930,117 @@ static int fio_ioring_cqring_reap(struct thread_data *td, unsigned int events,
 		head++;
 	} while (reaped + events < max);
 
-	if (reaped)
+	if (reaped) {
 		atomic_store_release(ring->head, head);
+		ld->inflight -= reaped;
+	}
 
 	return reaped;
 }
 
+static int fio_ioring_commit(struct thread_data *td);
+
+/*
+ * Submit an unfinished link_sync chain without waiting for its sync, so the
+ * IO in it can complete.
+ */
+static int fio_ioring_link_flush(struct thread_data *td)
+{
+	struct ioring_data *ld = td->io_ops_data;
+	struct io_sq_ring *ring = &ld->sq_ring;
+	unsigned tail = *ring->tail + ld->link_held;
+	int index;
+
+	index = ring->array[(tail - 1) & ld->sq_ring_mask];
+	ld->sqes[index].flags &= ~IOSQE_IO_LINK;
+
+	atomic_store_release(ring->tail, tail);
+	ld->queued += ld->link_held;
+	ld->link_held = 0;
+	return fio_ioring_commit(td);
+}
+
+/*
+ * Like fio_ioring_cqring_reap(), but for rings that also carry the CQEs of
+ * linked timeouts, or for reaping several rings. Only IO completions end up
+ * in the events array.
+ */
+static int fio_ioring_cqring_reap_events(struct thread_data *td,
+					 struct ioring_data *ld,
+					 unsigned int events, unsigned int max)
+{
+	struct io_cq_ring *ring = &ld->cq_ring;
+	struct io_uring_cqe *cqe;
+	unsigned head, reaped = 0;
+
+	head = *ring->head;
+	while (reaped + events < max) {
+		if (head == atomic_load_acquire(ring->tail))
+			break;
+		cqe = &ring->cqes[head & ld->cq_ring_mask];
+		head++;
+		if (!cqe->user_data)
+			continue;
+		ld->events[events + reaped++] = fio_ioring_cqe_io_u(td, cqe);
+	}
+
+	atomic_store_release(ring->head, head);
+	ld->inflight -= reaped;
+	return reaped;
+}
+
+static int fio_ioring_rings_reap(struct thread_data *td, unsigned int events,
+				 unsigned int max)
+{
+	struct ioring_data *ld = td->io_ops_data;
+	unsigned int i, reaped = 0;
+
+	for (i = 0; i < ld->nr_rings && events + reaped < max; i++)
+		reaped += fio_ioring_cqring_reap_events(td, ld->rings[i],
+							events + reaped, max);
+
+	return reaped;
+}
+
+/*
+ * A single io_uring_enter can only wait on one ring. First run a pass that
+ * just flushes completions on every ring with IO in flight, if that didn't
+ * turn up anything, wait in poll(2) until any of those rings has a
+ * completion. Polled IO only completes from io_uring_enter, so with hipri
+ * the job keeps running the flushing pass instead.
+ */
+static int fio_ioring_rings_wait(struct thread_data *td, bool block)
+{
+	struct ioring_data *ld = td->io_ops_data;
+	struct ioring_options *o = td->eo;
+	unsigned int i, nr = 0;
+	int ret;
+
+	for (i = 0; i < ld->nr_rings; i++) {
+		struct ioring_data *r = ld->rings[i];
+
+		if (!r->inflight)
+			continue;
+
+		if (block && !o->hipri) {
+			ld->ring_pfds[nr].fd = r->ring_fd;
+			ld->ring_pfds[nr].events = POLLIN;
+			nr++;
+			continue;
+		}
+
+		ret = io_uring_enter(r, 0, 0, IORING_ENTER_GETEVENTS);
+		if (ret < 0)
+			return ret;
+	}
+
+	if (!nr)
+		return 0;
+
+	ret = poll(ld->ring_pfds, nr, -1);
+	return ret < 0 ? ret : 0;
+}
+
 static int fio_ioring_getevents(struct thread_data *td, unsigned int min,
 				unsigned int max, const struct timespec *t)
 {
@@ -518,22 +1049,59 @@ static int fio_ioring_getevents(struct thread_data *td, unsigned int min,
 	struct ioring_options *o = td->eo;
 	struct io_cq_ring *ring = &ld->cq_ring;
 	unsigned events = 0;
+	bool timed_out = false, block = false;
 	int r;
 
+	/*
+	 * Don't wait on held IO that only gets submitted once its sync is
+	 * queued, it may never be.
+	 */
+	if (ld->link_held &&
+	    min + ld->link_held > td->io_u_in_flight + td->io_u_queued) {
+		r = fio_ioring_link_flush(td);
+		if (r)
+			return r;
+	}
+
 	ld->cq_ring_off = *ring->head;
 	do {
-		r = fio_ioring_cqring_reap(td, events, max);
+		if (ld->nr_rings > 1)
+			r = fio_ioring_rings_reap(td, events, max);
+		else if (ld->events)
+			r = fio_ioring_cqring_reap_events(td, ld, events, max);
+		else
+			r = fio_ioring_cqring_reap(ld, events, max);
 		if (r) {
 			events += r;
 			if (actual_min != 0)
 				actual_min -= r;
+			block = false;
 			continue;
 		}
 
 		if (!o->sqpoll_thread) {
-			r = io_uring_enter(ld, 0, actual_min,
-						IORING_ENTER_GETEVENTS);
+			if (ld->nr_rings > 1) {
+				r = fio_ioring_rings_wait(td, block);
+				block = !block;
+			} else if (o->complete_timeout && actual_min && !timed_out) {
+				r = io_uring_enter_timeout(ld, actual_min,
+							o->complete_timeout);
+			} else {
+				r = io_uring_enter(ld, 0, actual_min,
+							IORING_ENTER_GETEVENTS);
+			}
 			if (r < 0) {
+				/*
+				 * Timed out waiting for the full batch, settle
+				 * for what has completed. If nothing has, wait
+				 * for a single completion.
+				 */
+				if (errno == ETIME) {
+					timed_out = true;
+					actual_min = 1;
+					r = 0;
+					continue;
+				}
 				if (errno == EAGAIN || errno == EINTR)
 					continue;
 				r = -errno;
@@ -541,7 +1109,7 @@ static int fio_ioring_getevents(struct thread_data *td, unsigned int min,
 				break;
 			}
 		}
-	} while (events < min);
+	} while (events < min && !(timed_out && events));
 
 	return r < 0 ? r : events;
 }
@@ -552,23 +1120,49 @@ static inline void fio_ioring_cmdprio_prep(struct thread_data *td,
 	struct ioring_data *ld = td->io_ops_data;
 	struct cmdprio *cmdprio = &ld->cmdprio;
 
-	if (fio_cmdprio_set_ioprio(td, cmdprio, io_u))
+	if (cmdprio->mode == CMDPRIO_MODE_NONE)
+		return;
+
+	if (fio_cmdprio_set_ioprio(td, cmdprio, io_u)) {
+		ld = fio_ioring_ring(td, io_u);
 		ld->sqes[io_u->index].ioprio = io_u->ioprio;
+	}
+}
+
+/*
+ * The timeout SQE of an io_u lives at io_u->index + iodepth.
+ */
+static void fio_ioring_prep_timeout(struct thread_data *td, struct io_u *io_u)
+{
+	struct ioring_data *ld = td->io_ops_data;
+	struct io_uring_sqe *sqe;
+
+	ld->sqes[io_u->index].flags |= IOSQE_IO_LINK;
+
+	sqe = &ld->sqes[io_u->index + td->o.iodepth];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = IORING_OP_LINK_TIMEOUT;
+	sqe->fd = -1;
+	sqe->addr = (unsigned long) &ld->timeout_ts;
+	sqe->len = 1;
+	sqe->user_data = 0;
 }
 
 static enum fio_q_status fio_ioring_queue(struct thread_data *td,
 					  struct io_u *io_u)
 {
-	struct ioring_data *ld = td->io_ops_data;
+	struct ioring_data *ld = fio_ioring_ring(td, io_u);
+	struct ioring_options *o = td->eo;
 	struct io_sq_ring *ring = &ld->sq_ring;
 	unsigned tail, next_tail;
 
 	fio_ro_check(td, io_u);
 
-	if (ld->queued == ld->iodepth)
+	if (ld->queued + ld->link_held == ld->iodepth)
 		return FIO_Q_BUSY;
 
-	if (io_u->ddir == DDIR_TRIM) {
+	if (io_u->ddir == DDIR_TRIM &&
+	    td_ioengine_flagged(td, FIO_ASYNCIO_SYNC_TRIM)) {
 		if (ld->queued)
 			return FIO_Q_BUSY;
 
@@ -578,24 +1172,56 @@ static enum fio_q_status fio_ioring_queue(struct thread_data *td,
 		return FIO_Q_COMPLETED;
 	}
 
-	tail = *ring->tail;
+	tail = *ring->tail + ld->link_held;
 	next_tail = tail + 1;
 	if (next_tail == atomic_load_acquire(ring->head))
 		return FIO_Q_BUSY;
 
-	if (ld->cmdprio.mode != CMDPRIO_MODE_NONE)
-		fio_ioring_cmdprio_prep(td, io_u);
+	if (ld->br) {
+		fio_ioring_br_recycle(ld);
+
+		/*
+		 * Don't have more reads in flight than there are buffers in
+		 * the ring, the kernel would fail the rest with ENOBUFS.
+		 */
+		if (io_u->ddir == DDIR_READ) {
+			if (ld->br_inflight == ld->br_entries)
+				return FIO_Q_BUSY;
+			ld->br_inflight++;
+		}
+	}
+
+	fio_ioring_cmdprio_prep(td, io_u);
 
 	ring->array[tail & ld->sq_ring_mask] = io_u->index;
+
+	/*
+	 * Link everything up to the next sync, and keep it from the kernel
+	 * until that sync closes the chain. Submitting part of a chain would
+	 * break the link.
+	 */
+	if (o->link_sync && !ddir_sync(io_u->ddir)) {
+		ld->sqes[io_u->index].flags |= IOSQE_IO_LINK;
+		ld->link_held++;
+		return FIO_Q_QUEUED;
+	}
+
+	if (o->io_timeout) {
+		fio_ioring_prep_timeout(td, io_u);
+		ring->array[next_tail & ld->sq_ring_mask] = io_u->index + td->o.iodepth;
+		next_tail++;
+	}
+
 	atomic_store_release(ring->tail, next_tail);
 
-	ld->queued++;
+	ld->queued += ld->link_held + 1;
+	ld->link_held = 0;
 	return FIO_Q_QUEUED;
 }
 
-static void fio_ioring_queued(struct thread_data *td, int start, int nr)
+static void fio_ioring_queued(struct thread_data *td, struct ioring_data *ld,
+			      int start, int nr)
 {
-	struct ioring_data *ld = td->io_ops_data;
 	struct timespec now;
 
 	if (!fio_fill_issue_time(td))
@@ -611,7 +1237,7 @@ static void fio_ioring_queued(struct thread_data *td, int start, int nr)
 		memcpy(&io_u->issue_time, &now, sizeof(now));
 		io_u_queued(td, io_u);
 
-		start++;
+		start += ld->sqes_per_io;
 	}
 
 	/*
@@ -621,9 +1247,49 @@ static void fio_ioring_queued(struct thread_data *td, int start, int nr)
 		memcpy(&td->last_issue, &now, sizeof(now));
 }
 
-static int fio_ioring_commit(struct thread_data *td)
+/*
+ * Of the nr IOs just submitted from start, count the ones whose completion
+ * was already posted when io_uring_enter returned. Those were completed
+ * inline, the rest complete later: on the device, or after being punted to
+ * io-wq. Userspace can't tell those two apart.
+ */
+static void fio_ioring_count_inline(struct thread_data *td,
+				    struct ioring_data *ld, unsigned start,
+				    int nr)
+{
+	struct io_cq_ring *cring = &ld->cq_ring;
+	unsigned head, tail, seq;
+	int i, nr_inline = 0;
+
+	if (!++ld->cur_seq)
+		ld->cur_seq = 1;
+	seq = ld->cur_seq;
+
+	for (i = 0; i < nr; i++) {
+		int index = ld->sq_ring.array[start & ld->sq_ring_mask];
+
+		ld->submit_seq[index] = seq;
+		start += ld->sqes_per_io;
+	}
+
+	head = *cring->head;
+	tail = atomic_load_acquire(cring->tail);
+	for (; head != tail; head++) {
+		struct io_uring_cqe *cqe;
+		struct io_u *io_u;
+
+		cqe = &cring->cqes[head & ld->cq_ring_mask];
+		io_u = (struct io_u *) (uintptr_t) cqe->user_data;
+		if (io_u && ld->submit_seq[io_u->index] == seq)
+			nr_inline++;
+	}
+
+	td->ts.inline_complete += nr_inline;
+	td->ts.deferred_complete += nr - nr_inline;
+}
+
+static int __fio_ioring_commit(struct thread_data *td, struct ioring_data *ld)
 {
-	struct ioring_data *ld = td->io_ops_data;
 	struct ioring_options *o = td->eo;
 	int ret;
 
@@ -642,45 +1308,149 @@ static int fio_ioring_commit(struct thread_data *td)
 
 		flags = atomic_load_acquire(ring->flags);
 		if (flags & IORING_SQ_NEED_WAKEUP)
-			io_uring_enter(ld, ld->queued, 0,
+			io_uring_enter(ld, ld->queued * ld->sqes_per_io, 0,
 					IORING_ENTER_SQ_WAKEUP);
-		fio_ioring_queued(td, start, ld->queued);
+		fio_ioring_queued(td, ld, start, ld->queued);
 		io_u_mark_submit(td, ld->queued);
 
-		ld->queued = 0;
-		return 0;
+		ld->inflight += ld->queued;
+		ld->queued = 0;
+		return 0;
+	}
+
+	do {
+		unsigned start = *ld->sq_ring.head;
+		long nr = ld->queued * ld->sqes_per_io;
+
+		ret = io_uring_enter(ld, nr, 0, IORING_ENTER_GETEVENTS);
+		if (ret > 0) {
+			ret /= ld->sqes_per_io;
+			fio_ioring_queued(td, ld, start, ret);
+			io_u_mark_submit(td, ret);
+			if (o->count_inline)
+				fio_ioring_count_inline(td, ld, start, ret);
+
+			ld->inflight += ret;
+			ld->queued -= ret;
+			ret = 0;
+		} else if (!ret) {
+			io_u_mark_submit(td, ret);
+			continue;
+		} else {
+			if (errno == EAGAIN || errno == EINTR) {
+				ret = fio_ioring_cqring_reap(ld, 0, ld->queued);
+				if (ret)
+					continue;
+				/* Shouldn't happen */
+				usleep(1);
+				continue;
+			}
+			ret = -errno;
+			td_verror(td, errno, "io_uring_enter submit");
+			break;
+		}
+	} while (ld->queued);
+
+	return ret;
+}
+
+static int fio_ioring_commit(struct thread_data *td)
+{
+	struct ioring_data *ld = td->io_ops_data;
+	unsigned int i;
+	int ret;
+
+	if (ld->nr_rings <= 1)
+		return __fio_ioring_commit(td, ld);
+
+	for (i = 0; i < ld->nr_rings; i++) {
+		ret = __fio_ioring_commit(td, ld->rings[i]);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+/*
+ * Look for a ring whose SQ thread this job should share, and attach to it.
+ * Holds the share lock until fio_ioring_sq_share_end(), so that the first
+ * job to set up its ring is the one that everybody attaches to.
+ */
+static void fio_ioring_sq_share_begin(struct thread_data *td,
+				      struct io_uring_params *p)
+{
+	struct ioring_data *ld = td->io_ops_data;
+	struct ioring_options *o = td->eo;
+	struct ioring_sq_share *sh;
+	struct flist_head *n;
+	int cpu = o->sqpoll_set ? o->sqpoll_cpu : -1;
+
+	if (!o->sqthread_share)
+		return;
+
+	pthread_mutex_lock(&sq_shares.lock);
+
+	flist_for_each(n, &sq_shares.list) {
+		sh = flist_entry(n, struct ioring_sq_share, list);
+		if (sh->cpu != cpu)
+			continue;
+		if (cpu == -1 && sh->groupid != td->groupid)
+			continue;
+
+		p->flags |= IORING_SETUP_ATTACH_WQ;
+		p->wq_fd = sh->ring_fd;
+		ld->sq_share = sh;
+		break;
+	}
+}
+
+static void fio_ioring_sq_share_end(struct thread_data *td, int ring_fd)
+{
+	struct ioring_data *ld = td->io_ops_data;
+	struct ioring_options *o = td->eo;
+	struct ioring_sq_share *sh = ld->sq_share;
+
+	if (!o->sqthread_share)
+		return;
+
+	if (ring_fd < 0) {
+		ld->sq_share = NULL;
+		goto out;
 	}
 
-	do {
-		unsigned start = *ld->sq_ring.head;
-		long nr = ld->queued;
+	/*
+	 * Keep our own reference to the first ring, the job that created it
+	 * may well exit before the ones attached to it.
+	 */
+	if (!sh) {
+		sh = calloc(1, sizeof(*sh));
+		sh->cpu = o->sqpoll_set ? o->sqpoll_cpu : -1;
+		sh->groupid = td->groupid;
+		sh->ring_fd = dup(ring_fd);
+		flist_add_tail(&sh->list, &sq_shares.list);
+		ld->sq_share = sh;
+	}
+	sh->refs++;
+out:
+	pthread_mutex_unlock(&sq_shares.lock);
+}
 
-		ret = io_uring_enter(ld, nr, 0, IORING_ENTER_GETEVENTS);
-		if (ret > 0) {
-			fio_ioring_queued(td, start, ret);
-			io_u_mark_submit(td, ret);
+static void fio_ioring_sq_share_put(struct ioring_data *ld)
+{
+	struct ioring_sq_share *sh = ld->sq_share;
 
-			ld->queued -= ret;
-			ret = 0;
-		} else if (!ret) {
-			io_u_mark_submit(td, ret);
-			continue;
-		} else {
-			if (errno == EAGAIN || errno == EINTR) {
-				ret = fio_ioring_cqring_reap(td, 0, ld->queued);
-				if (ret)
-					continue;
-				/* Shouldn't happen */
-				usleep(1);
-				continue;
-			}
-			ret = -errno;
-			td_verror(td, errno, "io_uring_enter submit");
-			break;
-		}
-	} while (ld->queued);
+	if (!sh)
+		return;
 
-	return ret;
+	pthread_mutex_lock(&sq_shares.lock);
+	if (!--sh->refs) {
+		flist_del(&sh->list);
+		close(sh->ring_fd);
+		free(sh);
+	}
+	pthread_mutex_unlock(&sq_shares.lock);
+	ld->sq_share = NULL;
 }
 
 static void fio_ioring_unmap(struct ioring_data *ld)
@@ -697,11 +1467,32 @@ static void fio_ioring_cleanup(struct thread_data *td)
 	struct ioring_data *ld = td->io_ops_data;
 
 	if (ld) {
-		if (!(td->flags & TD_F_CHILD))
+		unsigned int i;
+
+		for (i = 1; i < ld->nr_rings; i++) {
+			struct ioring_data *r = ld->rings[i];
+
+			if (!(td->flags & TD_F_CHILD) && r->ring_fd != -1)
+				fio_ioring_unmap(r);
+			free(r);
+		}
+		free(ld->rings);
+		free(ld->ring_pfds);
+
+		if (!(td->flags & TD_F_CHILD)) {
 			fio_ioring_unmap(ld);
+			fio_ioring_sq_share_put(ld);
+		}
 
 		fio_cmdprio_cleanup(&ld->cmdprio);
+		free(ld->br);
+		if (ld->br_own_bufs)
+			free(ld->br_bufs);
+		free(ld->br_done);
+		free(ld->events);
 		free(ld->io_u_index);
+		free(ld->submit_seq);
+		free(ld->sg_iovecs);
 		free(ld->iovecs);
 		free(ld->fds);
 		free(ld);
@@ -760,19 +1551,23 @@ static void fio_ioring_probe(struct thread_data *td)
 {
 	struct ioring_data *ld = td->io_ops_data;
 	struct ioring_options *o = td->eo;
+	bool probe_nonvectored = o->nonvectored == -1;
+	bool probe_sg_fixed = ld->sg_iovecs && o->fixedbufs;
 	struct io_uring_probe *p;
 	int ret;
 
-	/* already set by user, don't touch */
-	if (o->nonvectored != -1)
+	/*
+	 * default to off, as that's always safe. If already set by user,
+	 * don't touch
+	 */
+	if (probe_nonvectored)
+		o->nonvectored = 0;
+	if (!probe_nonvectored && !probe_sg_fixed)
 		return;
 
-	/* default to off, as that's always safe */
-	o->nonvectored = 0;
-
 	p = malloc(sizeof(*p) + 256 * sizeof(struct io_uring_probe_op));
 	if (!p)
-		return;
+		goto out;
 
 	memset(p, 0, sizeof(*p) + 256 * sizeof(struct io_uring_probe_op));
 	ret = syscall(__NR_io_uring_register, ld->ring_fd,
@@ -780,19 +1575,153 @@ static void fio_ioring_probe(struct thread_data *td)
 	if (ret < 0)
 		goto out;
 
-	if (IORING_OP_WRITE > p->ops_len)
-		goto out;
-
-	if ((p->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED) &&
+	if (probe_nonvectored && IORING_OP_WRITE <= p->ops_len &&
+	    (p->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED) &&
 	    (p->ops[IORING_OP_WRITE].flags & IO_URING_OP_SUPPORTED))
 		o->nonvectored = 1;
+
+	if (probe_sg_fixed && IORING_OP_WRITEV_FIXED < p->ops_len &&
+	    (p->ops[IORING_OP_READV_FIXED].flags & IO_URING_OP_SUPPORTED) &&
+	    (p->ops[IORING_OP_WRITEV_FIXED].flags & IO_URING_OP_SUPPORTED))
+		ld->sg_fixed = 1;
 out:
+	if (probe_sg_fixed && !ld->sg_fixed)
+		log_info("fio: io_uring kernel lacks READV_FIXED/WRITEV_FIXED, "
+			 "sg segments won't use the registered buffers\n");
 	free(p);
 }
 
-static int fio_ioring_queue_init(struct thread_data *td)
+static int fio_ioring_br_setup(struct thread_data *td)
 {
 	struct ioring_data *ld = td->io_ops_data;
+	struct ioring_options *o = td->eo;
+	unsigned int i, nr = td->o.iodepth;
+	struct io_uring_buf_reg reg;
+	int ret;
+
+	if (o->buffer_ring_entries)
+		nr = min(roundup_pow2(o->buffer_ring_entries), nr);
+
+	ld->br_buf_size = td_max_bs(td);
+	ld->br_entries = nr;
+	ld->br_mask = nr - 1;
+
+	if (posix_memalign((void **) &ld->br, page_size,
+			   nr * sizeof(struct io_uring_buf))) {
+		errno = ENOMEM;
+		return -1;
+	}
+
+	/*
+	 * A read-only job never uses the buffers of its io_us, so let the
+	 * ring hand those out instead of allocating a second set. Jobs that
+	 * also write need their io_u buffers for that, and get a separate
+	 * pool of nr buffers.
+	 */
+	if (!td_write(td)) {
+		ld->br_bufs = td->io_u_all.io_us[0]->buf;
+	} else {
+		if (posix_memalign(&ld->br_bufs, page_size,
+				   (size_t) nr * ld->br_buf_size)) {
+			errno = ENOMEM;
+			return -1;
+		}
+		ld->br_own_bufs = true;
+	}
+	memset(ld->br, 0, nr * sizeof(struct io_uring_buf));
+	ld->br_done = calloc(nr, sizeof(unsigned short));
+
+	memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = (unsigned long) ld->br;
+	reg.ring_entries = nr;
+	reg.bgid = 0;
+
+	ret = syscall(__NR_io_uring_register, ld->ring_fd,
+			IORING_REGISTER_PBUF_RING, &reg, 1);
+	if (ret < 0)
+		return ret;
+
+	for (i = 0; i < nr; i++)
+		fio_ioring_br_add(ld, i);
+	atomic_store_release(&ld->br->tail, ld->br_tail);
+	return 0;
+}
+
+/*
+ * Register the ring fd, so io_uring_enter doesn't have to look it up on
+ * every call. Only available on newer kernels, keep using the plain fd if
+ * it fails.
+ */
+static void fio_ioring_register_ring_fd(struct ioring_data *ld)
+{
+	struct io_uring_rsrc_update up = {
+		.offset	= -1U,
+		.data	= ld->ring_fd,
+	};
+	int ret;
+
+	ld->enter_fd = ld->ring_fd;
+	ld->enter_flags = 0;
+
+	ret = syscall(__NR_io_uring_register, ld->ring_fd,
+			IORING_REGISTER_RING_FDS, &up, 1);
+	if (ret != 1)
+		return;
+
+	ld->enter_fd = up.offset;
+	ld->enter_flags = IORING_ENTER_REGISTERED_RING;
+}
+
+/*
+ * Apply the io-wq worker limits and affinity. With sqthread_share, the io-wq
+ * is shared with the ring that was attached to, and so are the settings.
+ */
+static int fio_ioring_register_iowq(struct thread_data *td,
+				    struct ioring_data *ld)
+{
+	struct ioring_options *o = td->eo;
+	int ret;
+
+#ifdef FIO_HAVE_CPU_AFFINITY
+	if (o->iowq_cpus) {
+		os_cpu_mask_t mask;
+
+		if (set_cpus_allowed(td, &mask, o->iowq_cpus)) {
+			errno = EINVAL;
+			return -1;
+		}
+
+		ret = syscall(__NR_io_uring_register, ld->ring_fd,
+				IORING_REGISTER_IOWQ_AFF, &mask, sizeof(mask));
+		fio_cpuset_exit(&mask);
+		if (ret < 0) {
+			log_err("fio: io_uring failed to set io-wq affinity\n");
+			return ret;
+		}
+	}
+#endif
+
+	if (o->iowq_bounded || o->iowq_unbounded) {
+		__u32 max_workers[2] = { o->iowq_bounded, o->iowq_unbounded };
+
+		ret = syscall(__NR_io_uring_register, ld->ring_fd,
+				IORING_REGISTER_IOWQ_MAX_WORKERS, max_workers, 2);
+		if (ret < 0) {
+			log_err("fio: io_uring failed to set io-wq max workers\n");
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Set up ring number 'ring' of the job. With several rings, each one gets
+ * its own SQ thread, pinned to sqthread_poll_cpu + ring if that is set.
+ */
+static int fio_ioring_ring_init(struct thread_data *td, struct ioring_data *ld,
+				unsigned int ring)
+{
 	struct ioring_options *o = td->eo;
 	int depth = td->o.iodepth;
 	struct io_uring_params p;
@@ -806,7 +1735,7 @@ static int fio_ioring_queue_init(struct thread_data *td)
 		p.flags |= IORING_SETUP_SQPOLL;
 		if (o->sqpoll_set) {
 			p.flags |= IORING_SETUP_SQ_AFF;
-			p.sq_thread_cpu = o->sqpoll_cpu;
+			p.sq_thread_cpu = o->sqpoll_cpu + ring;
 		}
 
 		/*
@@ -823,7 +1752,7 @@ static int fio_ioring_queue_init(struct thread_data *td)
 	 * than that.
 	 */
 	p.flags |= IORING_SETUP_CQSIZE;
-	p.cq_entries = depth;
+	p.cq_entries = depth * ld->sqes_per_io;
 
 	/*
 	 * Setup COOP_TASKRUN as we don't need to get IPI interrupted for
@@ -833,14 +1762,22 @@ static int fio_ioring_queue_init(struct thread_data *td)
 
 	/*
 	 * io_uring is always a single issuer, and we can defer task_work
-	 * runs until we reap events.
+	 * runs until we reap events. Not with several rings though: the job
+	 * waits on those with poll(2), and deferred task_work of a ring only
+	 * runs when io_uring_enter is called on it, so its completions would
+	 * never be posted.
 	 */
-	p.flags |= IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+	p.flags |= IORING_SETUP_SINGLE_ISSUER;
+	if (o->rings <= 1)
+		p.flags |= IORING_SETUP_DEFER_TASKRUN;
+
+	if (o->sqpoll_thread)
+		fio_ioring_sq_share_begin(td, &p);
 
 retry:
-	ret = syscall(__NR_io_uring_setup, depth, &p);
+	ret = syscall(__NR_io_uring_setup, depth * ld->sqes_per_io, &p);
 	if (ret < 0) {
-		if (errno == EINVAL && p.flags & IORING_SETUP_DEFER_TASKRUN) {
+		if (errno == EINVAL && p.flags & IORING_SETUP_SINGLE_ISSUER) {
 			p.flags &= ~IORING_SETUP_DEFER_TASKRUN;
 			p.flags &= ~IORING_SETUP_SINGLE_ISSUER;
 			goto retry;
@@ -853,12 +1790,30 @@ retry:
 			p.flags &= ~IORING_SETUP_CQSIZE;
 			goto retry;
 		}
+		if (o->sqpoll_thread)
+			fio_ioring_sq_share_end(td, -1);
 		return ret;
 	}
 
 	ld->ring_fd = ret;
+	if (o->sqpoll_thread)
+		fio_ioring_sq_share_end(td, ret);
 
-	fio_ioring_probe(td);
+	fio_ioring_register_ring_fd(ld);
+
+	if (o->complete_timeout && !(p.features & IORING_FEAT_EXT_ARG)) {
+		log_err("fio: io_uring complete_timeout requires a kernel with "
+			"IORING_FEAT_EXT_ARG\n");
+		errno = EINVAL;
+		return -1;
+	}
+
+	ret = fio_ioring_register_iowq(td, ld);
+	if (ret < 0)
+		return ret;
+
+	if (!ring)
+		fio_ioring_probe(td);
 
 	if (o->fixedbufs) {
 		ret = syscall(__NR_io_uring_register, ld->ring_fd,
@@ -867,9 +1822,35 @@ retry:
 			return ret;
 	}
 
+	if (o->buffer_ring) {
+		ret = fio_ioring_br_setup(td);
+		if (ret < 0)
+			return ret;
+	}
+
 	return fio_ioring_mmap(ld, &p);
 }
 
+static int fio_ioring_queue_init(struct thread_data *td)
+{
+	struct ioring_data *ld = td->io_ops_data;
+	unsigned int i;
+	int ret;
+
+	ret = fio_ioring_ring_init(td, ld, 0);
+	if (ret)
+		return ret;
+
+	for (i = 1; i < ld->nr_rings; i++) {
+		ld->rings[i]->sg_fixed = ld->sg_fixed;
+		ret = fio_ioring_ring_init(td, ld->rings[i], i);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
 static int fio_ioring_cmd_queue_init(struct thread_data *td)
 {
 	struct ioring_data *ld = td->io_ops_data;
@@ -921,6 +1902,9 @@ static int fio_ioring_cmd_queue_init(struct thread_data *td)
 	 */
 	p.flags |= IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
 
+	if (o->sqpoll_thread)
+		fio_ioring_sq_share_begin(td, &p);
+
 retry:
 	ret = syscall(__NR_io_uring_setup, depth, &p);
 	if (ret < 0) {
@@ -937,10 +1921,20 @@ retry:
 			p.flags &= ~IORING_SETUP_CQSIZE;
 			goto retry;
 		}
+		if (o->sqpoll_thread)
+			fio_ioring_sq_share_end(td, -1);
 		return ret;
 	}
 
 	ld->ring_fd = ret;
+	if (o->sqpoll_thread)
+		fio_ioring_sq_share_end(td, ret);
+
+	fio_ioring_register_ring_fd(ld);
+
+	ret = fio_ioring_register_iowq(td, ld);
+	if (ret < 0)
+		return ret;
 
 	fio_ioring_probe(td);
 
@@ -973,6 +1967,9 @@ static int fio_ioring_register_files(struct thread_data *td)
 
 	ret = syscall(__NR_io_uring_register, ld->ring_fd,
 			IORING_REGISTER_FILES, ld->fds, td->o.nr_files);
+	for (i = 1; !ret && i < ld->nr_rings; i++)
+		ret = syscall(__NR_io_uring_register, ld->rings[i]->ring_fd,
+				IORING_REGISTER_FILES, ld->fds, td->o.nr_files);
 	if (ret) {
 err:
 		free(ld->fds);
@@ -1022,7 +2019,7 @@ static int fio_ioring_post_init(struct thread_data *td)
 	for (i = 0; i < td->o.iodepth; i++) {
 		struct io_uring_sqe *sqe;
 
-		sqe = &ld->sqes[i];
+		sqe = &fio_ioring_ring(td, ld->io_u_index[i])->sqes[i];
 		memset(sqe, 0, sizeof(*sqe));
 	}
 
@@ -1037,6 +2034,39 @@ static int fio_ioring_post_init(struct thread_data *td)
 	return 0;
 }
 
+static int fio_ioring_fileop_post_init(struct thread_data *td)
+{
+	struct ioring_options *o = td->eo;
+	const char *opt = NULL;
+
+	/* sqthread_poll turns on registerfiles, name what the user set */
+	if (o->sqpoll_thread)
+		opt = "sqthread_poll";
+	else if (o->registerfiles)
+		opt = "registerfiles";
+	else if (o->buffer_ring)
+		opt = "buffer_ring";
+	else if (o->link_sync)
+		opt = "link_sync";
+	else if (o->io_timeout)
+		opt = "io_timeout";
+	else if (o->rings > 1)
+		opt = "rings";
+
+	if (opt) {
+		log_err("fio: io_uring_fileop does not support %s\n", opt);
+		return 1;
+	}
+
+	if (td_read(td) && td_max_bs(td) < sizeof(struct statx)) {
+		log_err("fio: io_uring_fileop needs a block size of at least "
+			"%zu to stat files\n", sizeof(struct statx));
+		return 1;
+	}
+
+	return fio_ioring_post_init(td);
+}
+
 static int fio_ioring_cmd_post_init(struct thread_data *td)
 {
 	struct ioring_data *ld = td->io_ops_data;
@@ -1044,6 +2074,26 @@ static int fio_ioring_cmd_post_init(struct thread_data *td)
 	struct io_u *io_u;
 	int err, i;
 
+	if (o->buffer_ring) {
+		log_err("fio: io_uring_cmd does not support buffer_ring\n");
+		return 1;
+	}
+
+	if (o->link_sync) {
+		log_err("fio: io_uring_cmd does not support link_sync\n");
+		return 1;
+	}
+
+	if (o->io_timeout) {
+		log_err("fio: io_uring_cmd does not support io_timeout\n");
+		return 1;
+	}
+
+	if (o->rings > 1) {
+		log_err("fio: io_uring_cmd does not support rings\n");
+		return 1;
+	}
+
 	for (i = 0; i < td->o.iodepth; i++) {
 		struct iovec *iov = &ld->iovecs[i];
 
@@ -1093,12 +2143,111 @@ static int fio_ioring_init(struct thread_data *td)
 	if (o->sqpoll_thread)
 		o->registerfiles = 1;
 
+	if (o->buffer_ring) {
+		if (o->fixedbufs) {
+			log_err("fio: io_uring buffer_ring and fixedbufs are "
+				"mutually exclusive\n");
+			return 1;
+		}
+		if (td->o.sg_segments || td->o.sg_segment_size) {
+			log_err("fio: io_uring buffer_ring does not support "
+				"sg_segments or sg_segment_size\n");
+			return 1;
+		}
+		if (td->o.verify != VERIFY_NONE) {
+			log_err("fio: io_uring buffer_ring does not support "
+				"verify\n");
+			return 1;
+		}
+	}
+
+	if (o->sqthread_share) {
+		if (!o->sqpoll_thread) {
+			log_err("fio: io_uring sqthread_share requires "
+				"sqthread_poll\n");
+			return 1;
+		}
+		/* rings can only be attached to within the same process */
+		if (!td->o.use_thread) {
+			log_err("fio: io_uring sqthread_share requires "
+				"thread\n");
+			return 1;
+		}
+	}
+
+	/* with sqthread_poll, submission isn't done from io_uring_enter */
+	if (o->count_inline && o->sqpoll_thread) {
+		log_err("fio: io_uring count_inline can't be used with "
+			"sqthread_poll\n");
+		return 1;
+	}
+
+	if (o->link_sync && !td->o.fsync_blocks && !td->o.fdatasync_blocks &&
+	    !td->sync_file_range_nr) {
+		log_err("fio: io_uring link_sync requires fsync, fdatasync or "
+			"sync_file_range\n");
+		return 1;
+	}
+
+	/*
+	 * The writes between two syncs and the sync itself are held back
+	 * until the whole chain is queued, so it has to fit in the queue.
+	 * Otherwise it ends up being submitted in unlinked pieces.
+	 */
+	if (o->link_sync) {
+		unsigned int chain = max(td->o.fsync_blocks,
+					 td->o.fdatasync_blocks);
+
+		chain = max(chain, td->sync_file_range_nr);
+		if (chain >= td->o.iodepth) {
+			log_err("fio: io_uring link_sync needs an iodepth larger "
+				"than fsync, fdatasync or sync_file_range (%u)\n",
+				chain);
+			return 1;
+		}
+	}
+
+	if (o->io_timeout && o->link_sync) {
+		log_err("fio: io_uring io_timeout and link_sync are mutually "
+			"exclusive\n");
+		return 1;
+	}
+
 	if (o->registerfiles && td->o.nr_files != td->o.open_files) {
 		log_err("fio: io_uring registered files require nr_files to "
 			"be identical to open_files\n");
 		return 1;
 	}
 
+	if (o->rings > 1) {
+		if (o->buffer_ring || o->link_sync || o->io_timeout ||
+		    o->sqthread_share || o->complete_timeout) {
+			log_err("fio: io_uring rings can't be combined with "
+				"buffer_ring, link_sync, io_timeout, "
+				"sqthread_share or complete_timeout\n");
+			return 1;
+		}
+		if (td->o.iodepth < o->rings) {
+			log_err("fio: io_uring rings can't exceed iodepth\n");
+			return 1;
+		}
+		/*
+		 * Without an SQ thread per ring, the job thread would do all
+		 * the submission and completion work of every ring itself.
+		 */
+		if (!o->sqpoll_thread) {
+			log_err("fio: io_uring rings requires sqthread_poll\n");
+			return 1;
+		}
+		if (o->sqpoll_set &&
+		    o->sqpoll_cpu + o->rings > cpus_configured()) {
+			log_err("fio: io_uring rings pins SQ threads to CPUs "
+				"%u-%u, only %u configured\n", o->sqpoll_cpu,
+				o->sqpoll_cpu + o->rings - 1, cpus_configured());
+			return 1;
+		}
+	}
+
 	ld = calloc(1, sizeof(*ld));
 
 	/* ring depth must be a power-of-2 */
@@ -1108,6 +2257,49 @@ static int fio_ioring_init(struct thread_data *td)
 	/* io_u index */
 	ld->io_u_index = calloc(td->o.iodepth, sizeof(struct io_u *));
 	ld->iovecs = calloc(td->o.iodepth, sizeof(struct iovec));
+	if (o->count_inline)
+		ld->submit_seq = calloc(td->o.iodepth, sizeof(unsigned int));
+
+	ld->sg_max_segs = td_max_sg_segments(td);
+	if (ld->sg_max_segs)
+		ld->sg_iovecs = calloc(td->o.iodepth * ld->sg_max_segs,
+					sizeof(struct iovec));
+
+	ld->sqes_per_io = 1;
+	if (o->io_timeout) {
+		ld->sqes_per_io = 2;
+		ld->timeout_ts.tv_sec = o->io_timeout / 1000000;
+		ld->timeout_ts.tv_nsec = (o->io_timeout % 1000000) * 1000;
+		ld->events = calloc(td->o.iodepth, sizeof(struct io_u *));
+	}
+
+	ld->nr_rings = o->rings;
+	if (ld->nr_rings > 1) {
+		unsigned int i;
+
+		/*
+		 * Each ring is sized for the whole depth, so that SQEs can be
+		 * indexed by io_u->index on all of them.
+		 */
+		ld->events = calloc(td->o.iodepth, sizeof(struct io_u *));
+		ld->rings = calloc(ld->nr_rings, sizeof(struct ioring_data *));
+		ld->ring_pfds = calloc(ld->nr_rings, sizeof(struct pollfd));
+		ld->rings[0] = ld;
+		for (i = 1; i < ld->nr_rings; i++) {
+			struct ioring_data *r = calloc(1, sizeof(*r));
+
+			r->ring_fd = -1;
+			r->iodepth = ld->iodepth;
+			r->sqes_per_io = ld->sqes_per_io;
+			r->io_u_index = ld->io_u_index;
+			r->iovecs = ld->iovecs;
+			r->submit_seq = ld->submit_seq;
+			r->events = ld->events;
+			r->sg_iovecs = ld->sg_iovecs;
+			r->sg_max_segs = ld->sg_max_segs;
+			ld->rings[i] = r;
+		}
+	}
 
 	td->io_ops_data = ld;
 
@@ -1184,6 +2376,28 @@ static int fio_ioring_close_file(struct thread_data *td, struct fio_file *f)
 	return 0;
 }
 
+/*
+ * The file is only ever accessed by name, so there's nothing to open.
+ */
+static int fio_ioring_fileop_open_file(struct thread_data *td,
+				       struct fio_file *f)
+{
+	return 0;
+}
+
+static int fio_ioring_fileop_close_file(struct thread_data *td,
+					struct fio_file *f)
+{
+	f->fd = -1;
+	return 0;
+}
+
+static int fio_ioring_fileop_invalidate(struct thread_data *td,
+					struct fio_file *f)
+{
+	return 0;
+}
+
 static int fio_ioring_cmd_close_file(struct thread_data *td,
 				     struct fio_file *f)
 {
@@ -1266,7 +2480,8 @@ static struct ioengine_ops ioengine_uring = {
 	.name			= "io_uring",
 	.version		= FIO_IOOPS_VERSION,
 	.flags			= FIO_ASYNCIO_SYNC_TRIM | FIO_NO_OFFLOAD |
-					FIO_ASYNCIO_SETS_ISSUE_TIME,
+					FIO_ASYNCIO_SETS_ISSUE_TIME |
+					FIO_SG_SEGMENTS,
 	.init			= fio_ioring_init,
 	.post_init		= fio_ioring_post_init,
 	.io_u_init		= fio_ioring_io_u_init,
@@ -1309,15 +2524,39 @@ static struct ioengine_ops ioengine_uring_cmd = {
 	.option_struct_size	= sizeof(struct ioring_options),
 };
 
+static struct ioengine_ops ioengine_uring_fileop = {
+	.name			= "io_uring_fileop",
+	.version		= FIO_IOOPS_VERSION,
+	.flags			= FIO_NO_OFFLOAD | FIO_FAKEIO | FIO_NOFILEHASH |
+					FIO_ASYNCIO_SETS_ISSUE_TIME,
+	.init			= fio_ioring_init,
+	.post_init		= fio_ioring_fileop_post_init,
+	.io_u_init		= fio_ioring_io_u_init,
+	.prep			= fio_ioring_fileop_prep,
+	.queue			= fio_ioring_queue,
+	.commit			= fio_ioring_commit,
+	.getevents		= fio_ioring_getevents,
+	.event			= fio_ioring_fileop_event,
+	.cleanup		= fio_ioring_cleanup,
+	.open_file		= fio_ioring_fileop_open_file,
+	.close_file		= fio_ioring_fileop_close_file,
+	.invalidate		= fio_ioring_fileop_invalidate,
+	.get_file_size		= generic_get_file_size,
+	.options		= options,
+	.option_struct_size	= sizeof(struct ioring_options),
+};
+
 static void fio_init fio_ioring_register(void)
 {
 	register_ioengine(&ioengine_uring);
 	register_ioengine(&ioengine_uring_cmd);
+	register_ioengine(&ioengine_uring_fileop);
 }
 
 static void fio_exit fio_ioring_unregister(void)
 {
 	unregister_ioengine(&ioengine_uring);
 	unregister_ioengine(&ioengine_uring_cmd);
+	unregister_ioengine(&ioengine_uring_fileop);
 }
 #endif
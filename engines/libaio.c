@@ -52,6 +52,10 @@ struct libaio_data {
 	unsigned int head;
 	unsigned int tail;
 
+	/* sg_max_segs iovecs per io_u, with sg_segments/sg_segment_size */
+	struct iovec *sg_iovecs;
+	unsigned int sg_max_segs;
+
 	struct cmdprio cmdprio;
 };
 
@@ -176,18 +180,39 @@ static inline void ring_inc(struct libaio_data *ld, unsigned int *val,
 		*val = (*val + add) % ld->entries;
 }
 
+static void fio_libaio_prep_sg(struct thread_data *td, struct io_u *io_u)
+{
+	struct libaio_data *ld = td->io_ops_data;
+	struct iovec *iov = &ld->sg_iovecs[io_u->index * ld->sg_max_segs];
+	struct iocb *iocb = &io_u->iocb;
+	int nr;
+
+	nr = io_u_fill_sg(td, io_u, iov);
+	if (io_u->ddir == DDIR_READ)
+		io_prep_preadv(iocb, io_u->file->fd, iov, nr, io_u->offset);
+	else
+		io_prep_pwritev(iocb, io_u->file->fd, iov, nr, io_u->offset);
+}
+
 static int fio_libaio_prep(struct thread_data *td, struct io_u *io_u)
 {
+	struct libaio_data *ld = td->io_ops_data;
 	struct libaio_options *o = td->eo;
 	struct fio_file *f = io_u->file;
 	struct iocb *iocb = &io_u->iocb;
 
 	if (io_u->ddir == DDIR_READ) {
-		io_prep_pread(iocb, f->fd, io_u->xfer_buf, io_u->xfer_buflen, io_u->offset);
+		if (ld->sg_iovecs)
+			fio_libaio_prep_sg(td, io_u);
+		else
+			io_prep_pread(iocb, f->fd, io_u->xfer_buf, io_u->xfer_buflen, io_u->offset);
 		if (o->nowait)
 			iocb->aio_rw_flags |= RWF_NOWAIT;
 	} else if (io_u->ddir == DDIR_WRITE) {
-		io_prep_pwrite(iocb, f->fd, io_u->xfer_buf, io_u->xfer_buflen, io_u->offset);
+		if (ld->sg_iovecs)
+			fio_libaio_prep_sg(td, io_u);
+		else
+			io_prep_pwrite(iocb, f->fd, io_u->xfer_buf, io_u->xfer_buflen, io_u->offset);
 		if (o->nowait)
 			iocb->aio_rw_flags |= RWF_NOWAIT;
 	} else if (ddir_sync(io_u->ddir))
@@ -471,6 +496,7 @@ static void fio_libaio_cleanup(struct thread_data *td)
 		free(ld->aio_events);
 		free(ld->iocbs);
 		free(ld->io_us);
+		free(ld->sg_iovecs);
 		free(ld);
 	}
 }
@@ -503,6 +529,11 @@ static int fio_libaio_init(struct thread_data *td)
 	ld->iocbs = calloc(ld->entries, sizeof(struct iocb *));
 	ld->io_us = calloc(ld->entries, sizeof(struct io_u *));
 
+	ld->sg_max_segs = td_max_sg_segments(td);
+	if (ld->sg_max_segs)
+		ld->sg_iovecs = calloc(ld->entries * ld->sg_max_segs,
+					sizeof(struct iovec));
+
 	td->io_ops_data = ld;
 
 	ret = fio_cmdprio_init(td, &ld->cmdprio, &o->cmdprio_options);
@@ -518,7 +549,8 @@ FIO_STATIC struct ioengine_ops ioengine = {
 	.name			= "libaio",
 	.version		= FIO_IOOPS_VERSION,
 	.flags			= FIO_ASYNCIO_SYNC_TRIM |
-					FIO_ASYNCIO_SETS_ISSUE_TIME,
+					FIO_ASYNCIO_SETS_ISSUE_TIME |
+					FIO_SG_SEGMENTS,
 	.init			= fio_libaio_init,
 	.post_init		= fio_libaio_post_init,
 	.prep			= fio_libaio_prep,
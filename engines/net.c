@@ -22,6 +22,13 @@
 #include "../verify.h"
 #include "../optgroup.h"
 
+#if defined(__linux__) && defined(ARCH_HAVE_IOURING)
+#define FIO_HAVE_NET_URING
+#include <sys/mman.h>
+#include "../lib/roundup.h"
+#include "../os/linux/io_uring.h"
+#endif
+
 struct netio_data {
 	int listenfd;
 	int use_splice;
@@ -32,6 +39,7 @@ struct netio_data {
 	struct sockaddr_un addr_un;
 	uint64_t udp_send_seq;
 	uint64_t udp_recv_seq;
+	struct netio_uring *uring;
 };
 
 struct netio_options {
@@ -44,6 +52,8 @@ struct netio_options {
 	unsigned int ttl;
 	unsigned int window_size;
 	unsigned int mss;
+	unsigned int zerocopy;
+	unsigned int recv_multishot;
 	char *intfc;
 };
 
@@ -203,6 +213,26 @@ static struct fio_option options[] = {
 		.group	= FIO_OPT_G_NETIO,
 	},
 #endif
+	{
+		.name	= "zerocopy",
+		.lname	= "Zero-copy send",
+		.type	= FIO_OPT_BOOL,
+		.off1	= offsetof(struct netio_options, zerocopy),
+		.help	= "Use IORING_OP_SEND_ZC for sends (net_uring)",
+		.def	= "0",
+		.category = FIO_OPT_C_ENGINE,
+		.group	= FIO_OPT_G_NETIO,
+	},
+	{
+		.name	= "recv_multishot",
+		.lname	= "Multishot receive",
+		.type	= FIO_OPT_BOOL,
+		.off1	= offsetof(struct netio_options, recv_multishot),
+		.help	= "Use multishot receive with provided buffers (net_uring)",
+		.def	= "0",
+		.category = FIO_OPT_C_ENGINE,
+		.group	= FIO_OPT_G_NETIO,
+	},
 	{
 		.name	= NULL,
 	},
@@ -1440,6 +1470,661 @@ static struct ioengine_ops ioengine_rw = {
 				  FIO_PIPEIO | FIO_BIT_BASED,
 };
 
+#ifdef FIO_HAVE_NET_URING
+/*
+ * net_uring shares the socket setup with the net engine, but issues the
+ * data transfers through io_uring. Sends can use IORING_OP_SEND_ZC, and
+ * receives can use one multishot IORING_OP_RECV per socket that picks its
+ * buffers from a provided buffer ring.
+ */
+
+/* user_data of the multishot receive, io_u pointers are never odd */
+#define NETIO_URING_RECV	1ULL
+
+/*
+ * Result of the multishot receive that hasn't been consumed by reads yet
+ */
+struct netio_uring_chunk {
+	int res;
+	int bid;
+	unsigned int off;
+};
+
+struct netio_uring {
+	int ring_fd;
+
+	unsigned *sq_head;
+	unsigned *sq_tail;
+	unsigned *sq_array;
+	unsigned sq_mask;
+	unsigned sq_entries;
+	unsigned sq_local_tail;
+	struct io_uring_sqe *sqes;
+
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned cq_mask;
+	struct io_uring_cqe *cqes;
+
+	void *mmap_ptr[3];
+	size_t mmap_len[3];
+
+	unsigned int depth;
+	unsigned int to_submit;
+	unsigned int io_u_queued;
+
+	struct io_u **events;
+	unsigned int nr_events;
+
+	/*
+	 * Multishot receive. Reads wait in recv_wait and are filled from the
+	 * received chunks in order, the first one has recv_filled bytes.
+	 */
+	struct fio_file *recv_file;
+	int recv_armed;
+	struct io_u **recv_wait;
+	unsigned int recv_wait_head;
+	unsigned int recv_wait_tail;
+	unsigned int recv_filled;
+	struct netio_uring_chunk *chunks;
+	unsigned int chunk_head;
+	unsigned int chunk_tail;
+
+	struct io_uring_buf_ring *br;
+	void *br_bufs;
+	unsigned int br_buf_size;
+	unsigned short br_tail;
+};
+
+static int fio_netio_uring_mmap(struct netio_uring *nu,
+				struct io_uring_params *p)
+{
+	void *ptr;
+
+	nu->mmap_len[0] = p->sq_off.array + p->sq_entries * sizeof(__u32);
+	ptr = mmap(0, nu->mmap_len[0], PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, nu->ring_fd,
+			IORING_OFF_SQ_RING);
+	if (ptr == MAP_FAILED)
+		return -1;
+	nu->mmap_ptr[0] = ptr;
+	nu->sq_head = ptr + p->sq_off.head;
+	nu->sq_tail = ptr + p->sq_off.tail;
+	nu->sq_array = ptr + p->sq_off.array;
+	nu->sq_mask = *(unsigned *) (ptr + p->sq_off.ring_mask);
+	nu->sq_entries = p->sq_entries;
+	nu->sq_local_tail = *nu->sq_tail;
+
+	nu->mmap_len[1] = p->sq_entries * sizeof(struct io_uring_sqe);
+	ptr = mmap(0, nu->mmap_len[1], PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, nu->ring_fd,
+			IORING_OFF_SQES);
+	if (ptr == MAP_FAILED)
+		return -1;
+	nu->mmap_ptr[1] = ptr;
+	nu->sqes = ptr;
+
+	nu->mmap_len[2] = p->cq_off.cqes +
+				p->cq_entries * sizeof(struct io_uring_cqe);
+	ptr = mmap(0, nu->mmap_len[2], PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, nu->ring_fd,
+			IORING_OFF_CQ_RING);
+	if (ptr == MAP_FAILED)
+		return -1;
+	nu->mmap_ptr[2] = ptr;
+	nu->cq_head = ptr + p->cq_off.head;
+	nu->cq_tail = ptr + p->cq_off.tail;
+	nu->cq_mask = *(unsigned *) (ptr + p->cq_off.ring_mask);
+	nu->cqes = ptr + p->cq_off.cqes;
+	return 0;
+}
+
+static void fio_netio_uring_br_add(struct netio_uring *nu, unsigned short bid)
+{
+	struct io_uring_buf *buf;
+
+	buf = &nu->br->bufs[nu->br_tail & (nu->depth - 1)];
+	buf->addr = (unsigned long) nu->br_bufs + (unsigned long) bid * nu->br_buf_size;
+	buf->len = nu->br_buf_size;
+	buf->bid = bid;
+	nu->br_tail++;
+}
+
+static int fio_netio_uring_br_setup(struct thread_data *td,
+				    struct netio_uring *nu)
+{
+	struct io_uring_buf_reg reg;
+	unsigned int i;
+	int ret;
+
+	nu->br_buf_size = td->o.max_bs[DDIR_READ];
+
+	if (posix_memalign((void **) &nu->br, page_size,
+			   nu->depth * sizeof(struct io_uring_buf)) ||
+	    posix_memalign(&nu->br_bufs, page_size,
+			   (size_t) nu->depth * nu->br_buf_size)) {
+		errno = ENOMEM;
+		return -1;
+	}
+	memset(nu->br, 0, nu->depth * sizeof(struct io_uring_buf));
+
+	memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = (unsigned long) nu->br;
+	reg.ring_entries = nu->depth;
+	reg.bgid = 0;
+
+	ret = syscall(__NR_io_uring_register, nu->ring_fd,
+			IORING_REGISTER_PBUF_RING, &reg, 1);
+	if (ret < 0)
+		return ret;
+
+	for (i = 0; i < nu->depth; i++)
+		fio_netio_uring_br_add(nu, i);
+	atomic_store_release(&nu->br->tail, nu->br_tail);
+	return 0;
+}
+
+static struct io_uring_sqe *fio_netio_uring_get_sqe(struct netio_uring *nu)
+{
+	struct io_uring_sqe *sqe;
+	unsigned index;
+
+	if (nu->sq_local_tail - atomic_load_acquire(nu->sq_head) >=
+	    nu->sq_entries)
+		return NULL;
+
+	index = nu->sq_local_tail & nu->sq_mask;
+	nu->sq_array[index] = index;
+	nu->sq_local_tail++;
+	nu->to_submit++;
+
+	sqe = &nu->sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	return sqe;
+}
+
+static int fio_netio_uring_submit(struct thread_data *td,
+				  struct netio_uring *nu)
+{
+	int ret;
+
+	atomic_store_release(nu->sq_tail, nu->sq_local_tail);
+
+	while (nu->to_submit) {
+		ret = syscall(__NR_io_uring_enter, nu->ring_fd, nu->to_submit,
+				0, 0, NULL, 0);
+		if (ret < 0) {
+			if (errno == EAGAIN || errno == EINTR)
+				continue;
+			td_verror(td, errno, "io_uring_enter submit");
+			return -errno;
+		}
+		nu->to_submit -= ret;
+	}
+
+	return 0;
+}
+
+static int fio_netio_uring_arm_recv(struct netio_uring *nu)
+{
+	struct io_uring_sqe *sqe;
+
+	sqe = fio_netio_uring_get_sqe(nu);
+	if (!sqe)
+		return 1;
+
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = nu->recv_file->fd;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = 0;
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->user_data = NETIO_URING_RECV;
+	nu->recv_armed = 1;
+	return 0;
+}
+
+static void fio_netio_uring_set_result(struct io_u *io_u, int res)
+{
+	if (res < 0)
+		io_u->error = -res;
+	else if (res != io_u->xfer_buflen)
+		io_u->resid = io_u->xfer_buflen - res;
+}
+
+/*
+ * Post-process a finished receive. Returns 1 if the sender closed the link,
+ * in which case there's no data to account.
+ */
+static int fio_netio_uring_recv_done(struct thread_data *td,
+				     struct io_u *io_u, int res)
+{
+	struct netio_data *nd = td->io_ops_data;
+	struct netio_options *o = td->eo;
+
+	if (!res || is_close_msg(io_u, res)) {
+		td->done = 1;
+		return 1;
+	}
+
+	if (res > 0 && is_udp(o) && td->o.verify == VERIFY_NONE)
+		verify_udp_seq(td, nd, io_u);
+
+	return 0;
+}
+
+/*
+ * Copy received data into the first waiting read. Stream data is packed
+ * back to back, a datagram always ends the read it lands in. Returns the
+ * read if it is done, NULL if it needs more data.
+ */
+static struct io_u *fio_netio_uring_fill(struct thread_data *td,
+					 struct netio_uring *nu)
+{
+	struct netio_options *o = td->eo;
+	struct netio_uring_chunk *c;
+	struct io_u *io_u;
+	unsigned int len;
+	int res;
+
+	io_u = nu->recv_wait[nu->recv_wait_head % nu->depth];
+	c = &nu->chunks[nu->chunk_head % nu->depth];
+
+	if (c->res <= 0) {
+		/*
+		 * Error or end of stream, finish the read with what it has.
+		 * An error chunk is consumed, EOF sticks around for the reads
+		 * that come after this one.
+		 */
+		if (c->res < 0) {
+			io_u->error = -c->res;
+			nu->chunk_head++;
+		}
+		res = nu->recv_filled;
+	} else {
+		len = min((unsigned long long) (c->res - c->off),
+			  io_u->xfer_buflen - nu->recv_filled);
+		memcpy(io_u->xfer_buf + nu->recv_filled,
+			nu->br_bufs + (unsigned long) c->bid * nu->br_buf_size +
+			c->off, len);
+		nu->recv_filled += len;
+		c->off += len;
+
+		if (c->off == c->res || is_udp(o)) {
+			fio_netio_uring_br_add(nu, c->bid);
+			atomic_store_release(&nu->br->tail, nu->br_tail);
+			nu->chunk_head++;
+		}
+
+		if (nu->recv_filled < io_u->xfer_buflen && !is_udp(o))
+			return NULL;
+
+		res = nu->recv_filled;
+	}
+
+	nu->recv_wait_head++;
+	nu->recv_filled = 0;
+
+	if (!io_u->error) {
+		fio_netio_uring_set_result(io_u, res);
+		if (fio_netio_uring_recv_done(td, io_u, res))
+			io_u->resid = io_u->xfer_buflen;
+	}
+
+	return io_u;
+}
+
+static void fio_netio_uring_cqe(struct thread_data *td,
+				struct netio_uring *nu,
+				struct io_uring_cqe *cqe)
+{
+	struct io_u *io_u;
+
+	if (cqe->user_data == NETIO_URING_RECV) {
+		struct netio_uring_chunk *c;
+
+		if (!(cqe->flags & IORING_CQE_F_MORE))
+			nu->recv_armed = 0;
+
+		/*
+		 * Out of buffers, all of them hold data that is waiting to
+		 * be consumed by reads. Gets re-armed once reads are queued.
+		 */
+		if (cqe->res == -ENOBUFS)
+			return;
+
+		c = &nu->chunks[nu->chunk_tail++ % nu->depth];
+		c->res = cqe->res;
+		c->off = 0;
+		c->bid = -1;
+		if (cqe->flags & IORING_CQE_F_BUFFER)
+			c->bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+		return;
+	}
+
+	io_u = (struct io_u *) (uintptr_t) cqe->user_data;
+
+	/*
+	 * Zero-copy sends post the result first, and a notification once the
+	 * kernel no longer needs the buffer. Only the latter completes the
+	 * io_u.
+	 */
+	if (cqe->flags & IORING_CQE_F_NOTIF) {
+		nu->events[nu->nr_events++] = io_u;
+		return;
+	}
+
+	fio_netio_uring_set_result(io_u, cqe->res);
+	if (cqe->flags & IORING_CQE_F_MORE)
+		return;
+
+	if (io_u->ddir == DDIR_READ &&
+	    fio_netio_uring_recv_done(td, io_u, cqe->res))
+		io_u->resid = io_u->xfer_buflen;
+
+	nu->events[nu->nr_events++] = io_u;
+}
+
+static enum fio_q_status fio_netio_uring_queue_recv(struct thread_data *td,
+						    struct netio_uring *nu,
+						    struct io_u *io_u)
+{
+	nu->recv_file = io_u->file;
+	nu->recv_wait[nu->recv_wait_tail++ % nu->depth] = io_u;
+
+	/*
+	 * If this is the only read and there's enough data already, complete
+	 * it inline. The fill takes it off the wait list. If the sender
+	 * closed the link, it completes as an empty read, like it would from
+	 * the event path.
+	 */
+	if (nu->recv_wait_tail - nu->recv_wait_head == 1) {
+		while (nu->chunk_head != nu->chunk_tail) {
+			if (!fio_netio_uring_fill(td, nu))
+				continue;
+
+			io_u_mark_submit(td, 1);
+			io_u_mark_complete(td, 1);
+			return FIO_Q_COMPLETED;
+		}
+	}
+
+	if (!nu->recv_armed && fio_netio_uring_arm_recv(nu)) {
+		nu->recv_wait_tail--;
+		return FIO_Q_BUSY;
+	}
+
+	nu->io_u_queued++;
+	return FIO_Q_QUEUED;
+}
+
+static enum fio_q_status fio_netio_uring_queue(struct thread_data *td,
+					       struct io_u *io_u)
+{
+	struct netio_data *nd = td->io_ops_data;
+	struct netio_options *o = td->eo;
+	struct netio_uring *nu = nd->uring;
+	struct io_uring_sqe *sqe;
+
+	fio_ro_check(td, io_u);
+
+	if (!ddir_rw(io_u->ddir)) {
+		/* must be a SYNC */
+		io_u_mark_submit(td, 1);
+		io_u_mark_complete(td, 1);
+		return FIO_Q_COMPLETED;
+	}
+
+	if (io_u->ddir == DDIR_READ && nu->br)
+		return fio_netio_uring_queue_recv(td, nu, io_u);
+
+	sqe = fio_netio_uring_get_sqe(nu);
+	if (!sqe)
+		return FIO_Q_BUSY;
+
+	sqe->fd = io_u->file->fd;
+	sqe->addr = (unsigned long) io_u->xfer_buf;
+	sqe->len = io_u->xfer_buflen;
+	sqe->user_data = (unsigned long) io_u;
+
+	if (io_u->ddir == DDIR_WRITE) {
+		if (is_udp(o) && td->o.verify == VERIFY_NONE)
+			store_udp_seq(nd, io_u);
+		sqe->opcode = o->zerocopy ? IORING_OP_SEND_ZC : IORING_OP_SEND;
+	} else
+		sqe->opcode = IORING_OP_RECV;
+
+	/*
+	 * Don't complete stream transfers short, like the blocking net
+	 * engine they keep going until the full io_u has been moved.
+	 */
+	if (!is_udp(o))
+		sqe->msg_flags = MSG_WAITALL;
+
+	nu->io_u_queued++;
+	return FIO_Q_QUEUED;
+}
+
+static int fio_netio_uring_commit(struct thread_data *td)
+{
+	struct netio_data *nd = td->io_ops_data;
+	struct netio_uring *nu = nd->uring;
+	int ret;
+
+	if (!nu->io_u_queued)
+		return 0;
+
+	ret = fio_netio_uring_submit(td, nu);
+	if (ret)
+		return ret;
+
+	io_u_mark_submit(td, nu->io_u_queued);
+	nu->io_u_queued = 0;
+	return 0;
+}
+
+static int fio_netio_uring_getevents(struct thread_data *td, unsigned int min,
+				     unsigned int max,
+				     const struct timespec fio_unused *t)
+{
+	struct netio_data *nd = td->io_ops_data;
+	struct netio_uring *nu = nd->uring;
+	struct io_u *io_u;
+	unsigned head;
+	int ret;
+
+	nu->nr_events = 0;
+
+	do {
+		head = *nu->cq_head;
+		while (nu->nr_events < max &&
+		       head != atomic_load_acquire(nu->cq_tail)) {
+			fio_netio_uring_cqe(td, nu, &nu->cqes[head & nu->cq_mask]);
+			head++;
+		}
+		atomic_store_release(nu->cq_head, head);
+
+		while (nu->nr_events < max &&
+		       nu->recv_wait_head != nu->recv_wait_tail &&
+		       nu->chunk_head != nu->chunk_tail) {
+			io_u = fio_netio_uring_fill(td, nu);
+			if (io_u)
+				nu->events[nu->nr_events++] = io_u;
+		}
+
+		if (nu->nr_events >= min)
+			break;
+
+		/*
+		 * Multishot receive stopped with reads still waiting, most
+		 * likely after running out of buffers. Re-arm it before going
+		 * to sleep.
+		 */
+		if (!nu->recv_armed && nu->recv_wait_head != nu->recv_wait_tail &&
+		    !fio_netio_uring_arm_recv(nu)) {
+			ret = fio_netio_uring_submit(td, nu);
+			if (ret)
+				return ret;
+			continue;
+		}
+
+		ret = syscall(__NR_io_uring_enter, nu->ring_fd, 0, 1,
+				IORING_ENTER_GETEVENTS, NULL, 0);
+		if (ret < 0) {
+			if (errno == EAGAIN || errno == EINTR)
+				continue;
+			td_verror(td, errno, "io_uring_enter");
+			return -errno;
+		}
+	} while (1);
+
+	return nu->nr_events;
+}
+
+static struct io_u *fio_netio_uring_event(struct thread_data *td, int event)
+{
+	struct netio_data *nd = td->io_ops_data;
+
+	return nd->uring->events[event];
+}
+
+static int fio_netio_uring_open_file(struct thread_data *td,
+				     struct fio_file *f)
+{
+	struct netio_data *nd = td->io_ops_data;
+	struct netio_options *o = td->eo;
+	struct sockaddr *to;
+	socklen_t len;
+	int ret;
+
+	ret = fio_netio_open_file(td, f);
+	if (ret || !is_udp(o) || o->listen)
+		return ret;
+
+	/*
+	 * Plain send has no destination address, connect the datagram
+	 * socket so the kernel knows where to send to.
+	 */
+	if (is_ipv6(o)) {
+		to = (struct sockaddr *) &nd->addr6;
+		len = sizeof(nd->addr6);
+	} else {
+		to = (struct sockaddr *) &nd->addr;
+		len = sizeof(nd->addr);
+	}
+
+	if (connect(f->fd, to, len) < 0) {
+		td_verror(td, errno, "connect");
+		fio_netio_close_file(td, f);
+		f->fd = -1;
+		return 1;
+	}
+
+	return 0;
+}
+
+static void fio_netio_uring_cleanup(struct thread_data *td)
+{
+	struct netio_data *nd = td->io_ops_data;
+	struct netio_uring *nu = nd ? nd->uring : NULL;
+	int i;
+
+	if (nu) {
+		for (i = 0; i < FIO_ARRAY_SIZE(nu->mmap_ptr); i++) {
+			if (nu->mmap_ptr[i])
+				munmap(nu->mmap_ptr[i], nu->mmap_len[i]);
+		}
+		if (nu->ring_fd != -1)
+			close(nu->ring_fd);
+
+		free(nu->br);
+		free(nu->br_bufs);
+		free(nu->events);
+		free(nu->recv_wait);
+		free(nu->chunks);
+		free(nu);
+		nd->uring = NULL;
+	}
+
+	fio_netio_cleanup(td);
+}
+
+static int fio_netio_uring_init(struct thread_data *td)
+{
+	struct netio_data *nd = td->io_ops_data;
+	struct netio_options *o = td->eo;
+	struct io_uring_params p;
+	struct netio_uring *nu;
+	int ret;
+
+	if (o->pingpong) {
+		log_err("fio: net_uring does not support pingpong\n");
+		return 1;
+	}
+
+	ret = fio_netio_init(td);
+	if (ret)
+		return ret;
+
+	nu = calloc(1, sizeof(*nu));
+	nu->ring_fd = -1;
+	nu->depth = roundup_pow2(td->o.iodepth);
+	nu->events = calloc(nu->depth, sizeof(struct io_u *));
+	nu->recv_wait = calloc(nu->depth, sizeof(struct io_u *));
+	nu->chunks = calloc(nu->depth, sizeof(struct netio_uring_chunk));
+	nd->uring = nu;
+
+	/*
+	 * One SQE per io_u plus the multishot receive, and room in the CQ
+	 * ring for zero-copy notifications and unconsumed receives.
+	 */
+	memset(&p, 0, sizeof(p));
+	p.flags = IORING_SETUP_CQSIZE;
+	p.cq_entries = 4 * nu->depth;
+
+	ret = syscall(__NR_io_uring_setup, 2 * nu->depth, &p);
+	if (ret < 0) {
+		if (errno == ENOSYS)
+			log_err("fio: your kernel doesn't support io_uring\n");
+		td_verror(td, errno, "io_uring_setup");
+		return 1;
+	}
+	nu->ring_fd = ret;
+
+	if (fio_netio_uring_mmap(nu, &p)) {
+		td_verror(td, errno, "io_uring mmap");
+		return 1;
+	}
+
+	if (o->recv_multishot && td_read(td) &&
+	    fio_netio_uring_br_setup(td, nu)) {
+		td_verror(td, errno, "io_uring register buffer ring");
+		return 1;
+	}
+
+	return 0;
+}
+
+static struct ioengine_ops ioengine_uring = {
+	.name			= "net_uring",
+	.version		= FIO_IOOPS_VERSION,
+	.prep			= fio_netio_prep,
+	.queue			= fio_netio_uring_queue,
+	.commit			= fio_netio_uring_commit,
+	.getevents		= fio_netio_uring_getevents,
+	.event			= fio_netio_uring_event,
+	.setup			= fio_netio_setup,
+	.init			= fio_netio_uring_init,
+	.cleanup		= fio_netio_uring_cleanup,
+	.open_file		= fio_netio_uring_open_file,
+	.close_file		= fio_netio_close_file,
+	.terminate		= fio_netio_terminate,
+	.options		= options,
+	.option_struct_size	= sizeof(struct netio_options),
+	.flags			= FIO_DISKLESSIO | FIO_UNIDIR | FIO_PIPEIO |
+				  FIO_BIT_BASED | FIO_NO_OFFLOAD,
+};
+#endif
+
 static int str_hostname_cb(void *data, const char *input)
 {
 	struct netio_options *o = data;
@@ -1456,6 +2141,9 @@ static void fio_init fio_netio_register(void)
 #ifdef CONFIG_LINUX_SPLICE
 	register_ioengine(&ioengine_splice);
 #endif
+#ifdef FIO_HAVE_NET_URING
+	register_ioengine(&ioengine_uring);
+#endif
 }
 
 static void fio_exit fio_netio_unregister(void)
@@ -1464,4 +2152,7 @@ static void fio_exit fio_netio_unregister(void)
 #ifdef CONFIG_LINUX_SPLICE
 	unregister_ioengine(&ioengine_splice);
 #endif
+#ifdef FIO_HAVE_NET_URING
+	unregister_ioengine(&ioengine_uring);
+#endif
 }
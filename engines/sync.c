@@ -22,6 +22,8 @@
 
 struct syncio_data {
 	struct iovec *iovecs;
+	unsigned int io_u_iovecs;
+	int *rwf_flags;
 	struct io_u **io_us;
 	unsigned int queued;
 	unsigned int events;
@@ -109,7 +111,14 @@ static int fio_syncio_prep(struct thread_data *td, struct io_u *io_u)
 
 static int fio_io_end(struct thread_data *td, struct io_u *io_u, int ret)
 {
-	if (io_u->file && ret >= 0 && ddir_rw(io_u->ddir))
+	/*
+	 * With io_submit_mode=pool this runs on a pool thread. The engines
+	 * used there don't need the file position, and the job thread
+	 * reports the error when it reaps the io_u.
+	 */
+	bool pool = td->o.io_submit_mode == IO_MODE_POOL;
+
+	if (io_u->file && ret >= 0 && ddir_rw(io_u->ddir) && !pool)
 		LAST_POS(io_u->file) = io_u->offset + ret;
 
 	if (ret != (int) io_u->xfer_buflen) {
@@ -121,7 +130,7 @@ static int fio_io_end(struct thread_data *td, struct io_u *io_u, int ret)
 			io_u->error = errno;
 	}
 
-	if (io_u->error) {
+	if (io_u->error && !pool) {
 		io_u_log_error(td, io_u);
 		td_verror(td, io_u->error, "xfer");
 	}
@@ -129,12 +138,24 @@ static int fio_io_end(struct thread_data *td, struct io_u *io_u, int ret)
 	return FIO_Q_COMPLETED;
 }
 
+#if defined(CONFIG_PWRITEV) || defined(FIO_HAVE_PWRITEV2)
+/*
+ * Each io_u has its own iovecs, so that pool threads don't share them
+ */
+static struct iovec *fio_io_u_iovecs(struct thread_data *td,
+				     struct io_u *io_u)
+{
+	struct syncio_data *sd = td->io_ops_data;
+
+	return &sd->iovecs[io_u->index * sd->io_u_iovecs];
+}
+#endif
+
 #ifdef CONFIG_PWRITEV
 static enum fio_q_status fio_pvsyncio_queue(struct thread_data *td,
 					    struct io_u *io_u)
 {
-	struct syncio_data *sd = td->io_ops_data;
-	struct iovec *iov = &sd->iovecs[0];
+	struct iovec *iov = fio_io_u_iovecs(td, io_u);
 	struct fio_file *f = io_u->file;
 	int ret;
 
@@ -158,16 +179,15 @@ static enum fio_q_status fio_pvsyncio_queue(struct thread_data *td,
 #endif
 
 #ifdef FIO_HAVE_PWRITEV2
-static enum fio_q_status fio_pvsyncio2_queue(struct thread_data *td,
-					     struct io_u *io_u)
+/*
+ * The flags are picked here, on the job thread, rather than in ->queue(),
+ * which pool threads run, so that only one thread uses rand_state.
+ */
+static int fio_pvsyncio2_prep(struct thread_data *td, struct io_u *io_u)
 {
 	struct syncio_data *sd = td->io_ops_data;
 	struct psyncv2_options *o = td->eo;
-	struct iovec *iov = &sd->iovecs[0];
-	struct fio_file *f = io_u->file;
-	int ret, flags = 0;
-
-	fio_ro_check(td, io_u);
+	int flags = 0;
 
 	if (o->hipri &&
 	    (rand_between(&sd->rand_state, 1, 100) <= o->hipri_percentage))
@@ -177,13 +197,31 @@ static enum fio_q_status fio_pvsyncio2_queue(struct thread_data *td,
 	if (o->nowait)
 		flags |= RWF_NOWAIT;
 
-	iov->iov_base = io_u->xfer_buf;
-	iov->iov_len = io_u->xfer_buflen;
+	sd->rwf_flags[io_u->index] = flags;
+	return 0;
+}
+
+static enum fio_q_status fio_pvsyncio2_queue(struct thread_data *td,
+					     struct io_u *io_u)
+{
+	struct syncio_data *sd = td->io_ops_data;
+	struct iovec *iov = fio_io_u_iovecs(td, io_u);
+	struct fio_file *f = io_u->file;
+	int ret, nr = 1, flags = sd->rwf_flags[io_u->index];
+
+	fio_ro_check(td, io_u);
+
+	if (td->o.sg_segments || td->o.sg_segment_size) {
+		nr = io_u_fill_sg(td, io_u, iov);
+	} else {
+		iov->iov_base = io_u->xfer_buf;
+		iov->iov_len = io_u->xfer_buflen;
+	}
 
 	if (io_u->ddir == DDIR_READ)
-		ret = preadv2(f->fd, iov, 1, io_u->offset, flags);
+		ret = preadv2(f->fd, iov, nr, io_u->offset, flags);
 	else if (io_u->ddir == DDIR_WRITE)
-		ret = pwritev2(f->fd, iov, 1, io_u->offset, flags);
+		ret = pwritev2(f->fd, iov, nr, io_u->offset, flags);
 	else if (io_u->ddir == DDIR_TRIM) {
 		do_io_u_trim(td, io_u);
 		return FIO_Q_COMPLETED;
@@ -405,8 +443,12 @@ static int fio_vsyncio_init(struct thread_data *td)
 	sd = malloc(sizeof(*sd));
 	memset(sd, 0, sizeof(*sd));
 	sd->last_offset = -1ULL;
-	sd->iovecs = malloc(td->o.iodepth * sizeof(struct iovec));
+	/* pvsync2 uses them for the segments of one io_u with sg_segments */
+	sd->io_u_iovecs = max(1U, td_max_sg_segments(td));
+	sd->iovecs = malloc(td->o.iodepth * sd->io_u_iovecs *
+				sizeof(struct iovec));
 	sd->io_us = malloc(td->o.iodepth * sizeof(struct io_u *));
+	sd->rwf_flags = calloc(td->o.iodepth, sizeof(int));
 	init_rand(&sd->rand_state, 0);
 
 	td->io_ops_data = sd;
@@ -420,6 +462,7 @@ static void fio_vsyncio_cleanup(struct thread_data *td)
 	if (sd) {
 		free(sd->iovecs);
 		free(sd->io_us);
+		free(sd->rwf_flags);
 		free(sd);
 	}
 }
@@ -442,7 +485,7 @@ static struct ioengine_ops ioengine_prw = {
 	.open_file	= generic_open_file,
 	.close_file	= generic_close_file,
 	.get_file_size	= generic_get_file_size,
-	.flags		= FIO_SYNCIO,
+	.flags		= FIO_SYNCIO | FIO_MT_QUEUE,
 };
 
 static struct ioengine_ops ioengine_vrw = {
@@ -470,7 +513,7 @@ static struct ioengine_ops ioengine_pvrw = {
 	.open_file	= generic_open_file,
 	.close_file	= generic_close_file,
 	.get_file_size	= generic_get_file_size,
-	.flags		= FIO_SYNCIO,
+	.flags		= FIO_SYNCIO | FIO_MT_QUEUE,
 };
 #endif
 
@@ -480,11 +523,12 @@ static struct ioengine_ops ioengine_pvrw2 = {
 	.version	= FIO_IOOPS_VERSION,
 	.init		= fio_vsyncio_init,
 	.cleanup	= fio_vsyncio_cleanup,
+	.prep		= fio_pvsyncio2_prep,
 	.queue		= fio_pvsyncio2_queue,
 	.open_file	= generic_open_file,
 	.close_file	= generic_close_file,
 	.get_file_size	= generic_get_file_size,
-	.flags		= FIO_SYNCIO,
+	.flags		= FIO_SYNCIO | FIO_SG_SEGMENTS | FIO_MT_QUEUE,
 	.options	= options,
 	.option_struct_size	= sizeof(struct psyncv2_options),
 };
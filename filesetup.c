@@ -55,7 +55,51 @@ static int native_fallocate(struct thread_data *td, struct fio_file *f)
 	return true;
 }
 
-static void fallocate_file(struct thread_data *td, struct fio_file *f)
+/*
+ * Shared by the create_threads threads laying out the files of a job. The
+ * first error is kept here and reported from the job thread once they are
+ * all joined, and engine hooks and the buffer fill state of the job are
+ * only touched with lock held.
+ */
+struct layout_data {
+	struct thread_data *td;
+	pthread_mutex_t lock;
+	unsigned int next_file;
+	int err;
+	const char *err_func;
+	bool failed;
+};
+
+static void layout_lock(struct layout_data *ld)
+{
+	if (ld)
+		pthread_mutex_lock(&ld->lock);
+}
+
+static void layout_unlock(struct layout_data *ld)
+{
+	if (ld)
+		pthread_mutex_unlock(&ld->lock);
+}
+
+static void layout_verror(struct thread_data *td, struct layout_data *ld,
+			  int err, const char *func)
+{
+	if (!ld) {
+		td_verror(td, err, func);
+		return;
+	}
+
+	pthread_mutex_lock(&ld->lock);
+	if (!ld->err) {
+		ld->err = err;
+		ld->err_func = func;
+	}
+	pthread_mutex_unlock(&ld->lock);
+}
+
+static void fallocate_file(struct thread_data *td, struct fio_file *f,
+			   struct layout_data *ld)
 {
 	if (td->o.fill_device)
 		return;
@@ -90,7 +134,7 @@ static void fallocate_file(struct thread_data *td, struct fio_file *f)
 
 		r = fallocate(f->fd, FALLOC_FL_KEEP_SIZE, 0, f->real_file_size);
 		if (r != 0)
-			td_verror(td, errno, "fallocate");
+			layout_verror(td, ld, errno, "fallocate");
 
 		break;
 		}
@@ -103,7 +147,7 @@ static void fallocate_file(struct thread_data *td, struct fio_file *f)
 				(unsigned long long) f->real_file_size);
 		r = ftruncate(f->fd, f->real_file_size);
 		if (r != 0)
-			td_verror(td, errno, "ftruncate");
+			layout_verror(td, ld, errno, "ftruncate");
 
 		break;
 	}
@@ -114,11 +158,13 @@ static void fallocate_file(struct thread_data *td, struct fio_file *f)
 }
 
 /*
- * Leaves f->fd open on success, caller must close
+ * Leaves f->fd open on success, caller must close. If ld is given, other
+ * threads are laying out files for the same job, see struct layout_data.
  */
-static int extend_file(struct thread_data *td, struct fio_file *f)
+static int extend_file(struct thread_data *td, struct fio_file *f,
+		       struct layout_data *ld)
 {
-	int new_layout = 0, unlink_file = 0, flags;
+	int new_layout = 0, unlink_file = 0, flags, ret;
 	unsigned long long left;
 	unsigned long long bs;
 	char *b = NULL;
@@ -141,13 +187,16 @@ static int extend_file(struct thread_data *td, struct fio_file *f)
 		unlink_file = 1;
 
 	if (unlink_file || new_layout) {
-		int ret;
+		int err;
 
 		dprint(FD_FILE, "layout unlink %s\n", f->file_name);
 
+		layout_lock(ld);
 		ret = td_io_unlink_file(td, f);
+		err = errno;
+		layout_unlock(ld);
 		if (ret != 0 && ret != ENOENT) {
-			td_verror(td, errno, "unlink");
+			layout_verror(td, ld, err, "unlink");
 			return 1;
 		}
 	}
@@ -171,11 +220,11 @@ static int extend_file(struct thread_data *td, struct fio_file *f)
 			log_err("fio: file creation disallowed by "
 					"allow_file_create=0\n");
 		else
-			td_verror(td, err, "open");
+			layout_verror(td, ld, err, "open");
 		return 1;
 	}
 
-	fallocate_file(td, f);
+	fallocate_file(td, f, ld);
 
 	/*
 	 * If our jobs don't require regular files initially, we're done.
@@ -192,7 +241,7 @@ static int extend_file(struct thread_data *td, struct fio_file *f)
 					(unsigned long long) f->real_file_size);
 		if (ftruncate(f->fd, f->real_file_size) == -1) {
 			if (errno != EFBIG) {
-				td_verror(td, errno, "ftruncate");
+				layout_verror(td, ld, errno, "ftruncate");
 				goto err;
 			}
 		}
@@ -205,7 +254,7 @@ static int extend_file(struct thread_data *td, struct fio_file *f)
 
 	b = malloc(bs);
 	if (!b) {
-		td_verror(td, errno, "malloc");
+		layout_verror(td, ld, errno, "malloc");
 		goto err;
 	}
 
@@ -215,7 +264,9 @@ static int extend_file(struct thread_data *td, struct fio_file *f)
 		if (bs > left)
 			bs = left;
 
+		layout_lock(ld);
 		fill_io_buffer(td, b, bs, bs);
+		layout_unlock(ld);
 
 		r = write(f->fd, b, bs);
 
@@ -237,9 +288,9 @@ static int extend_file(struct thread_data *td, struct fio_file *f)
 					log_info("fio: %s on laying out "
 						 "file, stopping\n", __e_name);
 				}
-				td_verror(td, errno, "write");
+				layout_verror(td, ld, __e, "write");
 			} else
-				td_verror(td, EIO, "write");
+				layout_verror(td, ld, EIO, "write");
 
 			goto err;
 		}
@@ -247,16 +298,21 @@ static int extend_file(struct thread_data *td, struct fio_file *f)
 
 	if (td->terminate) {
 		dprint(FD_FILE, "terminate unlink %s\n", f->file_name);
+		layout_lock(ld);
 		td_io_unlink_file(td, f);
+		layout_unlock(ld);
 	} else if (td->o.create_fsync) {
 		if (fsync(f->fd) < 0) {
-			td_verror(td, errno, "fsync");
+			layout_verror(td, ld, errno, "fsync");
 			goto err;
 		}
 	}
 	if (td->o.fill_device && !td_write(td)) {
 		fio_file_clear_size_known(f);
-		if (td_io_get_file_size(td, f))
+		layout_lock(ld);
+		ret = td_io_get_file_size(td, f);
+		layout_unlock(ld);
+		if (ret)
 			goto err;
 		if (f->io_size > f->real_file_size)
 			f->io_size = f->real_file_size;
@@ -1078,6 +1134,120 @@ static bool create_work_dirs(struct thread_data *td, const char *fname)
 	return true;
 }
 
+static int layout_file(struct thread_data *td, struct fio_file *f,
+		       struct layout_data *ld)
+{
+	unsigned long long old_len = -1ULL, extend_len = -1ULL;
+	int err;
+
+	assert(f->filetype == FIO_TYPE_FILE);
+	fio_file_clear_extend(f);
+	if (!td->o.fill_device) {
+		old_len = f->real_file_size;
+		extend_len = f->io_size + f->file_offset - old_len;
+	}
+	f->real_file_size = (f->io_size + f->file_offset);
+	err = extend_file(td, f, ld);
+	if (err)
+		return err;
+
+	layout_lock(ld);
+	err = __file_invalidate_cache(td, f, old_len, extend_len);
+	layout_unlock(ld);
+
+	/*
+	 * Shut up static checker
+	 */
+	if (f->fd != -1)
+		close(f->fd);
+
+	f->fd = -1;
+	return err;
+}
+
+static void *layout_thread(void *data)
+{
+	struct layout_data *ld = data;
+	struct thread_data *td = ld->td;
+	struct fio_file *f;
+	unsigned int i;
+
+	while (!ld->failed && !td->terminate) {
+		i = __sync_fetch_and_add(&ld->next_file, 1);
+		if (i >= td->files_index)
+			break;
+
+		f = td->files[i];
+		if (!f || !fio_file_extend(f))
+			continue;
+
+		if (layout_file(td, f, ld))
+			ld->failed = true;
+	}
+
+	return NULL;
+}
+
+/*
+ * Lay out the files marked for extending with create_threads threads, each
+ * taking the next file that needs it. With many small files, most of the
+ * time goes to creating, truncating and syncing them rather than to
+ * writing, and that runs in parallel fine.
+ */
+static int layout_files_parallel(struct thread_data *td,
+				 unsigned int need_extend)
+{
+	unsigned int i, nr = min(td->o.create_threads, need_extend);
+	struct layout_data ld = {
+		.td = td,
+	};
+	pthread_t *threads;
+	struct fio_file *f;
+	int ret;
+
+	threads = calloc(nr, sizeof(*threads));
+	if (!threads)
+		nr = 0;
+
+	pthread_mutex_init(&ld.lock, NULL);
+
+	for (i = 0; i < nr; i++) {
+		ret = pthread_create(&threads[i], NULL, layout_thread, &ld);
+		if (ret) {
+			log_err("fio: layout thread creation failed: %s\n",
+					strerror(ret));
+			break;
+		}
+	}
+
+	nr = i;
+	for (i = 0; i < nr; i++)
+		pthread_join(threads[i], NULL);
+
+	pthread_mutex_destroy(&ld.lock);
+	free(threads);
+
+	if (nr) {
+		if (ld.err)
+			td_verror(td, ld.err, ld.err_func);
+		return ld.failed;
+	}
+
+	/*
+	 * No threads, lay out the files here
+	 */
+	for_each_file(td, f, i) {
+		if (!fio_file_extend(f))
+			continue;
+
+		ret = layout_file(td, f, NULL);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
 /*
  * Open the files and setup files sizes, creating files if necessary.
  */
@@ -1320,36 +1490,17 @@ int setup_files(struct thread_data *td)
 				 extend_size >> 20);
 		}
 
-		for_each_file(td, f, i) {
-			unsigned long long old_len = -1ULL, extend_len = -1ULL;
-
-			if (!fio_file_extend(f))
-				continue;
+		if (o->create_threads > 1 && need_extend > 1)
+			err = layout_files_parallel(td, need_extend);
+		else {
+			for_each_file(td, f, i) {
+				if (!fio_file_extend(f))
+					continue;
 
-			assert(f->filetype == FIO_TYPE_FILE);
-			fio_file_clear_extend(f);
-			if (!o->fill_device) {
-				old_len = f->real_file_size;
-				extend_len = f->io_size + f->file_offset -
-						old_len;
+				err = layout_file(td, f, NULL);
+				if (err)
+					break;
 			}
-			f->real_file_size = (f->io_size + f->file_offset);
-			err = extend_file(td, f);
-			if (err)
-				break;
-
-			err = __file_invalidate_cache(td, f, old_len,
-								extend_len);
-
-			/*
-			 * Shut up static checker
-			 */
-			if (f->fd != -1)
-				close(f->fd);
-
-			f->fd = -1;
-			if (err)
-				break;
 		}
 		temp_stall_ts = 0;
 	}
@@ -1464,7 +1615,7 @@ static void __init_rand_distribution(struct thread_data *td, struct fio_file *f)
 		gauss_init(&f->gauss, nranges, td->o.gauss_dev.u.f, td->o.random_center.u.f, seed);
 }
 
-static bool init_rand_distribution(struct thread_data *td)
+bool init_rand_distribution(struct thread_data *td)
 {
 	struct fio_file *f;
 	unsigned int i;
@@ -1880,11 +2031,19 @@ int add_file_exclusive(struct thread_data *td, const char *fname)
 	return add_file(td, fname, 0, 1);
 }
 
-void get_file(struct fio_file *f)
+void get_file(struct thread_data *td, struct fio_file *f)
 {
 	dprint(FD_FILE, "get file %s, ref=%d\n", f->file_name, f->references);
 	assert(fio_file_open(f));
-	f->references++;
+
+	/*
+	 * Offload workers and async verify threads put files without
+	 * holding io_u_lock
+	 */
+	if (td_async_processing(td))
+		__sync_fetch_and_add(&f->references, 1);
+	else
+		f->references++;
 }
 
 int put_file(struct thread_data *td, struct fio_file *f)
@@ -1899,7 +2058,10 @@ int put_file(struct thread_data *td, struct fio_file *f)
 	}
 
 	assert(f->references);
-	if (--f->references)
+	if (td_async_processing(td)) {
+		if (__sync_sub_and_fetch(&f->references, 1))
+			return 0;
+	} else if (--f->references)
 		return 0;
 
 	disk_util_dec(f->du);
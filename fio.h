@@ -63,6 +63,11 @@
 #ifndef MPOL_LOCAL
 #define MPOL_LOCAL 4
 #endif
+
+/*
+ * "device" is a fio pseudo-policy, preferring the node of the job's device
+ */
+#define MPOL_DEVICE (MPOL_LOCAL + 1)
 #endif
 
 #ifdef CONFIG_CUDA
@@ -70,6 +75,7 @@
 #endif
 
 struct fio_sem;
+struct sync_pool;
 
 /*
  * offset generator types
@@ -150,9 +156,11 @@ enum {
 enum {
 	IO_MODE_INLINE = 0,
 	IO_MODE_OFFLOAD = 1,
+	IO_MODE_POOL = 2,
 
 	RATE_PROCESS_LINEAR = 0,
 	RATE_PROCESS_POISSON = 1,
+	RATE_PROCESS_BURSTY = 2,
 
 	THINKTIME_BLOCKS_TYPE_COMPLETE = 0,
 	THINKTIME_BLOCKS_TYPE_ISSUE = 1,
@@ -198,6 +206,7 @@ struct thread_data {
 	struct io_log *slat_log;
 	struct io_log *clat_log;
 	struct io_log *clat_hist_log;
+	struct io_log *clat_pctile_log;
 	struct io_log *lat_log;
 	struct io_log *bw_log;
 	struct io_log *iops_log;
@@ -214,6 +223,11 @@ struct thread_data {
 
 	volatile int update_rusage;
 	struct fio_sem *rusage_sem;
+	/*
+	 * Stats of the offload workers, summed along with the rusage update
+	 * so that running reports from the main process can include them.
+	 */
+	struct thread_stat *offload_ts;
 	struct rusage ru_start;
 	struct rusage ru_end;
 
@@ -323,6 +337,14 @@ struct thread_data {
 	pthread_mutex_t io_u_lock;
 	pthread_cond_t free_cond;
 
+	/*
+	 * io_u's freed by offload workers or async verify threads, moved
+	 * to the freelist by __get_io_u() without holding io_u_lock.
+	 * free_waiting is set while it sleeps on free_cond.
+	 */
+	struct io_u_stack io_u_returns;
+	int free_waiting;
+
 	/*
 	 * async verify offload
 	 */
@@ -349,6 +371,11 @@ struct thread_data {
 	 */
 	struct workqueue io_wq;
 
+	/*
+	 * Threads issuing the calls of a sync engine, io_submit_mode=pool
+	 */
+	struct sync_pool *sync_pool;
+
 	uint64_t total_io_size;
 	uint64_t fill_device_size;
 
@@ -405,6 +432,29 @@ struct thread_data {
 	uint64_t latency_ios;
 	int latency_end_run;
 
+	/*
+	 * Stats of the current period, an iodepth_sweep step or a phase.
+	 * The period_* totals are a snapshot of the completion stats taken
+	 * when it started.
+	 */
+	struct timespec period_ts;
+	bool period_running;
+	uint64_t period_ios;
+	uint64_t period_bytes;
+	double period_clat_sum;
+	uint64_t *period_plat;
+
+	unsigned int sweep_step;
+
+	/*
+	 * phases state. phase_bs overrides the job block size while a
+	 * phase that sets bs is running.
+	 */
+	struct fio_phase *phases;
+	unsigned int nr_phases;
+	unsigned int cur_phase;
+	unsigned long long phase_bs[DDIR_RWDIR_CNT];
+
 	/*
 	 * read/write mixed workload state
 	 */
@@ -685,7 +735,7 @@ enum {
 };
 
 #define TD_ENG_FLAG_SHIFT	18
-#define TD_ENG_FLAG_MASK	((1ULL << 18) - 1)
+#define TD_ENG_FLAG_MASK	((1ULL << 20) - 1)
 
 static inline void td_set_ioengine_flags(struct thread_data *td)
 {
@@ -749,6 +799,9 @@ extern int io_queue_event(struct thread_data *td, struct io_u *io_u, int *ret,
 extern void lat_target_check(struct thread_data *);
 extern void lat_target_init(struct thread_data *);
 extern void lat_target_reset(struct thread_data *);
+extern void iodepth_sweep_init(struct thread_data *);
+extern void iodepth_sweep_check(struct thread_data *);
+extern void iodepth_sweep_end(struct thread_data *);
 
 /*
  * Iterates all threads/processes within all the defined jobs
@@ -815,6 +868,27 @@ static inline bool td_offload_overlap(struct thread_data *td)
 	return td->o.serialize_overlap && td->o.io_submit_mode == IO_MODE_OFFLOAD;
 }
 
+/*
+ * CPU cycle counting for the stages of the IO path, see stage_cycles
+ */
+static inline uint64_t stage_start(struct thread_data *td)
+{
+#ifdef ARCH_HAVE_CPU_CLOCK
+	if (td->o.stage_cycles)
+		return get_cpu_clock();
+#endif
+	return 0;
+}
+
+static inline void stage_end(struct thread_data *td, enum fio_stage stage,
+			     uint64_t start)
+{
+#ifdef ARCH_HAVE_CPU_CLOCK
+	if (td->o.stage_cycles)
+		td->ts.stage_cycles[stage] += get_cpu_clock() - start;
+#endif
+}
+
 /*
  * We currently only need to do locking if we have verifier threads
  * accessing our internal structures too
@@ -835,6 +909,41 @@ static inline void td_io_u_free_notify(struct thread_data *td)
 		pthread_cond_signal(&td->free_cond);
 }
 
+/*
+ * Wake __get_io_u() after an io_u was pushed on io_u_returns, but only if
+ * it's actually waiting. The full barrier from the push orders it against
+ * the check of free_waiting.
+ */
+static inline void td_io_u_return_notify(struct thread_data *td)
+{
+	if (!__atomic_load_n(&td->free_waiting, __ATOMIC_RELAXED))
+		return;
+
+	__td_io_u_lock(td);
+	pthread_cond_signal(&td->free_cond);
+	__td_io_u_unlock(td);
+}
+
+/*
+ * With async processing, io_u's complete on other threads and are put
+ * without holding io_u_lock
+ */
+static inline void td_cur_depth_inc(struct thread_data *td)
+{
+	if (!td_async_processing(td))
+		td->cur_depth++;
+	else
+		__sync_fetch_and_add(&td->cur_depth, 1);
+}
+
+static inline void td_cur_depth_dec(struct thread_data *td)
+{
+	if (!td_async_processing(td))
+		td->cur_depth--;
+	else
+		__sync_fetch_and_sub(&td->cur_depth, 1);
+}
+
 static inline void td_flags_clear(struct thread_data *td, unsigned int *flags,
 				  unsigned int value)
 {
@@ -30,6 +30,7 @@ extern bool ramp_time_over(struct thread_data *);
 extern bool in_ramp_time(struct thread_data *);
 extern void fio_time_init(void);
 extern void timespec_add_msec(struct timespec *, unsigned int);
+extern void timespec_add_usec(struct timespec *, uint64_t);
 extern void set_epoch_time(struct thread_data *, int, clockid_t);
 
 #endif
@@ -429,6 +429,20 @@ void fio_clock_init(void)
 	dprint(FD_TIME, "gettime: clocksource=%d\n", (int) fio_clock_source);
 }
 
+/*
+ * Rate of get_cpu_clock(), 0 if there is no CPU clock.
+ */
+unsigned long long fio_cycles_per_msec(void)
+{
+#if defined(ARCH_HAVE_CPU_CLOCK) && defined(ARCH_CPU_CLOCK_CYCLES_PER_USEC)
+	return ARCH_CPU_CLOCK_CYCLES_PER_USEC * 1000ULL;
+#elif defined(ARCH_HAVE_CPU_CLOCK)
+	return cycles_per_msec;
+#else
+	return 0;
+#endif
+}
+
 uint64_t ntime_since(const struct timespec *s, const struct timespec *e)
 {
 	int64_t sec, nsec;
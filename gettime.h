@@ -23,6 +23,7 @@ extern void fio_clock_init(void);
 extern int fio_start_gtod_thread(void);
 extern int fio_monotonic_clocktest(int debug);
 extern void fio_local_clock_init(void);
+extern unsigned long long fio_cycles_per_msec(void);
 
 extern struct fio_ts {
 	struct seqlock seqlock;
@@ -0,0 +1,445 @@
+/*
+ * Per offset region latency histograms, see heatmap.h
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "fio.h"
+#include "heatmap.h"
+#include "json.h"
+#include "smalloc.h"
+
+static inline uint64_t *heatmap_counts(struct lat_heatmap_file *hf,
+				       uint64_t region, enum fio_ddir ddir)
+{
+	return &hf->counts[(region * DDIR_RWDIR_CNT + ddir) * LAT_HEATMAP_BINS];
+}
+
+static inline size_t heatmap_counts_size(struct lat_heatmap *hm)
+{
+	return (size_t) hm->nr_regions * DDIR_RWDIR_CNT * LAT_HEATMAP_BINS *
+		sizeof(uint64_t);
+}
+
+static uint64_t heatmap_bin_ns(unsigned int bin)
+{
+	if (!bin)
+		return 0;
+
+	return 1ULL << (bin + FIO_IO_U_PLAT_BITS - 1);
+}
+
+/*
+ * Only the heatmap of a job needs to be in shared memory, copies that are
+ * private to one process use the heap.
+ */
+static void *heatmap_calloc(bool shared, size_t nmemb, size_t size)
+{
+	if (shared)
+		return scalloc(nmemb, size);
+
+	return calloc(nmemb, size);
+}
+
+static void heatmap_free(bool shared, void *ptr)
+{
+	if (shared)
+		sfree(ptr);
+	else
+		free(ptr);
+}
+
+static struct lat_heatmap *heatmap_alloc(unsigned int nr_regions,
+					 unsigned int nr_files, bool shared)
+{
+	struct lat_heatmap *hm;
+
+	hm = heatmap_calloc(shared, 1, sizeof(*hm));
+	if (!hm)
+		return NULL;
+
+	hm->nr_regions = nr_regions;
+	hm->shared = shared;
+	if (nr_files) {
+		hm->files = heatmap_calloc(shared, nr_files, sizeof(*hm->files));
+		if (!hm->files) {
+			heatmap_free(shared, hm);
+			return NULL;
+		}
+	}
+	hm->nr_files = nr_files;
+	return hm;
+}
+
+static int heatmap_file_init(struct lat_heatmap *hm,
+			     struct lat_heatmap_file *hf, const char *name,
+			     uint64_t start, uint64_t region_size)
+{
+	if (hm->shared)
+		hf->name = smalloc_strdup(name);
+	else
+		hf->name = strdup(name);
+	hf->start = start;
+	hf->region_size = region_size;
+	hf->counts = heatmap_calloc(hm->shared, 1, heatmap_counts_size(hm));
+
+	return !hf->name || !hf->counts;
+}
+
+void lat_heatmap_free(struct lat_heatmap *hm)
+{
+	unsigned int i;
+
+	if (!hm)
+		return;
+
+	for (i = 0; i < hm->nr_files; i++) {
+		heatmap_free(hm->shared, hm->files[i].name);
+		heatmap_free(hm->shared, hm->files[i].counts);
+	}
+	heatmap_free(hm->shared, hm->files);
+	heatmap_free(hm->shared, hm);
+}
+
+/*
+ * Split the range each file of 'td' is doing IO to in lat_heatmap regions.
+ * Allocated from shared memory, so the heatmap can be reported from the
+ * main process once the job is done.
+ */
+int lat_heatmap_init(struct thread_data *td)
+{
+	struct lat_heatmap *hm;
+	struct fio_file *f;
+	unsigned int i;
+
+	hm = heatmap_alloc(td->o.lat_heatmap, td->files_index, true);
+	if (!hm)
+		goto err;
+
+	for_each_file(td, f, i) {
+		uint64_t span = f->io_size ? f->io_size : f->real_file_size;
+		uint64_t region_size;
+
+		region_size = (span + hm->nr_regions - 1) / hm->nr_regions;
+		if (!region_size)
+			region_size = 1;
+
+		if (heatmap_file_init(hm, &hm->files[i], f->file_name,
+				      f->file_offset, region_size))
+			goto err;
+	}
+
+	td->ts.heatmap = hm;
+	return 0;
+err:
+	lat_heatmap_free(hm);
+	log_err("fio: failed to allocate lat_heatmap\n");
+	td_verror(td, ENOMEM, "lat_heatmap_init");
+	return 1;
+}
+
+/*
+ * A copy of 'src' with the same files and regions, and no samples, private
+ * to the calling process.
+ */
+struct lat_heatmap *lat_heatmap_clone(struct lat_heatmap *src)
+{
+	struct lat_heatmap *hm;
+	unsigned int i;
+
+	hm = heatmap_alloc(src->nr_regions, src->nr_files, false);
+	if (!hm)
+		return NULL;
+
+	for (i = 0; i < src->nr_files; i++) {
+		struct lat_heatmap_file *sf = &src->files[i];
+
+		if (heatmap_file_init(hm, &hm->files[i], sf->name, sf->start,
+				      sf->region_size)) {
+			lat_heatmap_free(hm);
+			return NULL;
+		}
+	}
+
+	return hm;
+}
+
+void lat_heatmap_add(struct lat_heatmap *hm, struct fio_file *f,
+		     uint64_t offset, enum fio_ddir ddir,
+		     unsigned long long nsec)
+{
+	struct lat_heatmap_file *hf;
+	uint64_t region = 0;
+	unsigned int bin = 0;
+
+	if (!f || f->fileno >= hm->nr_files)
+		return;
+
+	hf = &hm->files[f->fileno];
+	if (offset > hf->start) {
+		region = (offset - hf->start) / hf->region_size;
+		if (region >= hm->nr_regions)
+			region = hm->nr_regions - 1;
+	}
+
+	if (nsec >= FIO_IO_U_PLAT_VAL) {
+		bin = 63 - __builtin_clzll(nsec) - FIO_IO_U_PLAT_BITS + 1;
+		if (bin >= LAT_HEATMAP_BINS)
+			bin = LAT_HEATMAP_BINS - 1;
+	}
+
+	heatmap_counts(hf, region, ddir)[bin]++;
+}
+
+static struct lat_heatmap_file *heatmap_find_file(struct lat_heatmap *hm,
+						  struct lat_heatmap_file *sf)
+{
+	struct lat_heatmap_file *files;
+	unsigned int i;
+
+	for (i = 0; i < hm->nr_files; i++) {
+		struct lat_heatmap_file *hf = &hm->files[i];
+
+		if (hf->start == sf->start &&
+		    hf->region_size == sf->region_size &&
+		    !strcmp(hf->name, sf->name))
+			return hf;
+	}
+
+	files = heatmap_calloc(hm->shared, hm->nr_files + 1, sizeof(*files));
+	if (!files)
+		return NULL;
+
+	if (hm->nr_files)
+		memcpy(files, hm->files, hm->nr_files * sizeof(*files));
+
+	if (heatmap_file_init(hm, &files[hm->nr_files], sf->name, sf->start,
+			      sf->region_size)) {
+		heatmap_free(hm->shared, files[hm->nr_files].name);
+		heatmap_free(hm->shared, files[hm->nr_files].counts);
+		heatmap_free(hm->shared, files);
+		return NULL;
+	}
+
+	heatmap_free(hm->shared, hm->files);
+	hm->files = files;
+	return &hm->files[hm->nr_files++];
+}
+
+/*
+ * Add the samples of 'src' to '*dst', allocating the latter privately if
+ * needed.
+ * Files that 'dst' doesn't have yet are appended, so jobs of a reporting
+ * group that each work on their own files show all of them.
+ */
+void lat_heatmap_sum(struct lat_heatmap **dst, struct lat_heatmap *src)
+{
+	struct lat_heatmap *hm = *dst;
+	unsigned int i;
+	size_t j, nr;
+
+	if (!src)
+		return;
+
+	if (!hm) {
+		hm = heatmap_alloc(src->nr_regions, 0, false);
+		if (!hm)
+			return;
+		*dst = hm;
+	}
+
+	/* regions of different sizes can't be lined up */
+	if (hm->nr_regions != src->nr_regions)
+		return;
+
+	nr = heatmap_counts_size(hm) / sizeof(uint64_t);
+
+	for (i = 0; i < src->nr_files; i++) {
+		struct lat_heatmap_file *sf = &src->files[i];
+		struct lat_heatmap_file *hf;
+
+		hf = heatmap_find_file(hm, sf);
+		if (!hf)
+			continue;
+
+		for (j = 0; j < nr; j++)
+			hf->counts[j] += sf->counts[j];
+	}
+}
+
+void lat_heatmap_reset(struct lat_heatmap *hm)
+{
+	unsigned int i;
+
+	if (!hm)
+		return;
+
+	for (i = 0; i < hm->nr_files; i++)
+		memset(hm->files[i].counts, 0, heatmap_counts_size(hm));
+}
+
+static bool heatmap_ddir_empty(struct lat_heatmap *hm,
+			       struct lat_heatmap_file *hf, enum fio_ddir ddir)
+{
+	uint64_t region, *counts;
+	unsigned int i;
+
+	for (region = 0; region < hm->nr_regions; region++) {
+		counts = heatmap_counts(hf, region, ddir);
+		for (i = 0; i < LAT_HEATMAP_BINS; i++)
+			if (counts[i])
+				return false;
+	}
+
+	return true;
+}
+
+struct json_object *lat_heatmap_json(struct lat_heatmap *hm)
+{
+	struct json_object *root, *obj;
+	struct json_array *bins, *files, *regions, *array;
+	uint64_t region, *counts;
+	unsigned int i, j;
+
+	root = json_create_object();
+	json_object_add_value_int(root, "regions", hm->nr_regions);
+
+	bins = json_create_array();
+	json_object_add_value_array(root, "bins_ns", bins);
+	for (i = 0; i < LAT_HEATMAP_BINS; i++)
+		json_array_add_value_int(bins, heatmap_bin_ns(i));
+
+	files = json_create_array();
+	json_object_add_value_array(root, "files", files);
+	for (i = 0; i < hm->nr_files; i++) {
+		struct lat_heatmap_file *hf = &hm->files[i];
+
+		obj = json_create_object();
+		json_array_add_value_object(files, obj);
+		json_object_add_value_string(obj, "name", hf->name);
+		json_object_add_value_int(obj, "start", hf->start);
+		json_object_add_value_int(obj, "region_size", hf->region_size);
+
+		for_each_rw_ddir(ddir) {
+			if (heatmap_ddir_empty(hm, hf, ddir))
+				continue;
+
+			regions = json_create_array();
+			json_object_add_value_array(obj, io_ddir_name(ddir),
+						    regions);
+			for (region = 0; region < hm->nr_regions; region++) {
+				counts = heatmap_counts(hf, region, ddir);
+				array = json_create_array();
+				json_array_add_value_array(regions, array);
+				for (j = 0; j < LAT_HEATMAP_BINS; j++)
+					json_array_add_value_int(array,
+								 counts[j]);
+			}
+		}
+	}
+
+	return root;
+}
+
+static int heatmap_fwrite(FILE *f, const void *buf, size_t len)
+{
+	if (len && fwrite(buf, len, 1, f) != 1)
+		return errno ? errno : EIO;
+
+	return 0;
+}
+
+static int heatmap_write_file(FILE *f, struct lat_heatmap *hm,
+			      struct lat_heatmap_file *hf, uint64_t *buf)
+{
+	static const uint8_t zero[8];
+	struct heatmap_file_header fh;
+	size_t i, len = strlen(hf->name);
+	size_t nr = heatmap_counts_size(hm) / sizeof(uint64_t);
+	int ret;
+
+	fh.start = cpu_to_le64(hf->start);
+	fh.region_size = cpu_to_le64(hf->region_size);
+	fh.name_len = __cpu_to_le32(len);
+	fh.pad = 0;
+
+	ret = heatmap_fwrite(f, &fh, sizeof(fh));
+	if (!ret)
+		ret = heatmap_fwrite(f, hf->name, len);
+	if (!ret)
+		ret = heatmap_fwrite(f, zero, (8 - (len & 7)) & 7);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < nr; i++)
+		buf[i] = cpu_to_le64(hf->counts[i]);
+
+	return heatmap_fwrite(f, buf, nr * sizeof(uint64_t));
+}
+
+/*
+ * Write the heatmap of 'td' to <lat_heatmap_file>_heatmap.<num>.bin, named
+ * after the job unless lat_heatmap_file is set. Without per_job_logs, all
+ * jobs append their record to the same file.
+ */
+int lat_heatmap_write(struct thread_data *td)
+{
+	struct lat_heatmap *hm = td->ts.heatmap;
+	const char *prefix = td->o.lat_heatmap_file;
+	struct heatmap_header *hdr;
+	char name[PATH_MAX];
+	uint64_t *buf;
+	unsigned int i;
+	FILE *f;
+	int ret;
+
+	if (!hm)
+		return 0;
+
+	if (!prefix)
+		prefix = td->o.name;
+
+	if (td->o.per_job_logs)
+		snprintf(name, sizeof(name), "%s_heatmap.%d.bin", prefix,
+			 td->thread_number);
+	else
+		snprintf(name, sizeof(name), "%s_heatmap.bin", prefix);
+
+	f = fopen(name, td->o.per_job_logs ? "w" : "a");
+	if (!f) {
+		log_err("fio: failed to open heatmap file %s: %s\n", name,
+			strerror(errno));
+		return 1;
+	}
+
+	hdr = calloc(1, sizeof(*hdr) + LAT_HEATMAP_BINS * sizeof(uint64_t));
+	memcpy(hdr->magic, HEATMAP_MAGIC, sizeof(hdr->magic));
+	hdr->version = __cpu_to_le32(HEATMAP_VERSION);
+	hdr->nr_files = cpu_to_le32(hm->nr_files);
+	hdr->nr_regions = cpu_to_le32(hm->nr_regions);
+	hdr->nr_ddirs = __cpu_to_le32(DDIR_RWDIR_CNT);
+	hdr->nr_bins = __cpu_to_le32(LAT_HEATMAP_BINS);
+	for (i = 0; i < LAT_HEATMAP_BINS; i++)
+		hdr->bin_ns[i] = cpu_to_le64(heatmap_bin_ns(i));
+
+	ret = heatmap_fwrite(f, hdr,
+			     sizeof(*hdr) + LAT_HEATMAP_BINS * sizeof(uint64_t));
+	free(hdr);
+
+	buf = malloc(heatmap_counts_size(hm));
+	for (i = 0; !ret && i < hm->nr_files; i++)
+		ret = heatmap_write_file(f, hm, &hm->files[i], buf);
+	free(buf);
+
+	if (fclose(f) && !ret)
+		ret = errno;
+	if (ret) {
+		log_err("fio: failed to write heatmap file %s: %s\n", name,
+			strerror(ret));
+		return 1;
+	}
+
+	return 0;
+}
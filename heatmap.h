@@ -0,0 +1,84 @@
+#ifndef FIO_HEATMAP_H
+#define FIO_HEATMAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "io_ddir.h"
+#include "stat.h"
+
+/*
+ * Completion latencies per offset region of each file of a job, see the
+ * lat_heatmap option. Latencies are binned coarsely, using one bin for
+ * each group of the io_u_plat histogram: bin 0 holds everything below
+ * FIO_IO_U_PLAT_VAL nsec, and bin n the latencies from
+ * 2^(n + FIO_IO_U_PLAT_BITS - 1) nsec up to twice that. The last bin is
+ * open ended.
+ */
+#define LAT_HEATMAP_BINS	FIO_IO_U_PLAT_GROUP_NR
+
+/*
+ * Each region takes DDIR_RWDIR_CNT * LAT_HEATMAP_BINS counters per file, a
+ * little under 700 bytes, from the shared memory pool.
+ */
+#define LAT_HEATMAP_MAX_REGIONS	4096
+
+struct lat_heatmap_file {
+	char *name;
+	uint64_t start;		/* offset of the first region */
+	uint64_t region_size;
+	uint64_t *counts;	/* [nr_regions][DDIR_RWDIR_CNT][bins] */
+};
+
+struct lat_heatmap {
+	uint32_t nr_regions;
+	uint32_t nr_files;
+	struct lat_heatmap_file *files;
+	bool shared;		/* allocated with smalloc */
+};
+
+/*
+ * Binary lat_heatmap file, all fields little endian. It holds one record
+ * per job that wrote to it, each a struct heatmap_header with the lower
+ * bound in nsec of each of its nr_bins bins, followed by nr_files of:
+ *
+ *	struct heatmap_file_header
+ *	the file name, zero padded to a multiple of 8 bytes
+ *	counts[nr_regions][nr_ddirs][nr_bins], as uint64_t
+ */
+#define HEATMAP_MAGIC		"fiohtmap"
+#define HEATMAP_VERSION		1
+
+struct heatmap_header {
+	uint8_t magic[8];
+	uint32_t version;
+	uint32_t nr_files;
+	uint32_t nr_regions;
+	uint32_t nr_ddirs;
+	uint32_t nr_bins;
+	uint32_t pad;
+	uint64_t bin_ns[];
+};
+
+struct heatmap_file_header {
+	uint64_t start;
+	uint64_t region_size;
+	uint32_t name_len;
+	uint32_t pad;
+};
+
+struct thread_data;
+struct fio_file;
+struct json_object;
+
+extern int lat_heatmap_init(struct thread_data *);
+extern struct lat_heatmap *lat_heatmap_clone(struct lat_heatmap *);
+extern void lat_heatmap_add(struct lat_heatmap *, struct fio_file *,
+			    uint64_t, enum fio_ddir, unsigned long long);
+extern void lat_heatmap_sum(struct lat_heatmap **, struct lat_heatmap *);
+extern void lat_heatmap_reset(struct lat_heatmap *);
+extern void lat_heatmap_free(struct lat_heatmap *);
+extern struct json_object *lat_heatmap_json(struct lat_heatmap *);
+extern int lat_heatmap_write(struct thread_data *);
+
+#endif
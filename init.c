@@ -30,6 +30,7 @@
 #include "idletime.h"
 #include "filelock.h"
 #include "steadystate.h"
+#include "phase.h"
 #include "blktrace.h"
 
 #include "oslib/asprintf.h"
@@ -610,6 +611,7 @@ static unsigned int gcd(unsigned int m, unsigned int n)
 static int fixup_options(struct thread_data *td)
 {
 	struct thread_options *o = &td->o;
+	unsigned int i;
 	int ret = 0;
 
 	if (read_only && (td_write(td) || td_trim(td))) {
@@ -781,6 +783,23 @@ static int fixup_options(struct thread_data *td)
 		}
 	}
 
+	if (o->rate_process == RATE_PROCESS_BURSTY && !o->rate_burst_on) {
+		log_err("fio: rate_process=bursty requires rate_burst_on\n");
+		ret |= 1;
+	}
+	if (o->rate_open_loop) {
+		if (!(o->rate[DDIR_READ] + o->rate[DDIR_WRITE] +
+		      o->rate[DDIR_TRIM] + o->rate_iops[DDIR_READ] +
+		      o->rate_iops[DDIR_WRITE] + o->rate_iops[DDIR_TRIM])) {
+			log_err("fio: rate_open_loop requires rate or rate_iops\n");
+			ret |= 1;
+		}
+		if (o->gtod_reduce) {
+			log_err("fio: rate_open_loop is incompatible with gtod_reduce\n");
+			ret |= 1;
+		}
+	}
+
 	if (!o->timeout && o->time_based) {
 		log_err("fio: time_based requires a runtime/timeout setting\n");
 		o->time_based = 0;
@@ -933,6 +952,29 @@ static int fixup_options(struct thread_data *td)
 		ret |= 1;
 	}
 
+	if (o->sg_segments || o->sg_segment_size) {
+		if (!td_ioengine_flagged(td, FIO_SG_SEGMENTS)) {
+			log_err("fio: IO engine %s doesn't support sg_segments "
+				"or sg_segment_size\n", td->io_ops->name);
+			ret |= 1;
+		} else if (o->sg_segments && o->sg_segment_size) {
+			log_err("fio: sg_segments and sg_segment_size are "
+				"mutually exclusive\n");
+			ret |= 1;
+		} else if (td_max_sg_segments(td) > FIO_IO_U_SG_MAX) {
+			log_err("fio: sg_segment_size gives more than %u "
+				"segments\n", FIO_IO_U_SG_MAX);
+			ret |= 1;
+		}
+	}
+
+	if (o->io_submit_mode == IO_MODE_POOL &&
+	    !td_ioengine_flagged(td, FIO_MT_QUEUE)) {
+		log_err("fio: IO engine %s doesn't support "
+			"io_submit_mode=pool\n", td->io_ops->name);
+		ret |= 1;
+	}
+
 	if (fio_option_is_set(o, gtod_cpu)) {
 		fio_gtod_init();
 		fio_gtod_set_cpu(o->gtod_cpu);
@@ -950,6 +992,12 @@ static int fixup_options(struct thread_data *td)
 		ret |= 1;
 	}
 
+	if (o->log_binary && o->log_gz_store) {
+		log_err("fio: log_binary and log_store_compressed are "
+			"mutually exclusive\n");
+		ret |= 1;
+	}
+
 	if (o->disable_lat)
 		o->lat_percentiles = 0;
 	if (o->disable_clat)
@@ -957,6 +1005,57 @@ static int fixup_options(struct thread_data *td)
 	if (o->disable_slat)
 		o->slat_percentiles = 0;
 
+	if (o->iodepth_sweep_nr) {
+		if (o->latency_target) {
+			log_err("fio: iodepth_sweep and latency_target are "
+				"mutually exclusive\n");
+			ret |= 1;
+		}
+		if (!o->clat_percentiles) {
+			log_err("fio: iodepth_sweep requires clat percentiles\n");
+			ret |= 1;
+		}
+		for (i = 0; i < o->iodepth_sweep_nr; i++) {
+			if (o->iodepth_sweep[i] > o->iodepth) {
+				log_err("fio: iodepth_sweep depth %u exceeds "
+					"iodepth %u\n", o->iodepth_sweep[i],
+					o->iodepth);
+				ret |= 1;
+				break;
+			}
+		}
+	}
+
+	if (o->phases) {
+		if (o->latency_target || o->iodepth_sweep_nr) {
+			log_err("fio: phases can't be combined with "
+				"latency_target or iodepth_sweep\n");
+			ret |= 1;
+		}
+		if (!o->clat_percentiles) {
+			log_err("fio: phases requires clat percentiles\n");
+			ret |= 1;
+		}
+	}
+
+	if (o->log_pctile_msec && !o->clat_percentiles) {
+		log_err("fio: log_percentiles_msec requires clat percentiles\n");
+		ret |= 1;
+	}
+	if (o->log_pctile_msec && o->log_gz_store) {
+		log_err("fio: log_percentiles_msec and log_store_compressed are "
+			"mutually exclusive\n");
+		ret |= 1;
+	}
+
+#ifndef ARCH_HAVE_CPU_CLOCK
+	if (o->stage_cycles) {
+		log_err("fio: stage_cycles needs a CPU clock, which this "
+			"platform doesn't have\n");
+		ret |= 1;
+	}
+#endif
+
 	/*
 	 * Fix these up to be nsec internally
 	 */
@@ -1541,6 +1640,14 @@ static int add_job(struct thread_data *td, const char *jobname, int job_add_num,
 	if (fixup_options(td))
 		goto err;
 
+	/*
+	 * Only check the phases here, each thread sets up its own copy
+	 * when it starts.
+	 */
+	if (phases_setup(td))
+		goto err;
+	phases_free(td);
+
 	if (!td->o.dedupe_global && init_dedupe_working_set_seeds(td, 0))
 		goto err;
 
@@ -1615,12 +1722,15 @@ static int add_job(struct thread_data *td, const char *jobname, int job_add_num,
 			.log_prio = o->log_prio,
 			.log_gz = o->log_gz,
 			.log_gz_store = o->log_gz_store,
+			.log_binary = o->log_binary,
 		};
 		const char *pre = make_log_name(o->lat_log_file, o->name);
 		const char *suf;
 
 		if (p.log_gz_store)
 			suf = "log.fz";
+		else if (p.log_binary)
+			suf = "log.bin";
 		else
 			suf = "log";
 
@@ -1650,6 +1760,7 @@ static int add_job(struct thread_data *td, const char *jobname, int job_add_num,
 			.avg_msec = o->log_avg_msec,
 			.hist_msec = o->log_hist_msec,
 			.hist_coarseness = o->log_hist_coarseness,
+			.hist_sparse = o->log_hist_sparse,
 			.log_type = IO_LOG_TYPE_HIST,
 			.log_offset = o->log_offset,
 			.log_prio = o->log_prio,
@@ -1676,6 +1787,27 @@ static int add_job(struct thread_data *td, const char *jobname, int job_add_num,
 		setup_log(&td->clat_hist_log, &p, logname);
 	}
 
+	if (o->log_pctile_msec) {
+		struct log_params p = {
+			.td = td,
+			.hist_msec = o->log_pctile_msec,
+			.log_type = IO_LOG_TYPE_PCTILE,
+			.log_gz = o->log_gz,
+			.log_gz_store = o->log_gz_store,
+		};
+		const char *pre = make_log_name(o->lat_log_file, o->name);
+		const char *suf;
+
+		if (p.log_gz_store)
+			suf = "log.fz";
+		else
+			suf = "log";
+
+		gen_log_name(logname, sizeof(logname), "clat_pctile", pre,
+				td->thread_number, suf, o->per_job_logs);
+		setup_log(&td->clat_pctile_log, &p, logname);
+	}
+
 	if (o->write_bw_log) {
 		struct log_params p = {
 			.td = td,
@@ -1687,6 +1819,7 @@ static int add_job(struct thread_data *td, const char *jobname, int job_add_num,
 			.log_prio = o->log_prio,
 			.log_gz = o->log_gz,
 			.log_gz_store = o->log_gz_store,
+			.log_binary = o->log_binary,
 		};
 		const char *pre = make_log_name(o->bw_log_file, o->name);
 		const char *suf;
@@ -1701,6 +1834,8 @@ static int add_job(struct thread_data *td, const char *jobname, int job_add_num,
 
 		if (p.log_gz_store)
 			suf = "log.fz";
+		else if (p.log_binary)
+			suf = "log.bin";
 		else
 			suf = "log";
 
@@ -1719,6 +1854,7 @@ static int add_job(struct thread_data *td, const char *jobname, int job_add_num,
 			.log_prio = o->log_prio,
 			.log_gz = o->log_gz,
 			.log_gz_store = o->log_gz_store,
+			.log_binary = o->log_binary,
 		};
 		const char *pre = make_log_name(o->iops_log_file, o->name);
 		const char *suf;
@@ -1733,6 +1869,8 @@ static int add_job(struct thread_data *td, const char *jobname, int job_add_num,
 
 		if (p.log_gz_store)
 			suf = "log.fz";
+		else if (p.log_binary)
+			suf = "log.bin";
 		else
 			suf = "log";
 
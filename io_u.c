@@ -9,8 +9,10 @@
 #include "lib/axmap.h"
 #include "err.h"
 #include "lib/pow2.h"
+#include "heatmap.h"
 #include "minmax.h"
 #include "zbd.h"
+#include "sync-pool.h"
 
 struct io_completion_data {
 	int nr;				/* input */
@@ -563,6 +565,13 @@ static unsigned long long get_next_buflen(struct thread_data *td, struct io_u *i
 	if (td->o.bs_is_seq_rand)
 		ddir = is_random ? DDIR_WRITE : DDIR_READ;
 
+	/*
+	 * A phase may set a block size of its own. Fall back to the job's if
+	 * it doesn't fit here.
+	 */
+	if (td->phase_bs[ddir] && io_u_fits(td, io_u, td->phase_bs[ddir]))
+		return td->phase_bs[ddir];
+
 	minbs = td->o.min_bs[ddir];
 	maxbs = td->o.max_bs[ddir];
 
@@ -669,6 +678,34 @@ int io_u_quiesce(struct thread_data *td)
 	return err;
 }
 
+/*
+ * Open loop rate: rather than draining the queue before sleeping until the
+ * next arrival, keep reaping completions as they come in. Otherwise IO
+ * completing while we sleep would have our sleep added to its latency.
+ * Returns the current time, in usec since the epoch.
+ */
+#define RATE_REAP_USEC	10
+
+static uint64_t rate_reap_until(struct thread_data *td, uint64_t until)
+{
+	uint64_t now = utime_since_now(&td->epoch);
+
+	if (td->io_u_queued || td->cur_depth)
+		td_io_commit(td);
+
+	while (td->io_u_in_flight && now < until && !td->terminate) {
+		int ret = io_u_queued_complete(td, 0);
+
+		if (ret < 0)
+			break;
+		if (!ret)
+			usec_sleep(td, min(until - now, (uint64_t) RATE_REAP_USEC));
+		now = utime_since_now(&td->epoch);
+	}
+
+	return now;
+}
+
 static enum fio_ddir rate_ddir(struct thread_data *td, enum fio_ddir ddir)
 {
 	enum fio_ddir odir = ddir ^ 1;
@@ -709,8 +746,15 @@ static enum fio_ddir rate_ddir(struct thread_data *td, enum fio_ddir ddir)
 	} else
 		usec = td->rate_next_io_time[ddir] - now;
 
-	if (td->o.io_submit_mode == IO_MODE_INLINE)
-		io_u_quiesce(td);
+	if (td->o.io_submit_mode != IO_MODE_OFFLOAD) {
+		if (td->o.rate_open_loop) {
+			uint64_t next = now + usec;
+
+			now = rate_reap_until(td, next);
+			usec = next > now ? next - now : 0;
+		} else
+			io_u_quiesce(td);
+	}
 
 	if (td->o.timeout && ((usec + now) > td->o.timeout)) {
 		/*
@@ -823,16 +867,11 @@ void put_file_log(struct thread_data *td, struct fio_file *f)
 
 void put_io_u(struct thread_data *td, struct io_u *io_u)
 {
-	const bool needs_lock = td_async_processing(td);
-
 	zbd_put_io_u(td, io_u);
 
 	if (td->parent)
 		td = td->parent;
 
-	if (needs_lock)
-		__td_io_u_lock(td);
-
 	if (io_u->file && !(io_u->flags & IO_U_F_NO_FILE_PUT))
 		put_file_log(td, io_u->file);
 
@@ -840,14 +879,20 @@ void put_io_u(struct thread_data *td, struct io_u *io_u)
 	io_u_set(td, io_u, IO_U_F_FREE);
 
 	if (io_u->flags & IO_U_F_IN_CUR_DEPTH) {
-		td->cur_depth--;
+		td_cur_depth_dec(td);
 		assert(!(td->flags & TD_F_CHILD));
 	}
-	io_u_qpush(&td->io_u_freelist, io_u);
-	td_io_u_free_notify(td);
 
-	if (needs_lock)
-		__td_io_u_unlock(td);
+	/*
+	 * With offload workers or async verify threads, hand the io_u back
+	 * on the lock-free return stack. __get_io_u() moves the whole stack
+	 * to the freelist in one go when it needs io_u's.
+	 */
+	if (td_async_processing(td)) {
+		io_u_spush(&td->io_u_returns, io_u);
+		td_io_u_return_notify(td);
+	} else
+		io_u_qpush(&td->io_u_freelist, io_u);
 }
 
 void clear_io_u(struct thread_data *td, struct io_u *io_u)
@@ -876,7 +921,7 @@ void requeue_io_u(struct thread_data *td, struct io_u **io_u)
 
 	io_u_clear(td, __io_u, IO_U_F_FLIGHT);
 	if (__io_u->flags & IO_U_F_IN_CUR_DEPTH) {
-		td->cur_depth--;
+		td_cur_depth_dec(td);
 		assert(!(td->flags & TD_F_CHILD));
 	}
 
@@ -1389,6 +1434,8 @@ static struct fio_file *get_next_file(struct thread_data *td)
 static long set_io_u_file(struct thread_data *td, struct io_u *io_u)
 {
 	struct fio_file *f;
+	uint64_t start;
+	int ret;
 
 	do {
 		f = get_next_file(td);
@@ -1396,9 +1443,12 @@ static long set_io_u_file(struct thread_data *td, struct io_u *io_u)
 			return PTR_ERR(f);
 
 		io_u->file = f;
-		get_file(f);
+		get_file(td, f);
 
-		if (!fill_io_u(td, io_u))
+		start = stage_start(td);
+		ret = fill_io_u(td, io_u);
+		stage_end(td, FIO_STAGE_FILL_IO_U, start);
+		if (!ret)
 			break;
 
 		zbd_put_io_u(td, io_u);
@@ -1580,17 +1630,89 @@ void lat_target_check(struct thread_data *td)
 		__lat_target_failed(td);
 }
 
+void iodepth_sweep_init(struct thread_data *td)
+{
+	if (!td->o.iodepth_sweep_nr)
+		return;
+
+	td->sweep_step = 0;
+	td->period_running = false;
+	td->latency_qd = td->o.iodepth_sweep[0];
+	td->ts.nr_sweep_steps = 0;
+}
+
+static void sweep_step_end(struct thread_data *td)
+{
+	struct period_stat *ps = &td->ts.sweep_steps[td->sweep_step];
+
+	period_stat_end(td, ps);
+	ps->depth = td->o.iodepth_sweep[td->sweep_step];
+	td->ts.nr_sweep_steps = td->sweep_step + 1;
+
+	dprint(FD_RATE, "Sweep step %u: depth=%u ios=%llu\n", td->sweep_step,
+		ps->depth, (unsigned long long) ps->ios);
+}
+
+/*
+ * Move on to the next iodepth_sweep step, if the current one has run for
+ * long enough. Once all steps are done, so is the job.
+ */
+void iodepth_sweep_check(struct thread_data *td)
+{
+	if (td->sweep_step >= td->o.iodepth_sweep_nr)
+		return;
+
+	if (!td->period_running) {
+		period_stat_start(td);
+		return;
+	}
+
+	if (utime_since_now(&td->period_ts) < td->o.iodepth_sweep_time)
+		return;
+
+	/*
+	 * Let the IO issued at this depth finish before switching, so it
+	 * doesn't end up being accounted to the next step.
+	 */
+	io_u_quiesce(td);
+	sweep_step_end(td);
+
+	if (++td->sweep_step == td->o.iodepth_sweep_nr) {
+		td->done = 1;
+		return;
+	}
+
+	td->latency_qd = td->o.iodepth_sweep[td->sweep_step];
+	period_stat_start(td);
+}
+
+/*
+ * The job ended before the sweep did. Record what we have of the current
+ * step.
+ */
+void iodepth_sweep_end(struct thread_data *td)
+{
+	if (!td->o.iodepth_sweep_nr || !td->period_running)
+		return;
+
+	io_u_quiesce(td);
+	sweep_step_end(td);
+	td->sweep_step = td->o.iodepth_sweep_nr;
+}
+
 /*
- * If latency target is enabled, we might be ramping up or down and not
- * using the full queue depth available.
+ * If latency target, an iodepth sweep or phases are enabled, we might be
+ * ramping up or down and not using the full queue depth available.
  */
 bool queue_full(const struct thread_data *td)
 {
-	const int qempty = io_u_qempty(&td->io_u_freelist);
+	const int qempty = io_u_qempty(&td->io_u_freelist) &&
+				io_u_sempty(&td->io_u_returns);
 
 	if (qempty)
 		return true;
-	if (!td->o.latency_target)
+	if (!td->o.latency_target && !td->o.iodepth_sweep_nr &&
+	    !td->nr_phases)
 		return false;
 
 	return td->cur_depth >= td->latency_qd;
@@ -1605,14 +1727,25 @@ struct io_u *__get_io_u(struct thread_data *td)
 	if (td->stop_io)
 		return NULL;
 
-	if (needs_lock)
-		__td_io_u_lock(td);
-
 again:
-	if (!io_u_rempty(&td->io_u_requeues)) {
+	if (needs_lock) {
+		/*
+		 * Pick up what other threads returned. Requeues are rare,
+		 * only take io_u_lock if there are any.
+		 */
+		io_u_ssplice(&td->io_u_returns, &td->io_u_freelist);
+
+		if (!io_u_rempty(&td->io_u_requeues)) {
+			__td_io_u_lock(td);
+			io_u = io_u_rpop(&td->io_u_requeues);
+			__td_io_u_unlock(td);
+		}
+	} else
 		io_u = io_u_rpop(&td->io_u_requeues);
+
+	if (io_u)
 		io_u->resid = 0;
-	} else if (!queue_full(td)) {
+	else if (!queue_full(td)) {
 		io_u = io_u_qpop(&td->io_u_freelist);
 
 		io_u->file = NULL;
@@ -1625,29 +1758,38 @@ again:
 		assert(io_u->flags & IO_U_F_FREE);
 		io_u_clear(td, io_u, IO_U_F_FREE | IO_U_F_NO_FILE_PUT |
 				 IO_U_F_TRIMMED | IO_U_F_BARRIER |
-				 IO_U_F_VER_LIST);
+				 IO_U_F_VER_LIST | IO_U_F_ARRIVAL);
 
 		io_u->error = 0;
+		io_u->sg_nr = 0;
 		io_u->acct_ddir = -1;
-		td->cur_depth++;
+		td_cur_depth_inc(td);
 		assert(!(td->flags & TD_F_CHILD));
 		io_u_set(td, io_u, IO_U_F_IN_CUR_DEPTH);
 		io_u->ipo = NULL;
-	} else if (td_async_processing(td)) {
+	} else if (needs_lock) {
 		/*
-		 * We ran out, wait for async verify threads to finish and
-		 * return one
+		 * We ran out, wait for offload workers or async verify
+		 * threads to finish and return one. Announce that we're
+		 * waiting before checking one last time, so a return can't
+		 * slip in between the check and the wait.
 		 */
 		assert(!(td->flags & TD_F_CHILD));
-		ret = pthread_cond_wait(&td->free_cond, &td->io_u_lock);
-		assert(ret == 0);
+		__td_io_u_lock(td);
+		__atomic_store_n(&td->free_waiting, 1, __ATOMIC_RELAXED);
+		__sync_synchronize();
+		if (io_u_sempty(&td->io_u_returns) &&
+		    io_u_rempty(&td->io_u_requeues)) {
+			ret = pthread_cond_wait(&td->free_cond,
+						&td->io_u_lock);
+			assert(ret == 0);
+		}
+		td->free_waiting = 0;
+		__td_io_u_unlock(td);
 		if (!td->error)
 			goto again;
 	}
 
-	if (needs_lock)
-		__td_io_u_unlock(td);
-
 	return io_u;
 }
 
@@ -1754,6 +1896,7 @@ static void small_content_scramble(struct io_u *io_u)
  */
 struct io_u *get_io_u(struct thread_data *td)
 {
+	uint64_t start = stage_start(td);
 	struct fio_file *f;
 	struct io_u *io_u;
 	int do_scramble = 0;
@@ -1762,6 +1905,7 @@ struct io_u *get_io_u(struct thread_data *td)
 	io_u = __get_io_u(td);
 	if (!io_u) {
 		dprint(FD_IO, "__get_io_u failed\n");
+		stage_end(td, FIO_STAGE_GET_IO_U, start);
 		return NULL;
 	}
 
@@ -1843,11 +1987,13 @@ out:
 		if (do_scramble)
 			small_content_scramble(io_u);
 
+		stage_end(td, FIO_STAGE_GET_IO_U, start);
 		return io_u;
 	}
 err_put:
 	dprint(FD_IO, "get_io_u failed\n");
 	put_io_u(td, io_u);
+	stage_end(td, FIO_STAGE_GET_IO_U, start);
 	return ERR_PTR(ret);
 }
 
@@ -1883,6 +2029,21 @@ void io_u_log_error(struct thread_data *td, struct io_u *io_u)
 		__io_u_log_error(td->parent, io_u);
 }
 
+void io_u_log_timeout(struct thread_data *td, struct io_u *io_u)
+{
+	unsigned long long elapsed = 0;
+
+	if (fio_fill_issue_time(td))
+		elapsed = utime_since_now(&io_u->issue_time);
+
+	log_info("fio: io_u timeout%s%s: %s offset=%llu, buflen=%llu, "
+		 "elapsed=%lluusec\n",
+		 io_u->file ? " on file " : "",
+		 io_u->file ? io_u->file->file_name : "",
+		 io_ddir_name(io_u->ddir),
+		 io_u->offset, io_u->xfer_buflen, elapsed);
+}
+
 static inline bool gtod_reduce(struct thread_data *td)
 {
 	return (td->o.disable_clat && td->o.disable_slat && td->o.disable_bw)
@@ -1904,8 +2065,13 @@ static void account_io_completion(struct thread_data *td, struct io_u *io_u,
 				  const enum fio_ddir idx, unsigned int bytes)
 {
 	const int no_reduce = !gtod_reduce(td);
+	struct thread_data *stat_td = td;
 	unsigned long long llnsec = 0;
 
+	/*
+	 * Samples go to the stats of the offload worker that completed the
+	 * IO, everything else is tracked by the job itself.
+	 */
 	if (td->parent)
 		td = td->parent;
 
@@ -1919,7 +2085,7 @@ static void account_io_completion(struct thread_data *td, struct io_u *io_u,
 		unsigned long long tnsec;
 
 		tnsec = ntime_since(&io_u->start_time, &icd->time);
-		add_lat_sample(td, idx, tnsec, bytes, io_u->offset,
+		add_lat_sample(stat_td, idx, tnsec, bytes, io_u->offset,
 			       io_u->ioprio, io_u->clat_prio_index);
 
 		if (td->flags & TD_F_PROFILE_OPS) {
@@ -1941,18 +2107,30 @@ static void account_io_completion(struct thread_data *td, struct io_u *io_u,
 
 	if (ddir_rw(idx)) {
 		if (!td->o.disable_clat) {
-			add_clat_sample(td, idx, llnsec, bytes, io_u->offset,
-					io_u->ioprio, io_u->clat_prio_index);
-			io_u_mark_latency(td, llnsec);
+			add_clat_sample(stat_td, idx, llnsec, bytes,
+					io_u->offset, io_u->ioprio,
+					io_u->clat_prio_index);
+			io_u_mark_latency(stat_td, llnsec);
+			if (stat_td->ts.heatmap)
+				lat_heatmap_add(stat_td->ts.heatmap,
+						io_u->file, io_u->offset, idx,
+						llnsec);
+			if (io_u->sg_nr)
+				add_sg_clat_sample(stat_td, io_u->sg_nr,
+						   llnsec);
 		}
 
+		if (no_reduce && (io_u->flags & IO_U_F_ARRIVAL))
+			add_ilat_sample(stat_td, idx,
+				ntime_since(&io_u->arrival_time, &icd->time));
+
 		if (!td->o.disable_bw && per_unit_log(td->bw_log))
-			add_bw_sample(td, io_u, bytes, llnsec);
+			add_bw_sample(stat_td, io_u, bytes, llnsec);
 
 		if (no_reduce && per_unit_log(td->iops_log))
-			add_iops_sample(td, io_u, bytes);
+			add_iops_sample(stat_td, io_u, bytes);
 	} else if (ddir_sync(idx) && !td->o.disable_clat)
-		add_sync_clat_sample(&td->ts, llnsec);
+		add_sync_clat_sample(&stat_td->ts, llnsec);
 
 	if (td->ts.nr_block_infos && io_u->ddir == DDIR_TRIM)
 		trim_block_info(td, io_u);
@@ -1992,11 +2170,12 @@ static void io_completed(struct thread_data *td, struct io_u **io_u_ptr,
 	struct io_u *io_u = *io_u_ptr;
 	enum fio_ddir ddir = io_u->ddir;
 	struct fio_file *f = io_u->file;
+	bool timedout = io_u->flags & IO_U_F_TIMEDOUT;
 
 	dprint_io_u(io_u, "complete");
 
 	assert(io_u->flags & IO_U_F_FLIGHT);
-	io_u_clear(td, io_u, IO_U_F_FLIGHT | IO_U_F_BUSY_OK);
+	io_u_clear(td, io_u, IO_U_F_FLIGHT | IO_U_F_BUSY_OK | IO_U_F_TIMEDOUT);
 
 	/*
 	 * Mark IO ok to verify
@@ -2068,6 +2247,13 @@ static void io_completed(struct thread_data *td, struct io_u **io_u_ptr,
 			if (ret && !icd->error)
 				icd->error = ret;
 		}
+	} else if (timedout) {
+		/*
+		 * The engine cancelled this IO after it exceeded its timeout.
+		 * Count it separately instead of failing the job.
+		 */
+		td->ts.timeout_io_u[ddir]++;
+		io_u_log_timeout(td, io_u);
 	} else if (io_u->error) {
 		icd->error = io_u->error;
 		io_u_log_error(td, io_u);
@@ -2112,7 +2298,10 @@ static void ios_completed(struct thread_data *td,
 	int i;
 
 	for (i = 0; i < icd->nr; i++) {
-		io_u = td->io_ops->event(td, i);
+		if (td->sync_pool)
+			io_u = sync_pool_event(td, i);
+		else
+			io_u = td->io_ops->event(td, i);
 
 		io_completed(td, &io_u, icd);
 
@@ -2140,6 +2329,7 @@ static void io_u_update_bytes_done(struct thread_data *td,
  */
 int io_u_sync_complete(struct thread_data *td, struct io_u *io_u)
 {
+	uint64_t start = stage_start(td);
 	struct io_completion_data icd;
 
 	init_icd(td, &icd, 1);
@@ -2150,11 +2340,13 @@ int io_u_sync_complete(struct thread_data *td, struct io_u *io_u)
 
 	if (icd.error) {
 		td_verror(td, icd.error, "io_u_sync_complete");
+		stage_end(td, FIO_STAGE_REAP, start);
 		return -1;
 	}
 
 	io_u_update_bytes_done(td, &icd);
 
+	stage_end(td, FIO_STAGE_REAP, start);
 	return 0;
 }
 
@@ -2164,6 +2356,7 @@ int io_u_sync_complete(struct thread_data *td, struct io_u *io_u)
 int io_u_queued_complete(struct thread_data *td, int min_evts)
 {
 	struct io_completion_data icd;
+	uint64_t start;
 	struct timespec *tvp = NULL;
 	int ret;
 	struct timespec ts = { .tv_sec = 0, .tv_nsec = 0, };
@@ -2178,21 +2371,29 @@ int io_u_queued_complete(struct thread_data *td, int min_evts)
 	/* No worries, td_io_getevents fixes min and max if they are
 	 * set incorrectly */
 	ret = td_io_getevents(td, min_evts, td->o.iodepth_batch_complete_max, tvp);
+
+	/*
+	 * Getting the events mostly means waiting for the device, start
+	 * counting the reap stage once they're in.
+	 */
+	start = stage_start(td);
 	if (ret < 0) {
 		td_verror(td, -ret, "td_io_getevents");
-		return ret;
+		goto out;
 	} else if (!ret)
-		return ret;
+		goto out;
 
 	init_icd(td, &icd, ret);
 	ios_completed(td, &icd);
 	if (icd.error) {
 		td_verror(td, icd.error, "io_u_queued_complete");
-		return -1;
+		ret = -1;
+		goto out;
 	}
 
 	io_u_update_bytes_done(td, &icd);
-
+out:
+	stage_end(td, FIO_STAGE_REAP, start);
 	return ret;
 }
 
@@ -2206,9 +2407,6 @@ void io_u_queued(struct thread_data *td, struct io_u *io_u)
 
 		slat_time = ntime_since(&io_u->start_time, &io_u->issue_time);
 
-		if (td->parent)
-			td = td->parent;
-
 		add_slat_sample(td, io_u->ddir, slat_time, io_u->xfer_buflen,
 				io_u->offset, io_u->ioprio);
 	}
@@ -2389,3 +2587,48 @@ err:
 	return 0;
 #endif
 }
+
+/*
+ * Max number of iovec segments an io_u buffer gets split into, 0 if
+ * sg_segments/sg_segment_size isn't used.
+ */
+unsigned int td_max_sg_segments(struct thread_data *td)
+{
+	unsigned long long max_bs = td_max_bs(td);
+
+	if (td->o.sg_segment_size)
+		return (max_bs + td->o.sg_segment_size - 1) / td->o.sg_segment_size;
+
+	return td->o.sg_segments;
+}
+
+/*
+ * Split the transfer buffer of an io_u into iovec segments. The segments
+ * cover the buffer in order, so the data transferred is the same as for a
+ * single segment. Returns the number of segments filled in.
+ */
+unsigned int io_u_fill_sg(const struct thread_data *td, struct io_u *io_u,
+			  struct iovec *iov)
+{
+	unsigned long long left = io_u->xfer_buflen, seg_len;
+	char *p = io_u->xfer_buf;
+	unsigned int nr = 0;
+
+	if (td->o.sg_segment_size)
+		seg_len = td->o.sg_segment_size;
+	else
+		seg_len = (left + td->o.sg_segments - 1) / td->o.sg_segments;
+
+	while (left) {
+		unsigned long long len = min(seg_len, left);
+
+		iov[nr].iov_base = p;
+		iov[nr].iov_len = len;
+		p += len;
+		left -= len;
+		nr++;
+	}
+
+	io_u->sg_nr = nr;
+	return nr;
+}
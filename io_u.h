@@ -7,11 +7,17 @@
 #include "debug.h"
 #include "file.h"
 #include "workqueue.h"
+#include "io_u_queue.h"
 
 #ifdef CONFIG_LIBAIO
 #include <libaio.h>
 #endif
 
+/*
+ * Max number of iovec segments an io_u buffer can be split into
+ */
+#define FIO_IO_U_SG_MAX		1024
+
 enum {
 	IO_U_F_FREE		= 1 << 0,
 	IO_U_F_FLIGHT		= 1 << 1,
@@ -21,6 +27,8 @@ enum {
 	IO_U_F_TRIMMED		= 1 << 5,
 	IO_U_F_BARRIER		= 1 << 6,
 	IO_U_F_VER_LIST		= 1 << 7,
+	IO_U_F_TIMEDOUT		= 1 << 8,
+	IO_U_F_ARRIVAL		= 1 << 9,
 };
 
 /*
@@ -30,6 +38,11 @@ struct io_u {
 	struct timespec start_time;
 	struct timespec issue_time;
 
+	/*
+	 * Scheduled arrival for open loop rated IO, IO_U_F_ARRIVAL
+	 */
+	struct timespec arrival_time;
+
 	struct fio_file *file;
 	unsigned int flags;
 	enum fio_ddir ddir;
@@ -82,6 +95,12 @@ struct io_u {
 	unsigned long long resid;
 	unsigned int error;
 
+	/*
+	 * Number of iovec segments the buffer was last submitted as, if
+	 * sg_segments or sg_segment_size is used
+	 */
+	unsigned int sg_nr;
+
 	/*
 	 * io engine private data
 	 */
@@ -96,6 +115,11 @@ struct io_u {
 		struct workqueue_work work;
 	};
 
+	/*
+	 * Link on the td->io_u_returns stack
+	 */
+	struct io_u *free_next;
+
 	/*
 	 * ZBD mode zbd_queue_io callback: called after engine->queue operation
 	 * to advance a zone write pointer and eventually unlock the I/O zone.
@@ -150,6 +174,7 @@ extern int __must_check io_u_queued_complete(struct thread_data *, int);
 extern void io_u_queued(struct thread_data *, struct io_u *);
 extern int io_u_quiesce(struct thread_data *);
 extern void io_u_log_error(struct thread_data *, struct io_u *);
+extern void io_u_log_timeout(struct thread_data *, struct io_u *);
 extern void io_u_mark_depth(struct thread_data *, unsigned int);
 extern void fill_io_buffer(struct thread_data *, void *, unsigned long long, unsigned long long);
 extern void io_u_fill_buffer(struct thread_data *td, struct io_u *, unsigned long long, unsigned long long);
@@ -158,8 +183,50 @@ void io_u_mark_submit(struct thread_data *, unsigned int);
 bool queue_full(const struct thread_data *);
 
 int do_io_u_sync(const struct thread_data *, struct io_u *);
+unsigned int td_max_sg_segments(struct thread_data *);
+unsigned int io_u_fill_sg(const struct thread_data *, struct io_u *, struct iovec *);
 int do_io_u_trim(const struct thread_data *, struct io_u *);
 
+static inline void io_u_spush(struct io_u_stack *s, struct io_u *io_u)
+{
+	struct io_u *head;
+
+	do {
+		head = s->head;
+		io_u->free_next = head;
+	} while (!__sync_bool_compare_and_swap(&s->head, head, io_u));
+}
+
+/*
+ * Move everything on the stack to the freelist, returns the number of
+ * io_us moved
+ */
+static inline unsigned int io_u_ssplice(struct io_u_stack *s,
+					struct io_u_queue *q)
+{
+	struct io_u *io_u;
+	unsigned int nr = 0;
+
+	if (!__atomic_load_n(&s->head, __ATOMIC_RELAXED))
+		return 0;
+
+	io_u = __sync_lock_test_and_set(&s->head, NULL);
+	while (io_u) {
+		struct io_u *next = io_u->free_next;
+
+		io_u_qpush(q, io_u);
+		io_u = next;
+		nr++;
+	}
+
+	return nr;
+}
+
+static inline int io_u_sempty(const struct io_u_stack *s)
+{
+	return !__atomic_load_n(&s->head, __ATOMIC_ACQUIRE);
+}
+
 #ifdef FIO_INC_DEBUG
 static inline void dprint_io_u(struct io_u *io_u, const char *p)
 {
@@ -86,4 +86,14 @@ static inline int io_u_rempty(struct io_u_ring *ring)
 	return ring->head == ring->tail;
 }
 
+/*
+ * Lock-free stack that other threads hand completed io_us back on. Any
+ * thread may push, but entries are only ever taken off all at once by the
+ * owner of the freelist, so there's no ABA problem. See io_u_spush() and
+ * io_u_ssplice() in io_u.h.
+ */
+struct io_u_stack {
+	struct io_u *head;
+};
+
 #endif
@@ -21,6 +21,7 @@
 #include "fio.h"
 #include "diskutil.h"
 #include "zbd.h"
+#include "sync-pool.h"
 
 static FLIST_HEAD(engine_list);
 
@@ -295,7 +296,9 @@ int td_io_getevents(struct thread_data *td, unsigned int min, unsigned int max,
 	if (td->done)
 		return 0;
 
-	if (min > 0 && td->io_ops->commit) {
+	if (min > 0 && td->sync_pool)
+		td_io_commit(td);
+	else if (min > 0 && td->io_ops->commit) {
 		r = td->io_ops->commit(td);
 		if (r < 0)
 			goto out;
@@ -306,7 +309,9 @@ int td_io_getevents(struct thread_data *td, unsigned int min, unsigned int max,
 		max = min;
 
 	r = 0;
-	if (max && td->io_ops->getevents)
+	if (max && td->sync_pool)
+		r = sync_pool_getevents(td, min, max, t);
+	else if (max && td->io_ops->getevents)
 		r = td->io_ops->getevents(td, min, max, t);
 out:
 	if (r >= 0) {
@@ -327,6 +332,7 @@ enum fio_q_status td_io_queue(struct thread_data *td, struct io_u *io_u)
 {
 	const enum fio_ddir ddir = acct_ddir(io_u);
 	unsigned long long buflen = io_u->xfer_buflen;
+	uint64_t start = stage_start(td);
 	enum fio_q_status ret;
 
 	dprint_io_u(io_u, "queue");
@@ -379,7 +385,10 @@ enum fio_q_status td_io_queue(struct thread_data *td, struct io_u *io_u)
 		td->rate_io_issue_bytes[ddir] += buflen;
 	}
 
-	ret = td->io_ops->queue(td, io_u);
+	if (td->sync_pool)
+		ret = sync_pool_queue(td, io_u);
+	else
+		ret = td->io_ops->queue(td, io_u);
 	zbd_queue_io_u(td, io_u, ret);
 
 	unlock_file(td, io_u->file);
@@ -419,7 +428,7 @@ enum fio_q_status td_io_queue(struct thread_data *td, struct io_u *io_u)
 			 io_u->file->file_name);
 	}
 
-	if (!td->io_ops->commit) {
+	if (!td->io_ops->commit && !td->sync_pool) {
 		io_u_mark_submit(td, 1);
 		io_u_mark_complete(td, 1);
 	}
@@ -456,6 +465,7 @@ enum fio_q_status td_io_queue(struct thread_data *td, struct io_u *io_u)
 		}
 	}
 
+	stage_end(td, FIO_STAGE_QUEUE, start);
 	return ret;
 }
 
@@ -490,7 +500,9 @@ void td_io_commit(struct thread_data *td)
 
 	io_u_mark_depth(td, td->io_u_queued);
 
-	if (td->io_ops->commit) {
+	if (td->sync_pool)
+		sync_pool_commit(td);
+	else if (td->io_ops->commit) {
 		ret = td->io_ops->commit(td);
 		if (ret)
 			td_verror(td, -ret, "io commit");
@@ -510,7 +522,7 @@ int td_io_open_file(struct thread_data *td, struct fio_file *f)
 		 * Open translates to undo closing.
 		 */
 		fio_file_clear_closing(f);
-		get_file(f);
+		get_file(td, f);
 		return 0;
 	}
 	assert(!fio_file_open(f));
@@ -537,7 +549,7 @@ int td_io_open_file(struct thread_data *td, struct fio_file *f)
 	disk_util_inc(f->du);
 
 	td->nr_open_files++;
-	get_file(f);
+	get_file(td, f);
 
 	if (f->filetype == FIO_TYPE_PIPE) {
 		if (td_random(td)) {
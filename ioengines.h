@@ -89,6 +89,8 @@ enum fio_ioengine_flags {
 			= 1 << 16,	/* async ioengine with commit function that sets issue_time */
 	FIO_SKIPPABLE_IOMEM_ALLOC
 			= 1 << 17,	/* skip iomem_alloc & iomem_free if job sets mem/iomem */
+	FIO_SG_SEGMENTS	= 1 << 18,	/* engine can split buffers with sg_segments */
+	FIO_MT_QUEUE	= 1 << 19,	/* sync ->queue can run on several threads at once */
 };
 
 /*
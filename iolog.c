@@ -20,6 +20,7 @@
 #include "blktrace.h"
 #include "pshared.h"
 #include "lib/roundup.h"
+#include "binlog.h"
 
 #include <netinet/in.h>
 #include <netinet/tcp.h>
@@ -220,7 +221,7 @@ int read_iolog_get(struct thread_data *td, struct io_u *io_u)
 			io_u->verify_offset = ipo->offset;
 			io_u->buflen = ipo->len;
 			io_u->file = td->files[ipo->fileno];
-			get_file(io_u->file);
+			get_file(td, io_u->file);
 			dprint(FD_IO, "iolog: get %llu/%llu/%s\n", io_u->offset,
 						io_u->buflen, io_u->file->file_name);
 			if (ipo->delay)
@@ -803,8 +804,6 @@ void setup_log(struct io_log **log, struct log_params *p,
 {
 	struct io_log *l;
 	int i;
-	struct io_u_plat_entry *entry;
-	struct flist_head *list;
 
 	l = scalloc(1, sizeof(*l));
 	INIT_FLIST_HEAD(&l->io_logs);
@@ -813,21 +812,21 @@ void setup_log(struct io_log **log, struct log_params *p,
 	l->log_prio = p->log_prio;
 	l->log_gz = p->log_gz;
 	l->log_gz_store = p->log_gz_store;
+	l->log_binary = p->log_binary && p->log_type != IO_LOG_TYPE_HIST;
 	l->avg_msec = p->avg_msec;
 	l->hist_msec = p->hist_msec;
 	l->hist_coarseness = p->hist_coarseness;
+	l->hist_sparse = p->hist_sparse;
 	l->filename = strdup(filename);
 	l->td = p->td;
 
-	/* Initialize histogram lists for each r/w direction,
-	 * with initial io_u_plat of all zeros:
+	/* Histogram and percentile samples are computed against the previous
+	 * window of each r/w direction, which starts out as all zeros:
 	 */
-	for (i = 0; i < DDIR_RWDIR_CNT; i++) {
-		list = &l->hist_window[i].list;
-		INIT_FLIST_HEAD(list);
-		entry = calloc(1, sizeof(struct io_u_plat_entry));
-		flist_add(&entry->list, list);
-	}
+	for (i = 0; (l->log_type == IO_LOG_TYPE_HIST ||
+		     l->log_type == IO_LOG_TYPE_PCTILE) && i < DDIR_RWDIR_CNT; i++)
+		l->hist_window[i].plat_last = calloc(FIO_IO_U_PLAT_NR,
+						     sizeof(uint64_t));
 
 	if (l->td && l->td->o.io_submit_mode != IO_MODE_OFFLOAD) {
 		unsigned int def_samples = DEF_LOG_ENTRIES;
@@ -887,6 +886,8 @@ static void clear_file_buffer(void *buf)
 
 void free_log(struct io_log *log)
 {
+	int i;
+
 	while (!flist_empty(&log->io_logs)) {
 		struct io_logs *cur_log;
 
@@ -902,6 +903,11 @@ void free_log(struct io_log *log)
 		log->pending = NULL;
 	}
 
+	for (i = 0; i < DDIR_RWDIR_CNT; i++) {
+		free(log->hist_window[i].plat_last);
+		free(log->hist_window[i].plat_sum);
+	}
+
 	free(log->pending);
 	free(log->filename);
 	sfree(log);
@@ -924,18 +930,44 @@ uint64_t hist_sum(int j, int stride, uint64_t *io_u_plat,
 	return sum;
 }
 
-static void flush_hist_samples(FILE *f, int hist_coarseness, void *samples,
-			       uint64_t sample_size)
+/*
+ * Print one histogram sample, given its counts already summed into 'nr'
+ * coarse bins. The dense format lists every bin. The sparse format lists
+ * the number of bins, followed by an index:count pair for each bin that
+ * isn't zero.
+ */
+void hist_print_sample(FILE *f, struct io_sample *s, uint64_t *bins,
+		       unsigned int nr, bool sparse)
+{
+	unsigned int j;
+
+	fprintf(f, "%lu, %u, %llu", (unsigned long) s->time,
+				io_sample_ddir(s), (unsigned long long) s->bs);
+
+	if (sparse) {
+		fprintf(f, ", %u", nr);
+		for (j = 0; j < nr; j++)
+			if (bins[j])
+				fprintf(f, ", %u:%llu", j,
+					(unsigned long long) bins[j]);
+	} else {
+		for (j = 0; j < nr; j++)
+			fprintf(f, ", %llu", (unsigned long long) bins[j]);
+	}
+
+	fprintf(f, "\n");
+}
+
+static void flush_hist_samples(FILE *f, int hist_coarseness, bool sparse,
+			       void *samples, uint64_t sample_size)
 {
 	struct io_sample *s;
 	int log_offset;
-	uint64_t i, j, nr_samples;
-	struct io_u_plat_entry *entry, *entry_before;
-	uint64_t *io_u_plat;
-	uint64_t *io_u_plat_before;
+	uint64_t i, nr_samples;
+	struct io_u_plat_delta *delta;
+	uint64_t bins[FIO_IO_U_PLAT_NR];
+	unsigned int j, nr_bins = FIO_IO_U_PLAT_NR >> hist_coarseness;
 
-	int stride = 1 << hist_coarseness;
-	
 	if (!sample_size)
 		return;
 
@@ -946,25 +978,46 @@ static void flush_hist_samples(FILE *f, int hist_coarseness, void *samples,
 
 	for (i = 0; i < nr_samples; i++) {
 		s = __get_sample(samples, log_offset, i);
+		delta = s->data.plat_delta;
 
-		entry = s->data.plat_entry;
-		io_u_plat = entry->io_u_plat;
+		memset(bins, 0, nr_bins * sizeof(uint64_t));
+		for (j = 0; j < delta->nr; j++)
+			bins[delta->bins[j].idx >> hist_coarseness] +=
+				delta->bins[j].val;
 
-		entry_before = flist_first_entry(&entry->list, struct io_u_plat_entry, list);
-		io_u_plat_before = entry_before->io_u_plat;
+		hist_print_sample(f, s, bins, nr_bins, sparse);
+		free(delta);
+	}
+}
 
-		fprintf(f, "%lu, %u, %llu, ", (unsigned long) s->time,
-						io_sample_ddir(s), (unsigned long long) s->bs);
-		for (j = 0; j < FIO_IO_U_PLAT_NR - stride; j += stride) {
-			fprintf(f, "%llu, ", (unsigned long long)
-			        hist_sum(j, stride, io_u_plat, io_u_plat_before));
-		}
-		fprintf(f, "%llu\n", (unsigned long long)
-		        hist_sum(FIO_IO_U_PLAT_NR - stride, stride, io_u_plat,
-					io_u_plat_before));
+/*
+ * Percentile log samples come in runs of one sample per percentile_list
+ * entry. The index of the entry is in bs and the length of the run in
+ * priority, and each run is written as a single line.
+ */
+void flush_pctile_samples(FILE *f, void *samples, uint64_t sample_size)
+{
+	struct io_sample *s;
+	int log_offset;
+	uint64_t i, nr_samples;
+
+	if (!sample_size)
+		return;
+
+	s = __get_sample(samples, 0, 0);
+	log_offset = (s->__ddir & LOG_OFFSET_SAMPLE_BIT) != 0;
+
+	nr_samples = sample_size / __log_entry_sz(log_offset);
 
-		flist_del(&entry_before->list);
-		free(entry_before);
+	for (i = 0; i < nr_samples; i++) {
+		s = __get_sample(samples, log_offset, i);
+
+		if (!s->bs)
+			fprintf(f, "%lu, %u", (unsigned long) s->time,
+				io_sample_ddir(s));
+		fprintf(f, ", %" PRId64, s->data.val);
+		if (s->bs + 1 == s->priority)
+			fprintf(f, "\n");
 	}
 }
 
@@ -1084,6 +1137,8 @@ struct inflate_chunk_iter {
 	size_t buf_size;
 	size_t buf_used;
 	size_t chunk_sz;
+	struct binlog *bl;
+	int log_type;
 };
 
 static void finish_chunk(z_stream *stream, FILE *f,
@@ -1096,7 +1151,12 @@ static void finish_chunk(z_stream *stream, FILE *f,
 		log_err("fio: failed to end log inflation seq %d (%d)\n",
 				iter->seq, ret);
 
-	flush_samples(f, iter->buf, iter->buf_used);
+	if (iter->bl)
+		binlog_write_samples(iter->bl, iter->buf, iter->buf_used);
+	else if (iter->log_type == IO_LOG_TYPE_PCTILE)
+		flush_pctile_samples(f, iter->buf, iter->buf_used);
+	else
+		flush_samples(f, iter->buf, iter->buf_used);
 	free(iter->buf);
 	iter->buf = NULL;
 	iter->buf_size = iter->buf_used = 0;
@@ -1167,9 +1227,13 @@ static size_t inflate_chunk(struct iolog_compress *ic, int gz_hdr, FILE *f,
  * Inflate stored compressed chunks, or write them directly to the log
  * file if so instructed.
  */
-static int inflate_gz_chunks(struct io_log *log, FILE *f)
+static int inflate_gz_chunks(struct io_log *log, FILE *f, struct binlog *bl)
 {
-	struct inflate_chunk_iter iter = { .chunk_sz = log->log_gz, };
+	struct inflate_chunk_iter iter = {
+		.chunk_sz	= log->log_gz,
+		.bl		= bl,
+		.log_type	= log->log_type,
+	};
 	z_stream stream;
 
 	while (!flist_empty(&log->chunk_list)) {
@@ -1283,7 +1347,7 @@ int iolog_file_inflate(const char *file)
 
 #else
 
-static int inflate_gz_chunks(struct io_log *log, FILE *f)
+static int inflate_gz_chunks(struct io_log *log, FILE *f, struct binlog *bl)
 {
 	return 0;
 }
@@ -1298,21 +1362,22 @@ int iolog_file_inflate(const char *file)
 
 void flush_log(struct io_log *log, bool do_append)
 {
+	struct binlog *bl = NULL;
 	void *buf;
 	FILE *f;
 
 	/*
-	 * If log_gz_store is true, we are writing a binary file.
-	 * Set the mode appropriately (on all platforms) to avoid issues
+	 * If log_gz_store or log_binary is true, we are writing a binary
+	 * file. Set the mode appropriately (on all platforms) to avoid issues
 	 * on windows (line-ending conversions, etc.)
 	 */
 	if (!do_append)
-		if (log->log_gz_store)
+		if (log->log_gz_store || log->log_binary)
 			f = fopen(log->filename, "wb");
 		else
 			f = fopen(log->filename, "w");
 	else
-		if (log->log_gz_store)
+		if (log->log_gz_store || log->log_binary)
 			f = fopen(log->filename, "ab");
 		else
 			f = fopen(log->filename, "a");
@@ -1323,7 +1388,17 @@ void flush_log(struct io_log *log, bool do_append)
 
 	buf = set_file_buffer(f);
 
-	inflate_gz_chunks(log, f);
+	if (log->log_binary) {
+		bl = binlog_open(f, log->log_type, log->log_offset,
+				 log->log_prio);
+		if (!bl) {
+			fclose(f);
+			clear_file_buffer(buf);
+			return;
+		}
+	}
+
+	inflate_gz_chunks(log, f, bl);
 
 	while (!flist_empty(&log->io_logs)) {
 		struct io_logs *cur_log;
@@ -1332,14 +1407,24 @@ void flush_log(struct io_log *log, bool do_append)
 		flist_del_init(&cur_log->list);
 		
 		if (log->td && log == log->td->clat_hist_log)
-			flush_hist_samples(f, log->hist_coarseness, cur_log->log,
-			                   log_sample_sz(log, cur_log));
+			flush_hist_samples(f, log->hist_coarseness,
+					   log->hist_sparse, cur_log->log,
+					   log_sample_sz(log, cur_log));
+		else if (bl)
+			binlog_write_samples(bl, cur_log->log,
+					     log_sample_sz(log, cur_log));
+		else if (log->log_type == IO_LOG_TYPE_PCTILE)
+			flush_pctile_samples(f, cur_log->log,
+					     log_sample_sz(log, cur_log));
 		else
 			flush_samples(f, cur_log->log, log_sample_sz(log, cur_log));
 		
 		sfree(cur_log);
 	}
 
+	if (bl)
+		binlog_close(bl);
+
 	fclose(f);
 	clear_file_buffer(buf);
 }
@@ -1752,6 +1837,21 @@ static int write_clat_hist_log(struct thread_data *td, int try, bool unit_log)
 	return ret;
 }
 
+static int write_clat_pctile_log(struct thread_data *td, int try,
+				 bool unit_log)
+{
+	int ret;
+
+	if (!unit_log)
+		return 0;
+
+	ret = __write_log(td, td->clat_pctile_log, try);
+	if (!ret)
+		td->clat_pctile_log = NULL;
+
+	return ret;
+}
+
 static int write_lat_log(struct thread_data *td, int try, bool unit_log)
 {
 	int ret;
@@ -1787,8 +1887,9 @@ enum {
 	CLAT_LOG_MASK	= 8,
 	IOPS_LOG_MASK	= 16,
 	CLAT_HIST_LOG_MASK = 32,
+	CLAT_PCTILE_LOG_MASK = 64,
 
-	ALL_LOG_NR	= 6,
+	ALL_LOG_NR	= 7,
 };
 
 struct log_type {
@@ -1820,6 +1921,10 @@ static struct log_type log_types[] = {
 	{
 		.mask	= CLAT_HIST_LOG_MASK,
 		.fn	= write_clat_hist_log,
+	},
+	{
+		.mask	= CLAT_PCTILE_LOG_MASK,
+		.fn	= write_clat_pctile_log,
 	}
 };
 
@@ -23,17 +23,19 @@ struct io_stat {
 struct io_hist {
 	uint64_t samples;
 	unsigned long hist_last;
-	struct flist_head list;
+	uint64_t *plat_last;
+	uint64_t *plat_sum;	/* offload workers' io_u_plat, summed */
 };
 
 
 union io_sample_data {
 	uint64_t val;
+	struct io_u_plat_delta *plat_delta;
 	struct io_u_plat_entry *plat_entry;
 };
 
 #define sample_val(value) ((union io_sample_data) { .val = value })
-#define sample_plat(plat) ((union io_sample_data) { .plat_entry = plat })
+#define sample_plat(plat) ((union io_sample_data) { .plat_delta = plat })
 
 /*
  * A single data sample
@@ -58,6 +60,7 @@ enum {
 	IO_LOG_TYPE_BW,
 	IO_LOG_TYPE_IOPS,
 	IO_LOG_TYPE_HIST,
+	IO_LOG_TYPE_PCTILE,
 };
 
 #define DEF_LOG_ENTRIES		1024
@@ -119,6 +122,11 @@ struct io_log {
 	 */
 	unsigned int log_gz_store;
 
+	/*
+	 * Write the log in the binary format of binlog.h, not as text
+	 */
+	unsigned int log_binary;
+
 	/*
 	 * Windowed average, for logging single entries average over some
 	 * period of time.
@@ -135,6 +143,7 @@ struct io_log {
 	struct io_hist hist_window[DDIR_RWDIR_CNT];
 	unsigned long hist_msec;
 	unsigned int hist_coarseness;
+	bool hist_sparse;
 
 	pthread_mutex_t chunk_lock;
 	unsigned int chunk_seq;
@@ -272,11 +281,13 @@ struct log_params {
 	unsigned long avg_msec;
 	unsigned long hist_msec;
 	int hist_coarseness;
+	bool hist_sparse;
 	int log_type;
 	int log_offset;
 	int log_prio;
 	int log_gz;
 	int log_gz_store;
+	int log_binary;
 	int log_compress;
 };
 
@@ -304,7 +315,10 @@ extern void finalize_logs(struct thread_data *td, bool);
 extern void setup_log(struct io_log **, struct log_params *, const char *);
 extern void flush_log(struct io_log *, bool);
 extern void flush_samples(FILE *, void *, uint64_t);
+extern void flush_pctile_samples(FILE *, void *, uint64_t);
 extern uint64_t hist_sum(int, int, uint64_t *, uint64_t *);
+extern void hist_print_sample(FILE *, struct io_sample *, uint64_t *,
+			      unsigned int, bool);
 extern void free_log(struct io_log *);
 extern void fio_writeout_logs(bool);
 extern void td_writeout_logs(struct thread_data *, bool);
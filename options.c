@@ -14,6 +14,7 @@
 #include "options.h"
 #include "optgroup.h"
 #include "zbd.h"
+#include "heatmap.h"
 
 char client_sockaddr_str[INET6_ADDRSTRLEN] = { 0 };
 
@@ -544,6 +545,46 @@ static int str_ignore_error_cb(void *data, const char *input)
 	return ret;
 }
 
+static int str_iodepth_sweep_cb(void *data, const char *input)
+{
+	struct thread_data *td = cb_data_to_td(data);
+	struct thread_options *o = &td->o;
+	char *str, *p, *depth;
+	int ret = 0;
+
+	if (parse_dryrun())
+		return 0;
+
+	p = str = strdup(input);
+
+	strip_blank_front(&str);
+	strip_blank_end(str);
+
+	o->iodepth_sweep_nr = 0;
+	while ((depth = strsep(&str, ":")) != NULL) {
+		long long val;
+
+		if (!strlen(depth))
+			continue;
+		if (o->iodepth_sweep_nr == IODEPTH_SWEEP_MAX) {
+			log_err("fio: iodepth_sweep has more than %d steps\n",
+				IODEPTH_SWEEP_MAX);
+			ret = 1;
+			break;
+		}
+		if (str_to_decimal(depth, &val, 0, o, 0, 0) || val < 1 ||
+		    val > UINT_MAX) {
+			log_err("fio: bad iodepth_sweep depth: %s\n", depth);
+			ret = 1;
+			break;
+		}
+		o->iodepth_sweep[o->iodepth_sweep_nr++] = val;
+	}
+
+	free(p);
+	return ret;
+}
+
 static int str_rw_cb(void *data, const char *str)
 {
 	struct thread_data *td = cb_data_to_td(data);
@@ -683,8 +724,8 @@ static int str_cpumask_cb(void *data, unsigned long long *val)
 	return 0;
 }
 
-static int set_cpus_allowed(struct thread_data *td, os_cpu_mask_t *mask,
-			    const char *input)
+int set_cpus_allowed(struct thread_data *td, os_cpu_mask_t *mask,
+		     const char *input)
 {
 	char *cpu, *str, *p;
 	long max_cpu;
@@ -813,7 +854,8 @@ static int str_numa_mpol_cb(void *data, char *input)
 {
 	struct thread_data *td = cb_data_to_td(data);
 	const char * const policy_types[] =
-		{ "default", "prefer", "bind", "interleave", "local", NULL };
+		{ "default", "prefer", "bind", "interleave", "local",
+		  "device", NULL };
 	int i;
 	char *nodelist;
 	struct bitmask *verify_bitmask;
@@ -827,14 +869,14 @@ static int str_numa_mpol_cb(void *data, char *input)
 		*nodelist++ = '\0';
 	}
 
-	for (i = 0; i <= MPOL_LOCAL; i++) {
+	for (i = 0; i <= MPOL_DEVICE; i++) {
 		if (!strcmp(input, policy_types[i])) {
 			td->o.numa_mem_mode = i;
 			break;
 		}
 	}
-	if (i > MPOL_LOCAL) {
-		log_err("fio: memory policy should be: default, prefer, bind, interleave, local\n");
+	if (i > MPOL_DEVICE) {
+		log_err("fio: memory policy should be: default, prefer, bind, interleave, local, device\n");
 		goto out;
 	}
 
@@ -865,11 +907,12 @@ static int str_numa_mpol_cb(void *data, char *input)
 		break;
 	case MPOL_LOCAL:
 	case MPOL_DEFAULT:
+	case MPOL_DEVICE:
 		/*
 		 * Don't allow a nodelist
 		 */
 		if (nodelist) {
-			log_err("fio: NO nodelist for \'local\'\n");
+			log_err("fio: NO nodelist for \'%s\'\n", input);
 			goto out;
 		}
 		break;
@@ -908,6 +951,7 @@ static int str_numa_mpol_cb(void *data, char *input)
 		break;
 	case MPOL_LOCAL:
 	case MPOL_DEFAULT:
+	case MPOL_DEVICE:
 	default:
 		break;
 	}
@@ -2251,6 +2295,10 @@ struct fio_option fio_options[FIO_MAX_OPTS] = {
 			    .oval = IO_MODE_OFFLOAD,
 			    .help = "Offload submit and complete to threads",
 			  },
+			  { .ival = "pool",
+			    .oval = IO_MODE_POOL,
+			    .help = "Issue sync engine calls from a pool of threads",
+			  },
 		},
 	},
 	{
@@ -3008,6 +3056,29 @@ struct fio_option fio_options[FIO_MAX_OPTS] = {
 		.category = FIO_OPT_C_IO,
 		.group	= FIO_OPT_G_INVALID,
 	},
+	{
+		.name	= "sg_segments",
+		.lname	= "Scatter-gather segments",
+		.type	= FIO_OPT_INT,
+		.off1	= offsetof(struct thread_options, sg_segments),
+		.minval	= 0,
+		.maxval	= FIO_IO_U_SG_MAX,
+		.help	= "Split each IO buffer into this many iovec segments",
+		.def	= "0",
+		.category = FIO_OPT_C_IO,
+		.group	= FIO_OPT_G_IO_BUF,
+	},
+	{
+		.name	= "sg_segment_size",
+		.lname	= "Scatter-gather segment size",
+		.type	= FIO_OPT_INT,
+		.off1	= offsetof(struct thread_options, sg_segment_size),
+		.minval	= 0,
+		.help	= "Split each IO buffer into iovec segments of this size",
+		.def	= "0",
+		.category = FIO_OPT_C_IO,
+		.group	= FIO_OPT_G_IO_BUF,
+	},
 	{
 		.name	= "verify",
 		.lname	= "Verify",
@@ -3894,9 +3965,51 @@ struct fio_option fio_options[FIO_MAX_OPTS] = {
 			    .oval = RATE_PROCESS_POISSON,
 			    .help = "Rate follows Poisson process",
 			  },
+			  {
+			    .ival = "bursty",
+			    .oval = RATE_PROCESS_BURSTY,
+			    .help = "Linear rate in on/off bursts",
+			  },
 		},
 		.parent = "rate",
 	},
+	{
+		.name	= "rate_burst_on",
+		.lname	= "Rate burst on time",
+		.type	= FIO_OPT_INT,
+		.off1	= offsetof(struct thread_options, rate_burst_on),
+		.help	= "Length of the on period for rate_process=bursty (usec)",
+		.def	= "0",
+		.is_time = 1,
+		.parent = "rate_process",
+		.hide	= 1,
+		.category = FIO_OPT_C_IO,
+		.group	= FIO_OPT_G_RATE,
+	},
+	{
+		.name	= "rate_burst_off",
+		.lname	= "Rate burst off time",
+		.type	= FIO_OPT_INT,
+		.off1	= offsetof(struct thread_options, rate_burst_off),
+		.help	= "Length of the off period for rate_process=bursty (usec)",
+		.def	= "0",
+		.is_time = 1,
+		.parent = "rate_process",
+		.hide	= 1,
+		.category = FIO_OPT_C_IO,
+		.group	= FIO_OPT_G_RATE,
+	},
+	{
+		.name	= "rate_open_loop",
+		.lname	= "Rate open loop",
+		.type	= FIO_OPT_BOOL,
+		.off1	= offsetof(struct thread_options, rate_open_loop),
+		.help	= "Measure latency from the scheduled arrival of each IO",
+		.def	= "0",
+		.parent = "rate",
+		.category = FIO_OPT_C_IO,
+		.group	= FIO_OPT_G_RATE,
+	},
 	{
 		.name	= "rate_cycle",
 		.alias	= "ratecycle",
@@ -3975,6 +4088,37 @@ struct fio_option fio_options[FIO_MAX_OPTS] = {
 		.category = FIO_OPT_C_IO,
 		.group	= FIO_OPT_G_LATPROF,
 	},
+	{
+		.name	= "iodepth_sweep",
+		.lname	= "IO depth sweep",
+		.type	= FIO_OPT_STR,
+		.cb	= str_iodepth_sweep_cb,
+		.off1	= offsetof(struct thread_options, iodepth_sweep_nr),
+		.help	= "Step through these queue depths (colon separated)",
+		.category = FIO_OPT_C_IO,
+		.group	= FIO_OPT_G_LATPROF,
+	},
+	{
+		.name	= "iodepth_sweep_time",
+		.lname	= "IO depth sweep step time",
+		.type	= FIO_OPT_STR_VAL_TIME,
+		.off1	= offsetof(struct thread_options, iodepth_sweep_time),
+		.help	= "How long to run each iodepth_sweep step",
+		.def	= "5s",
+		.is_time = 1,
+		.parent	= "iodepth_sweep",
+		.category = FIO_OPT_C_IO,
+		.group	= FIO_OPT_G_LATPROF,
+	},
+	{
+		.name	= "phases",
+		.lname	= "Workload phases",
+		.type	= FIO_OPT_STR_STORE,
+		.off1	= offsetof(struct thread_options, phases),
+		.help	= "Run the job as a sequence of phases (| separated)",
+		.category = FIO_OPT_C_IO,
+		.group	= FIO_OPT_G_IO_BASIC,
+	},
 	{
 		.name	= "invalidate",
 		.lname	= "Cache invalidate",
@@ -4073,6 +4217,17 @@ struct fio_option fio_options[FIO_MAX_OPTS] = {
 		.category = FIO_OPT_C_FILE,
 		.group	= FIO_OPT_G_INVALID,
 	},
+	{
+		.name	= "create_threads",
+		.lname	= "Create threads",
+		.type	= FIO_OPT_INT,
+		.off1	= offsetof(struct thread_options, create_threads),
+		.help	= "Number of threads laying out job files",
+		.def	= "1",
+		.minval	= 1,
+		.category = FIO_OPT_C_FILE,
+		.group	= FIO_OPT_G_INVALID,
+	},
 	{
 		.name	= "create_only",
 		.lname	= "Create Only",
@@ -4407,6 +4562,16 @@ struct fio_option fio_options[FIO_MAX_OPTS] = {
 		.category = FIO_OPT_C_LOG,
 		.group	= FIO_OPT_G_INVALID,
 	},
+	{
+		.name	= "log_percentiles_msec",
+		.lname	= "Log percentiles (msec)",
+		.type	= FIO_OPT_INT,
+		.off1	= offsetof(struct thread_options, log_pctile_msec),
+		.help	= "Log completion latency percentiles at frequency of this time value",
+		.def	= "0",
+		.category = FIO_OPT_C_LOG,
+		.group	= FIO_OPT_G_INVALID,
+	},
 	{
 		.name	= "log_hist_coarseness",
 		.lname	= "Histogram logs coarseness",
@@ -4419,6 +4584,17 @@ struct fio_option fio_options[FIO_MAX_OPTS] = {
 		.category = FIO_OPT_C_LOG,
 		.group	= FIO_OPT_G_INVALID,
 	},
+	{
+		.name	= "log_hist_sparse",
+		.lname	= "Sparse histogram logs",
+		.type	= FIO_OPT_BOOL,
+		.off1	= offsetof(struct thread_options, log_hist_sparse),
+		.help	= "Only write the histogram bins that changed in each"
+			" sample",
+		.def	= "0",
+		.category = FIO_OPT_C_LOG,
+		.group	= FIO_OPT_G_INVALID,
+	},
 	{
 		.name	= "write_hist_log",
 		.lname	= "Write latency histogram logs",
@@ -4514,6 +4690,16 @@ struct fio_option fio_options[FIO_MAX_OPTS] = {
 		.help	= "Install libz-dev(el) to get compression support",
 	},
 #endif
+	{
+		.name	= "log_binary",
+		.lname	= "Binary logs",
+		.type	= FIO_OPT_BOOL,
+		.off1	= offsetof(struct thread_options, log_binary),
+		.help	= "Write bw/iops/lat logs in a binary format",
+		.def	= "0",
+		.category = FIO_OPT_C_LOG,
+		.group	= FIO_OPT_G_INVALID,
+	},
 	{
 		.name = "log_unix_epoch",
 		.lname = "Log epoch unix",
@@ -4776,6 +4962,28 @@ struct fio_option fio_options[FIO_MAX_OPTS] = {
 		.category = FIO_OPT_C_STAT,
 		.group	= FIO_OPT_G_INVALID,
 	},
+	{
+		.name	= "lat_heatmap",
+		.lname	= "Latency heatmap",
+		.type	= FIO_OPT_INT,
+		.off1	= offsetof(struct thread_options, lat_heatmap),
+		.help	= "Keep completion latency histograms for this many "
+			  "offset regions of each file",
+		.maxval	= LAT_HEATMAP_MAX_REGIONS,
+		.def	= "0",
+		.category = FIO_OPT_C_STAT,
+		.group	= FIO_OPT_G_INVALID,
+	},
+	{
+		.name	= "lat_heatmap_file",
+		.lname	= "Latency heatmap file",
+		.type	= FIO_OPT_STR_STORE,
+		.off1	= offsetof(struct thread_options, lat_heatmap_file),
+		.help	= "Name prefix of the binary lat_heatmap file",
+		.parent	= "lat_heatmap",
+		.category = FIO_OPT_C_STAT,
+		.group	= FIO_OPT_G_INVALID,
+	},
 
 #ifdef FIO_HAVE_DISK_UTIL
 	{
@@ -4843,6 +5051,16 @@ struct fio_option fio_options[FIO_MAX_OPTS] = {
 		.category = FIO_OPT_C_STAT,
 		.group	= FIO_OPT_G_INVALID,
 	},
+	{
+		.name	= "stage_cycles",
+		.lname	= "IO stage cycle counts",
+		.type	= FIO_OPT_BOOL,
+		.off1	= offsetof(struct thread_options, stage_cycles),
+		.help	= "Count CPU cycles spent in each stage of the IO path",
+		.def	= "0",
+		.category = FIO_OPT_C_STAT,
+		.group	= FIO_OPT_G_INVALID,
+	},
 	{
 		.name	= "disable_bw_measurement",
 		.alias	= "disable_bw",
@@ -5248,6 +5466,7 @@ void fio_options_dup_and_init(struct option *long_options)
 	unsigned int i;
 
 	options_init(fio_options);
+	options_hash_init(fio_options);
 
 	i = 0;
 	while (long_options[i].name)
@@ -5668,6 +5887,7 @@ int add_option(const struct fio_option *o)
 
 	memcpy(&fio_options[opt_index], o, sizeof(*o));
 	fio_options[opt_index + 1].name = NULL;
+	options_hash_init(fio_options);
 	return 0;
 }
 
@@ -18,6 +18,7 @@
 #include "minmax.h"
 #include "lib/ieee754.h"
 #include "lib/pow2.h"
+#include "hash.h"
 
 #ifdef CONFIG_ARITHMETIC
 #include "y.tab.h"
@@ -1066,9 +1067,91 @@ static int handle_option(const struct fio_option *o, const char *__ptr,
 	return ret;
 }
 
+/*
+ * Open addressing hash of option names and aliases for the main option
+ * table, mapping each to the first entry in the table that matches it.
+ */
+#define OPT_HASH_SIZE	(4 * FIO_MAX_OPTS)
+#define OPT_HASH_MASK	(OPT_HASH_SIZE - 1)
+
+static const struct fio_option *opt_hash_options;
+static short opt_hash[OPT_HASH_SIZE];
+
+static unsigned int opt_hash_key(const char *name)
+{
+	return jhash(name, strlen(name), 0) & OPT_HASH_MASK;
+}
+
+static void opt_hash_add(const char *name, int index)
+{
+	const struct fio_option *o;
+	unsigned int h = opt_hash_key(name);
+
+	while (opt_hash[h] != -1) {
+		o = &opt_hash_options[opt_hash[h]];
+		if (o_match(o, name))
+			return;
+		h = (h + 1) & OPT_HASH_MASK;
+	}
+
+	opt_hash[h] = index;
+}
+
+/*
+ * (Re)build the hash, must be called again if the table changes
+ */
+void options_hash_init(const struct fio_option *options)
+{
+	const struct fio_option *o;
+
+	memset(opt_hash, 0xff, sizeof(opt_hash));
+	opt_hash_options = options;
+
+	for (o = &options[0]; o->name; o++) {
+		opt_hash_add(o->name, o - options);
+		if (o->alias)
+			opt_hash_add(o->alias, o - options);
+	}
+}
+
+/*
+ * Returns the first option matching opt, or NULL. The linear scan is still
+ * done if that option is unsupported, to log it and look further.
+ */
+static const struct fio_option *
+opt_hash_find(const struct fio_option *options, const char *opt, bool *done)
+{
+	const struct fio_option *o;
+	unsigned int h;
+
+	*done = false;
+	if (options != opt_hash_options)
+		return NULL;
+
+	h = opt_hash_key(opt);
+	while (opt_hash[h] != -1) {
+		o = &options[opt_hash[h]];
+		if (o_match(o, opt)) {
+			if (o->type == FIO_OPT_UNSUPPORTED)
+				return NULL;
+			*done = true;
+			return o;
+		}
+		h = (h + 1) & OPT_HASH_MASK;
+	}
+
+	*done = true;
+	return NULL;
+}
+
 struct fio_option *find_option(struct fio_option *options, const char *opt)
 {
 	struct fio_option *o;
+	bool done;
+
+	o = (struct fio_option *) opt_hash_find(options, opt, &done);
+	if (done)
+		return o;
 
 	for (o = &options[0]; o->name; o++) {
 		if (!o_match(o, opt))
@@ -1088,6 +1171,11 @@ const struct fio_option *
 find_option_c(const struct fio_option *options, const char *opt)
 {
 	const struct fio_option *o;
+	bool done;
+
+	o = opt_hash_find(options, opt, &done);
+	if (done)
+		return o;
 
 	for (o = &options[0]; o->name; o++) {
 		if (!o_match(o, opt))
@@ -0,0 +1,468 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "fio.h"
+#include "options.h"
+#include "verify.h"
+#include "phase.h"
+
+/*
+ * The options a phase may change. Anything that is sized or set up before
+ * the job starts running (files, buffers, the random map) stays fixed.
+ */
+static const char *phase_opts[] = {
+	"rw", "rwmixread", "rwmixwrite", "bs", "rate", "rate_iops",
+	"iodepth", "random_distribution", "thinktime", "thinktime_spin",
+	"thinktime_blocks", NULL,
+};
+
+static const struct fio_option *phase_option(const char *name)
+{
+	const struct fio_option *o;
+	int i;
+
+	o = find_option_c(fio_options, name);
+	if (!o)
+		return NULL;
+
+	for (i = 0; phase_opts[i]; i++)
+		if (!strcmp(o->name, phase_opts[i]))
+			return o;
+
+	return NULL;
+}
+
+static void phase_fill(struct fio_phase *fp, struct thread_options *o,
+		       bool bs_set)
+{
+	int i;
+
+	fp->td_ddir = o->td_ddir;
+	fp->ddir_seq_nr = o->ddir_seq_nr;
+	fp->ddir_seq_add = o->ddir_seq_add;
+	for (i = 0; i < DDIR_RWDIR_CNT; i++) {
+		fp->rwmix[i] = o->rwmix[i];
+		fp->perc_rand[i] = o->perc_rand[i];
+		if (!(o->td_ddir & TD_DDIR_RAND))
+			fp->perc_rand[i] = 0;
+		fp->bs[i] = bs_set ? o->bs[i] : 0;
+		fp->rate[i] = o->rate[i];
+		fp->rate_iops[i] = o->rate_iops[i];
+	}
+	if ((o->td_ddir & TD_DDIR_RW) == TD_DDIR_READ) {
+		fp->rwmix[DDIR_READ] = 100;
+		fp->rwmix[DDIR_WRITE] = 0;
+	} else if ((o->td_ddir & TD_DDIR_RW) == TD_DDIR_WRITE) {
+		fp->rwmix[DDIR_READ] = 0;
+		fp->rwmix[DDIR_WRITE] = 100;
+	}
+	fp->iodepth = o->iodepth;
+	fp->random_distribution = o->random_distribution;
+	fp->zipf_theta = o->zipf_theta;
+	fp->pareto_h = o->pareto_h;
+	fp->gauss_dev = o->gauss_dev;
+	fp->random_center = o->random_center;
+	fp->thinktime = o->thinktime;
+	fp->thinktime_spin = min(o->thinktime_spin, o->thinktime);
+	fp->thinktime_blocks = o->thinktime_blocks;
+}
+
+/*
+ * A phase can only narrow down what the job was set up for: its
+ * directions, block sizes and depth must fit within those of the job.
+ */
+static int phase_check(struct thread_data *td, struct fio_phase *fp, int nr)
+{
+	struct thread_options *o = &td->o;
+	int ret = 0;
+	int i;
+
+	if ((fp->td_ddir & ~TD_DDIR_RAND) & ~o->td_ddir) {
+		log_err("fio: phase %d: rw can't add directions to the job\n",
+			nr);
+		ret |= 1;
+	}
+	if (((fp->td_ddir | o->td_ddir) & TD_DDIR_TRIM) &&
+	    fp->td_ddir != o->td_ddir) {
+		log_err("fio: phase %d: rw can't be changed for trim jobs\n",
+			nr);
+		ret |= 1;
+	}
+	if ((fp->td_ddir & TD_DDIR_RAND) && !td_random(td)) {
+		log_err("fio: phase %d: random IO needs a random job\n", nr);
+		ret |= 1;
+	}
+	for (i = 0; i < DDIR_RWDIR_CNT; i++) {
+		if (fp->bs[i] > td_max_bs(td)) {
+			log_err("fio: phase %d: bs is larger than the job's\n",
+				nr);
+			ret |= 1;
+			break;
+		}
+		if (fp->bs[i] && o->verify != VERIFY_NONE &&
+		    fp->bs[i] % o->verify_interval) {
+			log_err("fio: phase %d: bs must be a multiple of "
+				"verify_interval\n", nr);
+			ret |= 1;
+			break;
+		}
+	}
+	if (!fp->iodepth || fp->iodepth > o->iodepth) {
+		log_err("fio: phase %d: iodepth must be between 1 and the "
+			"job's iodepth\n", nr);
+		ret |= 1;
+	}
+	if (fp->random_distribution != o->random_distribution) {
+		if (fp->random_distribution == FIO_RAND_DIST_ZONED ||
+		    fp->random_distribution == FIO_RAND_DIST_ZONED_ABS ||
+		    o->random_distribution == FIO_RAND_DIST_ZONED ||
+		    o->random_distribution == FIO_RAND_DIST_ZONED_ABS) {
+			log_err("fio: phase %d: zoned random_distribution "
+				"can't be used with phases\n", nr);
+			ret |= 1;
+		} else if (o->random_distribution == FIO_RAND_DIST_RANDOM &&
+			   !o->norandommap) {
+			log_err("fio: phase %d: random_distribution needs "
+				"norandommap\n", nr);
+			ret |= 1;
+		} else if (o->random_generator == FIO_RAND_GEN_LFSR) {
+			log_err("fio: phase %d: random_distribution can't be "
+				"changed with the lfsr generator\n", nr);
+			ret |= 1;
+		}
+	}
+
+	return ret;
+}
+
+static int phase_parse(struct thread_data *td, struct thread_data *scratch,
+		       struct fio_phase *fp, char *str, bool *bs_set, int nr)
+{
+	const struct fio_option *o;
+	bool rwmix_set = false;
+	long long val;
+	char *opt, *arg;
+
+	while ((opt = strsep(&str, " \t")) != NULL) {
+		if (!strlen(opt))
+			continue;
+
+		arg = strchr(opt, '=');
+		if (!arg) {
+			log_err("fio: phase %d: %s needs a value\n", nr, opt);
+			return 1;
+		}
+		*arg++ = '\0';
+
+		if (!strcmp(opt, "duration")) {
+			if (check_str_time(arg, &val, 1) || val <= 0) {
+				log_err("fio: phase %d: bad duration %s\n",
+					nr, arg);
+				return 1;
+			}
+			fp->duration = val;
+			continue;
+		} else if (!strcmp(opt, "bytes")) {
+			if (check_str_bytes(arg, &val, &td->o) || val <= 0) {
+				log_err("fio: phase %d: bad bytes %s\n",
+					nr, arg);
+				return 1;
+			}
+			fp->bytes = val;
+			continue;
+		}
+
+		o = phase_option(opt);
+		if (!o) {
+			log_err("fio: phase %d: %s can't be set by a phase\n",
+				nr, opt);
+			return 1;
+		}
+		if (!strcmp(o->name, "random_distribution") &&
+		    !strncmp(arg, "zoned", 5)) {
+			log_err("fio: phase %d: zoned random_distribution "
+				"can't be used with phases\n", nr);
+			return 1;
+		}
+
+		/*
+		 * A phase sets either a bandwidth or an IOPS rate, the one
+		 * given last wins.
+		 */
+		if (!strcmp(o->name, "rate"))
+			memset(scratch->o.rate_iops, 0,
+				sizeof(scratch->o.rate_iops));
+		else if (!strcmp(o->name, "rate_iops"))
+			memset(scratch->o.rate, 0, sizeof(scratch->o.rate));
+		else if (!strcmp(o->name, "bs"))
+			*bs_set = true;
+		else if (!strcmp(o->name, "rwmixread") ||
+			 !strcmp(o->name, "rwmixwrite"))
+			rwmix_set = true;
+
+		if (parse_cmd_option(o->name, arg, fio_options, &scratch->o,
+				     NULL))
+			return 1;
+	}
+
+	/*
+	 * The mix only applies to mixed workloads, don't let it be dropped
+	 * silently when the rw the phase ends up with has one direction.
+	 */
+	if (rwmix_set && (scratch->o.td_ddir & TD_DDIR_RW) != TD_DDIR_RW) {
+		log_err("fio: phase %d: rwmixread and rwmixwrite need a mixed "
+			"rw\n", nr);
+		return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Parse the phases option into td->phases. Each phase starts out with the
+ * settings the previous one ended with, the first with those of the job.
+ */
+int phases_setup(struct thread_data *td)
+{
+	struct thread_data *scratch;
+	struct fio_phase *phases;
+	char *str, *p, *phase;
+	bool bs_set = false;
+	int nr = 0, ret = 0;
+
+	if (!td->o.phases || !strlen(td->o.phases))
+		return 0;
+
+	scratch = malloc(sizeof(*scratch));
+	memcpy(scratch, td, sizeof(*td));
+	/*
+	 * One extra slot for the job's own settings, to go back to once the
+	 * phases are done.
+	 */
+	phases = calloc(FIO_PHASES_MAX + 1, sizeof(struct fio_phase));
+
+	p = str = strdup(td->o.phases);
+	while ((phase = strsep(&p, "|")) != NULL) {
+		strip_blank_front(&phase);
+		strip_blank_end(phase);
+		if (!strlen(phase))
+			continue;
+
+		if (nr == FIO_PHASES_MAX) {
+			log_err("fio: phases has more than %d phases\n",
+				FIO_PHASES_MAX);
+			ret = 1;
+			break;
+		}
+
+		ret = phase_parse(td, scratch, &phases[nr], phase, &bs_set,
+				  nr + 1);
+		if (ret)
+			break;
+
+		phase_fill(&phases[nr], &scratch->o, bs_set);
+		ret = phase_check(td, &phases[nr], nr + 1);
+		if (ret)
+			break;
+		nr++;
+	}
+
+	if (!ret) {
+		int i;
+
+		for (i = 0; i < nr - 1; i++) {
+			if (phases[i].duration || phases[i].bytes)
+				continue;
+			log_err("fio: phase %d has no duration or bytes, only "
+				"the last phase may run until the job ends\n",
+				i + 1);
+			ret = 1;
+			break;
+		}
+	}
+
+	free(str);
+	free(scratch);
+
+	if (ret || !nr) {
+		free(phases);
+		return ret;
+	}
+
+	phase_fill(&phases[nr], &td->o, false);
+	td->phases = phases;
+	td->nr_phases = nr;
+	return 0;
+}
+
+void phases_free(struct thread_data *td)
+{
+	free(td->phases);
+	td->phases = NULL;
+	td->nr_phases = 0;
+}
+
+/*
+ * Point the rate schedule of a direction at the current time, so a new
+ * rate neither has to catch up on nor gets credit for the previous phase.
+ */
+static void phase_rate_rebase(struct thread_data *td, enum fio_ddir ddir,
+			      uint64_t now)
+{
+	uint64_t bps = td->rate_bps[ddir];
+	uint64_t usec = now;
+
+	/*
+	 * For bursty, the schedule only advances during the on periods.
+	 */
+	if (td->o.rate_process == RATE_PROCESS_BURSTY) {
+		uint64_t on = td->o.rate_burst_on;
+		uint64_t period = on + td->o.rate_burst_off;
+
+		usec = (now / period) * on + min(now % period, on);
+	}
+
+	td->rate_io_issue_bytes[ddir] = bps * (usec / 1000000) +
+					bps * (usec % 1000000) / 1000000;
+	td->rate_next_io_time[ddir] = now;
+	td->last_usec[ddir] = now;
+}
+
+static void phase_apply(struct thread_data *td, struct fio_phase *fp)
+{
+	struct thread_options *o = &td->o;
+	bool check_rate = false;
+	bool new_dist;
+	uint64_t now;
+
+	dprint(FD_RATE, "Phase %u: rw=%d depth=%u\n", td->cur_phase,
+		fp->td_ddir, fp->iodepth);
+
+	o->ddir_seq_nr = fp->ddir_seq_nr;
+	o->ddir_seq_add = fp->ddir_seq_add;
+	td->ddir_seq_nr = o->ddir_seq_nr;
+	td->rwmix_issues = 0;
+	td->latency_qd = fp->iodepth;
+
+	o->thinktime = fp->thinktime;
+	o->thinktime_spin = fp->thinktime_spin;
+	o->thinktime_blocks = fp->thinktime_blocks;
+
+	now = utime_since_now(&td->epoch);
+	for_each_rw_ddir(ddir) {
+		unsigned long long bs;
+
+		o->rwmix[ddir] = fp->rwmix[ddir];
+		o->perc_rand[ddir] = fp->perc_rand[ddir];
+		td->phase_bs[ddir] = fp->bs[ddir];
+		o->rate[ddir] = fp->rate[ddir];
+		o->rate_iops[ddir] = fp->rate_iops[ddir];
+
+		bs = fp->bs[ddir] ? fp->bs[ddir] : o->min_bs[ddir];
+		if (o->rate[ddir])
+			td->rate_bps[ddir] = o->rate[ddir];
+		else
+			td->rate_bps[ddir] = (uint64_t) o->rate_iops[ddir] * bs;
+		phase_rate_rebase(td, ddir, now);
+
+		if (option_check_rate(td, ddir))
+			check_rate = true;
+	}
+
+	if (check_rate)
+		td->flags |= TD_F_CHECK_RATE;
+	else
+		td->flags &= ~TD_F_CHECK_RATE;
+
+	new_dist = o->random_distribution != fp->random_distribution ||
+		o->zipf_theta.u.f != fp->zipf_theta.u.f ||
+		o->pareto_h.u.f != fp->pareto_h.u.f ||
+		o->gauss_dev.u.f != fp->gauss_dev.u.f ||
+		o->random_center.u.f != fp->random_center.u.f;
+	if (new_dist) {
+		o->random_distribution = fp->random_distribution;
+		o->zipf_theta = fp->zipf_theta;
+		o->pareto_h = fp->pareto_h;
+		o->gauss_dev = fp->gauss_dev;
+		o->random_center = fp->random_center;
+		init_rand_distribution(td);
+	}
+}
+
+void phases_init(struct thread_data *td)
+{
+	if (!td->nr_phases)
+		return;
+
+	td->cur_phase = 0;
+	td->period_running = false;
+	td->ts.nr_phases = 0;
+	phase_apply(td, &td->phases[0]);
+}
+
+static void phase_end(struct thread_data *td)
+{
+	struct period_stat *ps = &td->ts.phases[td->cur_phase];
+
+	period_stat_end(td, ps);
+	ps->depth = td->latency_qd;
+	td->ts.nr_phases = td->cur_phase + 1;
+
+	dprint(FD_RATE, "Phase %u: ios=%llu\n", td->cur_phase,
+		(unsigned long long) ps->ios);
+}
+
+/*
+ * Move on to the next phase once the current one reached its duration or
+ * byte count. The job ends with the last bounded phase.
+ */
+void phases_check(struct thread_data *td)
+{
+	struct fio_phase *fp;
+
+	if (td->cur_phase >= td->nr_phases)
+		return;
+
+	if (!td->period_running) {
+		period_stat_start(td);
+		return;
+	}
+
+	fp = &td->phases[td->cur_phase];
+	if (!(fp->duration &&
+	      utime_since_now(&td->period_ts) >= fp->duration) &&
+	    !(fp->bytes &&
+	      ddir_rw_sum(td->io_bytes) - td->period_bytes >= fp->bytes))
+		return;
+
+	/*
+	 * Let the IO issued by this phase finish before switching, so it
+	 * doesn't end up being accounted to the next one.
+	 */
+	io_u_quiesce(td);
+	phase_end(td);
+
+	if (++td->cur_phase == td->nr_phases) {
+		phase_apply(td, &td->phases[td->nr_phases]);
+		td->done = 1;
+		return;
+	}
+
+	phase_apply(td, &td->phases[td->cur_phase]);
+	period_stat_start(td);
+}
+
+/*
+ * The job ended before its phases did. Record what we have of the current
+ * one.
+ */
+void phases_end(struct thread_data *td)
+{
+	if (!td->nr_phases || !td->period_running)
+		return;
+
+	io_u_quiesce(td);
+	phase_end(td);
+	td->cur_phase = td->nr_phases;
+	phase_apply(td, &td->phases[td->nr_phases]);
+}
@@ -0,0 +1,47 @@
+#ifndef FIO_PHASE_H
+#define FIO_PHASE_H
+
+#include "thread_options.h"
+
+/*
+ * One phase of a job, as parsed from the phases option. Settings are
+ * cumulative, so a phase holds the complete set of the options that
+ * phases may change, not just the ones given for it.
+ */
+struct fio_phase {
+	unsigned long long duration;	/* usec, 0 if unbounded */
+	unsigned long long bytes;	/* 0 if unbounded */
+
+	/*
+	 * Files are opened for the directions of the job, so a phase doesn't
+	 * change those. Its rw setting maps to a read/write mix and a
+	 * percentage of random IO instead.
+	 */
+	enum td_ddir td_ddir;
+	unsigned int ddir_seq_nr;
+	long long ddir_seq_add;
+	unsigned int rwmix[DDIR_RWDIR_CNT];
+	unsigned int perc_rand[DDIR_RWDIR_CNT];
+	unsigned long long bs[DDIR_RWDIR_CNT];
+	uint64_t rate[DDIR_RWDIR_CNT];
+	unsigned int rate_iops[DDIR_RWDIR_CNT];
+	unsigned int iodepth;
+
+	unsigned int random_distribution;
+	fio_fp64_t zipf_theta;
+	fio_fp64_t pareto_h;
+	fio_fp64_t gauss_dev;
+	fio_fp64_t random_center;
+
+	unsigned int thinktime;
+	unsigned int thinktime_spin;
+	unsigned int thinktime_blocks;
+};
+
+extern int phases_setup(struct thread_data *);
+extern void phases_free(struct thread_data *);
+extern void phases_init(struct thread_data *);
+extern void phases_check(struct thread_data *);
+extern void phases_end(struct thread_data *);
+
+#endif
@@ -9,6 +9,7 @@
 #include "ioengines.h"
 #include "lib/getrusage.h"
 #include "rate-submit.h"
+#include "heatmap.h"
 
 static void check_overlap(struct io_u *io_u)
 {
@@ -166,6 +167,23 @@ static int io_workqueue_init_worker_fn(struct submit_worker *sw)
 	INIT_FLIST_HEAD(&td->trim_list);
 	td->io_hist_tree = RB_ROOT;
 
+	/*
+	 * The worker accounts its completions in its own copy of the stats,
+	 * keep it from sharing the per prio arrays and the ilat histogram of
+	 * the parent. Only the parent's stats need to be in shared memory.
+	 */
+	for_each_rw_ddir(ddir) {
+		td->ts.clat_prio[ddir] = NULL;
+		td->ts.nr_clat_prio[ddir] = 0;
+	}
+	if (parent->ts.ilat_plat) {
+		td->ts.ilat_plat = calloc(FIO_ILAT_PLAT_NR, sizeof(uint64_t));
+		if (!td->ts.ilat_plat)
+			goto err;
+	}
+	if (parent->ts.heatmap)
+		td->ts.heatmap = lat_heatmap_clone(parent->ts.heatmap);
+
 	td->o.iodepth = 1;
 	if (td_io_init(td))
 		goto err_io_init;
@@ -205,6 +223,11 @@ static void io_workqueue_exit_worker_fn(struct submit_worker *sw,
 	 */
 	sw->wq->td->ts.disable_prio_stat = 1;
 	sum_thread_stats(&sw->wq->td->ts, &td->ts);
+	free(td->ts.ilat_plat);
+	td->ts.ilat_plat = NULL;
+	lat_heatmap_sum(&sw->wq->td->ts.heatmap, td->ts.heatmap);
+	lat_heatmap_free(td->ts.heatmap);
+	td->ts.heatmap = NULL;
 
 	fio_options_free(td);
 	close_and_free_files(td);
@@ -302,10 +325,76 @@ int rate_submit_init(struct thread_data *td, struct sk_out *sk_out)
 	return workqueue_init(td, &td->io_wq, &rated_wq_ops, td->o.iodepth, sk_out);
 }
 
+/*
+ * Zero td->offload_ts, but keep the ilat histogram that summing into it may
+ * have allocated.
+ */
+static void offload_ts_clear(struct thread_stat *ts)
+{
+	uint64_t *ilat_plat = ts->ilat_plat;
+
+	memset(ts, 0, sizeof(*ts));
+	if (ilat_plat) {
+		memset(ilat_plat, 0, FIO_ILAT_PLAT_NR * sizeof(uint64_t));
+		ts->ilat_plat = ilat_plat;
+	}
+}
+
 void rate_submit_exit(struct thread_data *td)
 {
 	if (td->o.io_submit_mode != IO_MODE_OFFLOAD)
 		return;
 
+	/*
+	 * The workers' stats are folded into td->ts as they exit, so stop
+	 * running reports from counting them a second time.
+	 */
+	if (td->offload_ts)
+		offload_ts_clear(td->offload_ts);
+
 	workqueue_exit(&td->io_wq);
 }
+
+/*
+ * Offload workers account the IOs they complete in their own thread_stat,
+ * which needs no locking since only the worker writes to it. These are
+ * summed into the job's stats when the workers exit, and looked at through
+ * here by anything that needs them while the job is running. Returns the
+ * stats of worker 'nr' of 'td', or NULL past the last one.
+ */
+struct thread_stat *rate_submit_worker_ts(struct thread_data *td,
+					  unsigned int nr)
+{
+	struct workqueue *wq = &td->io_wq;
+	struct thread_data *worker;
+
+	if (td->o.io_submit_mode != IO_MODE_OFFLOAD || !wq->workers ||
+	    nr >= wq->max_workers)
+		return NULL;
+
+	worker = wq->workers[nr].priv;
+	return worker ? &worker->ts : NULL;
+}
+
+/*
+ * Sum the workers' stats into td->offload_ts, which running reports add to
+ * those of the job. It's shared memory, unlike the workers.
+ */
+void rate_submit_update_stats(struct thread_data *td)
+{
+	struct thread_stat *dst = td->offload_ts;
+	struct thread_stat *ts;
+	unsigned int i;
+
+	if (!dst)
+		return;
+
+	offload_ts_clear(dst);
+	init_thread_stat_min_vals(dst);
+	dst->lat_percentiles = td->ts.lat_percentiles;
+	dst->ioprio = td->ts.ioprio;
+	dst->disable_prio_stat = 1;
+
+	for (i = 0; (ts = rate_submit_worker_ts(td, i)); i++)
+		sum_thread_stats(dst, ts);
+}
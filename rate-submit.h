@@ -3,5 +3,7 @@
 
 int rate_submit_init(struct thread_data *, struct sk_out *);
 void rate_submit_exit(struct thread_data *);
+struct thread_stat *rate_submit_worker_ts(struct thread_data *, unsigned int);
+void rate_submit_update_stats(struct thread_data *);
 
 #endif
@@ -1659,6 +1659,21 @@ static void convert_io_stat(struct io_stat *dst, struct io_stat *src)
 	dst->S.u.i	= cpu_to_le64(fio_double_to_uint64(src->S.u.f));
 }
 
+static void convert_period_stat(struct period_stat *dst,
+				struct period_stat *src)
+{
+	int i;
+
+	dst->depth	= cpu_to_le32(src->depth);
+	dst->start	= cpu_to_le64(src->start);
+	dst->runtime	= cpu_to_le64(src->runtime);
+	dst->ios	= cpu_to_le64(src->ios);
+	dst->bytes	= cpu_to_le64(src->bytes);
+	dst->clat_sum	= cpu_to_le64(src->clat_sum);
+	for (i = 0; i < FIO_IO_U_LIST_MAX_LEN; i++)
+		dst->clat_percentiles[i] = cpu_to_le64(src->clat_percentiles[i]);
+}
+
 static void convert_gs(struct group_run_stats *dst, struct group_run_stats *src)
 {
 	int i;
@@ -1688,6 +1703,7 @@ void fio_server_send_ts(struct thread_stat *ts, struct group_run_stats *rs)
 	struct cmd_ts_pdu p;
 	int i, j, k;
 	size_t clat_prio_stats_extra_size = 0;
+	size_t ilat_extra_size = 0;
 	size_t ss_extra_size = 0;
 	size_t extended_buf_size = 0;
 	void *extended_buf;
@@ -1764,6 +1780,7 @@ void fio_server_send_ts(struct thread_stat *ts, struct group_run_stats *rs)
 	for (i = 0; i < DDIR_RWDIR_CNT; i++) {
 		p.ts.short_io_u[i]	= cpu_to_le64(ts->short_io_u[i]);
 		p.ts.drop_io_u[i]	= cpu_to_le64(ts->drop_io_u[i]);
+		p.ts.timeout_io_u[i]	= cpu_to_le64(ts->timeout_io_u[i]);
 	}
 
 	p.ts.total_submit	= cpu_to_le64(ts->total_submit);
@@ -1803,6 +1820,24 @@ void fio_server_send_ts(struct thread_stat *ts, struct group_run_stats *rs)
 
 	p.ts.cachehit		= cpu_to_le64(ts->cachehit);
 	p.ts.cachemiss		= cpu_to_le64(ts->cachemiss);
+	p.ts.inline_complete	= cpu_to_le64(ts->inline_complete);
+	p.ts.deferred_complete	= cpu_to_le64(ts->deferred_complete);
+
+	for (i = 0; i < FIO_IO_U_SG_LAT_NR; i++)
+		convert_io_stat(&p.ts.sg_clat_stat[i], &ts->sg_clat_stat[i]);
+	for (i = 0; i < DDIR_RWDIR_CNT; i++)
+		convert_io_stat(&p.ts.ilat_stat[i], &ts->ilat_stat[i]);
+
+	p.ts.nr_sweep_steps	= cpu_to_le32(ts->nr_sweep_steps);
+	for (i = 0; i < IODEPTH_SWEEP_MAX; i++)
+		convert_period_stat(&p.ts.sweep_steps[i], &ts->sweep_steps[i]);
+	p.ts.nr_phases		= cpu_to_le32(ts->nr_phases);
+	for (i = 0; i < FIO_PHASES_MAX; i++)
+		convert_period_stat(&p.ts.phases[i], &ts->phases[i]);
+
+	p.ts.cycles_per_msec	= cpu_to_le64(ts->cycles_per_msec);
+	for (i = 0; i < FIO_STAGE_NR; i++)
+		p.ts.stage_cycles[i] = cpu_to_le64(ts->stage_cycles[i]);
 
 	convert_gs(&p.rs, rs);
 
@@ -1812,6 +1847,10 @@ void fio_server_send_ts(struct thread_stat *ts, struct group_run_stats *rs)
 	}
 	extended_buf_size += clat_prio_stats_extra_size;
 
+	if (ts->ilat_plat)
+		ilat_extra_size = FIO_ILAT_PLAT_NR * sizeof(uint64_t);
+	extended_buf_size += ilat_extra_size;
+
 	dprint(FD_NET, "ts->ss_state = %d\n", ts->ss_state);
 	if (ts->ss_state & FIO_SS_DATA)
 		ss_extra_size = 2 * ts->ss_dur * sizeof(uint64_t);
@@ -1858,6 +1897,19 @@ void fio_server_send_ts(struct thread_stat *ts, struct group_run_stats *rs)
 		}
 	}
 
+	if (ilat_extra_size) {
+		uint64_t *ilat_plat = extended_buf_wp;
+		uint64_t offset;
+		struct cmd_ts_pdu *ptr = extended_buf;
+
+		for (i = 0; i < FIO_ILAT_PLAT_NR; i++)
+			ilat_plat[i] = cpu_to_le64(ts->ilat_plat[i]);
+
+		offset = (char *)extended_buf_wp - (char *)extended_buf;
+		ptr->ts.ilat_plat_offset = cpu_to_le64(offset);
+		extended_buf_wp = ilat_plat + FIO_ILAT_PLAT_NR;
+	}
+
 	if (ss_extra_size) {
 		uint64_t *ss_iops, *ss_bw;
 		uint64_t offset;
@@ -2047,46 +2099,46 @@ static int __fio_append_iolog_gz_hist(struct sk_entry *first, struct io_log *log
 				      struct io_logs *cur_log, z_stream *stream)
 {
 	struct sk_entry *entry;
+	struct io_u_plat_entry *plat_entry;
 	void *out_pdu;
-	int ret, i, j;
+	int ret = 0, i, j;
 	int sample_sz = log_entry_sz(log);
 
 	out_pdu = malloc(FIO_SERVER_MAX_FRAGMENT_PDU);
 	stream->avail_out = FIO_SERVER_MAX_FRAGMENT_PDU;
 	stream->next_out = out_pdu;
 
+	plat_entry = calloc(1, sizeof(*plat_entry));
+
 	for (i = 0; i < cur_log->nr_samples; i++) {
 		struct io_sample *s;
-		struct io_u_plat_entry *cur_plat_entry, *prev_plat_entry;
-		uint64_t *cur_plat, *prev_plat;
+		struct io_u_plat_delta *delta;
 
 		s = get_sample(log, cur_log, i);
 		ret = __deflate_pdu_buffer(s, sample_sz, &out_pdu, &entry, stream, first);
 		if (ret)
-			return ret;
+			break;
 
-		/* Do the subtraction on server side so that client doesn't have to
-		 * reconstruct our linked list from packets.
+		/* Expand the sparse delta on server side so that the client
+		 * gets a complete histogram for each sample.
 		 */
-		cur_plat_entry  = s->data.plat_entry;
-		prev_plat_entry = flist_first_entry(&cur_plat_entry->list, struct io_u_plat_entry, list);
-		cur_plat  = cur_plat_entry->io_u_plat;
-		prev_plat = prev_plat_entry->io_u_plat;
-
-		for (j = 0; j < FIO_IO_U_PLAT_NR; j++) {
-			cur_plat[j] -= prev_plat[j];
-		}
+		delta = s->data.plat_delta;
+		memset(plat_entry->io_u_plat, 0, sizeof(plat_entry->io_u_plat));
+		for (j = 0; j < delta->nr; j++)
+			plat_entry->io_u_plat[delta->bins[j].idx] = delta->bins[j].val;
 
-		flist_del(&prev_plat_entry->list);
-		free(prev_plat_entry);
+		free(delta);
 
-		ret = __deflate_pdu_buffer(cur_plat_entry, sizeof(*cur_plat_entry),
+		ret = __deflate_pdu_buffer(plat_entry, sizeof(*plat_entry),
 					   &out_pdu, &entry, stream, first);
-
 		if (ret)
-			return ret;
+			break;
 	}
 
+	free(plat_entry);
+	if (ret)
+		return ret;
+
 	__fio_net_prep_tail(stream, out_pdu, &entry, first);
 	return entry == NULL;
 }
@@ -2258,6 +2310,8 @@ int fio_send_iolog(struct thread_data *td, struct io_log *log, const char *name)
 		.thread_number		= cpu_to_le32(td->thread_number),
 		.log_type		= cpu_to_le32(log->log_type),
 		.log_hist_coarseness	= cpu_to_le32(log->hist_coarseness),
+		.log_hist_sparse	= __cpu_to_le32(log->hist_sparse),
+		.log_binary		= cpu_to_le32(log->log_binary),
 	};
 	struct sk_entry *first;
 	struct flist_head *entry;
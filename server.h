@@ -51,7 +51,7 @@ struct fio_net_cmd_reply {
 };
 
 enum {
-	FIO_SERVER_VER			= 98,
+	FIO_SERVER_VER			= 111,
 
 	FIO_SERVER_MAX_FRAGMENT_PDU	= 1024,
 	FIO_SERVER_MAX_CMD_MB		= 2048,
@@ -198,6 +198,8 @@ struct cmd_iolog_pdu {
 	uint32_t log_offset;
 	uint32_t log_prio;
 	uint32_t log_hist_coarseness;
+	uint32_t log_hist_sparse;
+	uint32_t log_binary;
 	uint8_t name[FIO_NET_NAME_MAX];
 	struct io_sample samples[0];
 };
@@ -12,11 +12,14 @@
 #include "lib/getrusage.h"
 #include "idletime.h"
 #include "lib/pow2.h"
+#include "lib/fls.h"
 #include "lib/output_buffer.h"
 #include "helper_thread.h"
 #include "smalloc.h"
 #include "zbd.h"
 #include "oslib/asprintf.h"
+#include "rate-submit.h"
+#include "heatmap.h"
 
 #ifdef WIN32
 #define LOG_MSEC_SLACK	2
@@ -586,6 +589,8 @@ static void show_ddir_status(struct group_run_stats *rs, struct thread_stat *ts,
 		display_lat("clat", min, max, mean, dev, out);
 	if (calc_lat(&ts->lat_stat[ddir], &min, &max, &mean, &dev))
 		display_lat(" lat", min, max, mean, dev, out);
+	if (calc_lat(&ts->ilat_stat[ddir], &min, &max, &mean, &dev))
+		display_lat("ilat", min, max, mean, dev, out);
 
 	/* Only print per prio stats if there are >= 2 prios with samples */
 	if (get_nr_prios_with_samples(ts, ddir) >= 2) {
@@ -619,6 +624,12 @@ static void show_ddir_status(struct group_run_stats *rs, struct thread_stat *ts,
 					ts->lat_stat[ddir].samples,
 					ts->percentile_list,
 					ts->percentile_precision, "lat", out);
+	if (ts->clat_percentiles && ts->ilat_plat &&
+	    ts->ilat_stat[ddir].samples > 0)
+		show_clat_percentiles(&ts->ilat_plat[ddir * FIO_IO_U_PLAT_NR],
+					ts->ilat_stat[ddir].samples,
+					ts->percentile_list,
+					ts->percentile_precision, "ilat", out);
 
 	if (ts->clat_percentiles || ts->lat_percentiles) {
 		char prio_name[64];
@@ -702,6 +713,7 @@ static void show_mixed_ddir_status(struct group_run_stats *rs,
 		show_ddir_status(rs, ts_lcl, DDIR_READ, out);
 
 	free_clat_prio_stats(ts_lcl);
+	free_ilat_plat(ts_lcl);
 	free(ts_lcl);
 }
 
@@ -776,6 +788,124 @@ static void show_latencies(struct thread_stat *ts, struct buf_output *out)
 	show_lat_m(io_u_lat_m, out);
 }
 
+static void sg_lat_bucket_name(char *buf, size_t len, int i)
+{
+	if (!i || i == FIO_IO_U_SG_LAT_NR - 1)
+		snprintf(buf, len, "%u", 1U << i);
+	else
+		snprintf(buf, len, "%u-%u", 1U << i, (2U << i) - 1);
+}
+
+static void show_sg_latencies(struct thread_stat *ts, struct buf_output *out)
+{
+	unsigned long long min, max;
+	double mean, dev;
+	char bucket[16], name[32];
+	int i;
+
+	for (i = 0; i < FIO_IO_U_SG_LAT_NR; i++) {
+		if (!calc_lat(&ts->sg_clat_stat[i], &min, &max, &mean, &dev))
+			continue;
+
+		sg_lat_bucket_name(bucket, sizeof(bucket), i);
+		snprintf(name, sizeof(name), "sg clat segs=%s", bucket);
+		display_lat(name, min, max, mean, dev, out);
+	}
+}
+
+/*
+ * The knee of an iodepth sweep is the step with the highest power, the
+ * ratio of throughput to mean latency. Past it, latency grows faster than
+ * throughput does.
+ */
+static int sweep_knee(struct thread_stat *ts)
+{
+	double power, best = 0.0;
+	int i, knee = -1;
+
+	for (i = 0; i < ts->nr_sweep_steps; i++) {
+		struct period_stat *ps = &ts->sweep_steps[i];
+
+		if (!ps->runtime || !ps->clat_sum)
+			continue;
+
+		power = (double) ps->ios * ps->ios /
+			((double) ps->runtime * ps->clat_sum);
+		if (power > best) {
+			best = power;
+			knee = i;
+		}
+	}
+
+	return knee;
+}
+
+static void show_period_stat(struct thread_stat *ts,
+			     struct group_run_stats *rs,
+			     struct period_stat *ps, const char *name,
+			     const char *suffix, struct buf_output *out)
+{
+	int i2p = is_power_of_2(rs->kb_base);
+	unsigned long long iops = 0, bw = 0;
+	char *iops_p, *bw_p;
+	double mean;
+	int i;
+
+	if (ps->runtime) {
+		iops = ps->ios * 1000000 / ps->runtime;
+		bw = ps->bytes * 1000000 / ps->runtime;
+	}
+	mean = ps->ios ? (double) ps->clat_sum / ps->ios : 0.0;
+	iops_p = num2str(iops, ts->sig_figs, 1, 0, N2S_NONE);
+	bw_p = num2str(bw, ts->sig_figs, 1, i2p, ts->unit_base);
+
+	log_buf(out, "     %s: IOPS=%s, BW=%s, clat avg=%.2fusec", name,
+		iops_p, bw_p, mean / 1000.0);
+	for (i = 0; i < FIO_IO_U_LIST_MAX_LEN; i++) {
+		if (ts->percentile_list[i].u.f == 0.0)
+			break;
+		if (ts->percentile_list[i].u.f != 99.0)
+			continue;
+		log_buf(out, ", 99.00th=%lluusec",
+			(unsigned long long) ps->clat_percentiles[i] / 1000);
+	}
+	log_buf(out, "%s\n", suffix);
+
+	free(iops_p);
+	free(bw_p);
+}
+
+static void show_sweep_normal(struct thread_stat *ts,
+			      struct group_run_stats *rs,
+			      struct buf_output *out)
+{
+	int i, knee = sweep_knee(ts);
+	char name[32];
+
+	log_buf(out, "  iodepth sweep:\n");
+	for (i = 0; i < ts->nr_sweep_steps; i++) {
+		snprintf(name, sizeof(name), "depth=%-4u",
+			 ts->sweep_steps[i].depth);
+		show_period_stat(ts, rs, &ts->sweep_steps[i], name,
+				 i == knee ? " (knee)" : "", out);
+	}
+}
+
+static void show_phases_normal(struct thread_stat *ts,
+			       struct group_run_stats *rs,
+			       struct buf_output *out)
+{
+	char name[64];
+	int i;
+
+	log_buf(out, "  phases:\n");
+	for (i = 0; i < ts->nr_phases; i++) {
+		snprintf(name, sizeof(name), "phase %d (start=%llumsec)", i + 1,
+			 (unsigned long long) ts->phases[i].start);
+		show_period_stat(ts, rs, &ts->phases[i], name, "", out);
+	}
+}
+
 static int block_state_category(int block_state)
 {
 	switch (block_state) {
@@ -1199,6 +1329,7 @@ static void show_thread_status_normal(struct thread_stat *ts,
 		show_mixed_ddir_status(rs, ts, out);
 
 	show_latencies(ts, out);
+	show_sg_latencies(ts, out);
 
 	if (ts->sync_stat.samples)
 		show_ddir_status(rs, ts, DDIR_SYNC, out);
@@ -1252,6 +1383,17 @@ static void show_thread_status_normal(struct thread_stat *ts,
 					(unsigned long long) ts->drop_io_u[0],
 					(unsigned long long) ts->drop_io_u[1],
 					(unsigned long long) ts->drop_io_u[2]);
+	if (ts->timeout_io_u[0] || ts->timeout_io_u[1] || ts->timeout_io_u[2]) {
+		log_buf(out, "     timeouts  : %llu,%llu,%llu\n",
+					(unsigned long long) ts->timeout_io_u[0],
+					(unsigned long long) ts->timeout_io_u[1],
+					(unsigned long long) ts->timeout_io_u[2]);
+	}
+	if (ts->inline_complete || ts->deferred_complete) {
+		log_buf(out, "     completion: inline=%llu, deferred=%llu\n",
+					(unsigned long long) ts->inline_complete,
+					(unsigned long long) ts->deferred_complete);
+	}
 	if (ts->continue_on_error) {
 		log_buf(out, "     errors    : total=%llu, first_error=%d/<%s>\n",
 					(unsigned long long)ts->total_err_count,
@@ -1265,6 +1407,10 @@ static void show_thread_status_normal(struct thread_stat *ts,
 					ts->latency_percentile.u.f,
 					ts->latency_depth);
 	}
+	if (ts->nr_sweep_steps)
+		show_sweep_normal(ts, rs, out);
+	if (ts->nr_phases)
+		show_phases_normal(ts, rs, out);
 
 	if (ts->nr_block_infos)
 		show_block_infos(ts->nr_block_infos, ts->block_infos,
@@ -1377,6 +1523,7 @@ static void show_mixed_ddir_status_terse(struct thread_stat *ts,
 		show_ddir_status_terse(ts_lcl, rs, DDIR_READ, ver, out);
 
 	free_clat_prio_stats(ts_lcl);
+	free_ilat_plat(ts_lcl);
 	free(ts_lcl);
 }
 
@@ -1472,6 +1619,7 @@ static void add_ddir_status_json(struct thread_stat *ts,
 		json_object_add_value_int(dir_object, "total_ios", ts->total_io_u[ddir]);
 		json_object_add_value_int(dir_object, "short_ios", ts->short_io_u[ddir]);
 		json_object_add_value_int(dir_object, "drop_ios", ts->drop_io_u[ddir]);
+		json_object_add_value_int(dir_object, "timeout_ios", ts->timeout_io_u[ddir]);
 
 		tmp_object = add_ddir_lat_json(ts, ts->slat_percentiles,
 				&ts->slat_stat[ddir], ts->io_u_plat[FIO_SLAT][ddir]);
@@ -1484,6 +1632,14 @@ static void add_ddir_status_json(struct thread_stat *ts,
 		tmp_object = add_ddir_lat_json(ts, ts->lat_percentiles,
 				&ts->lat_stat[ddir], ts->io_u_plat[FIO_LAT][ddir]);
 		json_object_add_value_object(dir_object, "lat_ns", tmp_object);
+
+		if (ts->ilat_plat && ts->ilat_stat[ddir].samples) {
+			tmp_object = add_ddir_lat_json(ts, ts->clat_percentiles,
+					&ts->ilat_stat[ddir],
+					&ts->ilat_plat[ddir * FIO_IO_U_PLAT_NR]);
+			json_object_add_value_object(dir_object, "ilat_ns",
+						     tmp_object);
+		}
 	} else {
 		json_object_add_value_int(dir_object, "total_ios", ts->total_io_u[DDIR_SYNC]);
 		tmp_object = add_ddir_lat_json(ts, ts->lat_percentiles | ts->clat_percentiles,
@@ -1574,6 +1730,7 @@ static void add_mixed_ddir_status_json(struct thread_stat *ts,
 		add_ddir_status_json(ts_lcl, rs, DDIR_READ, parent);
 
 	free_clat_prio_stats(ts_lcl);
+	free_ilat_plat(ts_lcl);
 	free(ts_lcl);
 }
 
@@ -1675,6 +1832,46 @@ static void json_add_job_opts(struct json_object *root, const char *name,
 	}
 }
 
+static struct json_object *add_period_stat_json(struct thread_stat *ts,
+						struct period_stat *ps)
+{
+	struct json_object *obj, *percentile_object;
+	uint64_t bw_bytes = 0;
+	double iops = 0.0, mean = 0.0;
+	char buf[32];
+	int i;
+
+	if (ps->runtime) {
+		iops = ps->ios * 1000000.0 / ps->runtime;
+		bw_bytes = ps->bytes * 1000000 / ps->runtime;
+	}
+	if (ps->ios)
+		mean = (double) ps->clat_sum / ps->ios;
+
+	obj = json_create_object();
+	json_object_add_value_int(obj, "depth", ps->depth);
+	json_object_add_value_int(obj, "start_msec", ps->start);
+	json_object_add_value_int(obj, "runtime_usec", ps->runtime);
+	json_object_add_value_int(obj, "total_ios", ps->ios);
+	json_object_add_value_int(obj, "io_bytes", ps->bytes);
+	json_object_add_value_float(obj, "iops", iops);
+	json_object_add_value_int(obj, "bw_bytes", bw_bytes);
+	json_object_add_value_float(obj, "clat_mean_ns", mean);
+
+	percentile_object = json_create_object();
+	json_object_add_value_object(obj, "clat_percentile_ns",
+				     percentile_object);
+	for (i = 0; i < FIO_IO_U_LIST_MAX_LEN; i++) {
+		if (ts->percentile_list[i].u.f == 0.0)
+			break;
+		snprintf(buf, sizeof(buf), "%f", ts->percentile_list[i].u.f);
+		json_object_add_value_int(percentile_object, buf,
+					  ps->clat_percentiles[i]);
+	}
+
+	return obj;
+}
+
 static struct json_object *show_thread_status_json(struct thread_stat *ts,
 						   struct group_run_stats *rs,
 						   struct flist_head *opt_list)
@@ -1814,6 +2011,43 @@ static struct json_object *show_thread_status_json(struct thread_stat *ts,
 		json_object_add_value_int(root, "first_error", ts->first_error);
 	}
 
+	if (ts->inline_complete || ts->deferred_complete) {
+		json_object_add_value_int(root, "inline_complete", ts->inline_complete);
+		json_object_add_value_int(root, "deferred_complete", ts->deferred_complete);
+	}
+
+	if (ts->cycles_per_msec) {
+		static const char *stage_names[FIO_STAGE_NR] = {
+			"get_io_u", "fill_io_u", "queue", "reap", "clat",
+		};
+		uint64_t ios = ddir_rw_sum(ts->total_io_u);
+		struct json_object *stages;
+
+		stages = json_create_object();
+		json_object_add_value_object(root, "stage_cycles", stages);
+		json_object_add_value_int(stages, "cycles_per_msec",
+					  ts->cycles_per_msec);
+		json_object_add_value_int(stages, "ios", ios);
+		for (i = 0; i < FIO_STAGE_NR; i++)
+			json_object_add_value_float(stages, stage_names[i],
+				ios ? (double) ts->stage_cycles[i] / ios : 0.0);
+	}
+
+	tmp = NULL;
+	for (i = 0; i < FIO_IO_U_SG_LAT_NR; i++) {
+		char name[16];
+
+		if (!ts->sg_clat_stat[i].samples)
+			continue;
+		if (!tmp) {
+			tmp = json_create_object();
+			json_object_add_value_object(root, "sg_clat_ns", tmp);
+		}
+		sg_lat_bucket_name(name, sizeof(name), i);
+		json_object_add_value_object(tmp, name,
+			add_ddir_lat_json(ts, 0, &ts->sg_clat_stat[i], NULL));
+	}
+
 	if (ts->latency_depth) {
 		json_object_add_value_int(root, "latency_depth", ts->latency_depth);
 		json_object_add_value_int(root, "latency_target", ts->latency_target);
@@ -1821,6 +2055,34 @@ static struct json_object *show_thread_status_json(struct thread_stat *ts,
 		json_object_add_value_int(root, "latency_window", ts->latency_window);
 	}
 
+	if (ts->nr_sweep_steps) {
+		struct json_object *sweep, *tmp;
+		struct json_array *steps;
+		int knee = sweep_knee(ts);
+
+		sweep = json_create_object();
+		json_object_add_value_object(root, "iodepth_sweep", sweep);
+		json_object_add_value_int(sweep, "knee_depth", knee >= 0 ?
+					  ts->sweep_steps[knee].depth : 0);
+		steps = json_create_array();
+		json_object_add_value_array(sweep, "steps", steps);
+
+		for (i = 0; i < ts->nr_sweep_steps; i++) {
+			tmp = add_period_stat_json(ts, &ts->sweep_steps[i]);
+			json_object_add_value_int(tmp, "knee", i == knee);
+			json_array_add_value_object(steps, tmp);
+		}
+	}
+
+	if (ts->nr_phases) {
+		struct json_array *phases = json_create_array();
+
+		json_object_add_value_array(root, "phases", phases);
+		for (i = 0; i < ts->nr_phases; i++)
+			json_array_add_value_object(phases,
+				add_period_stat_json(ts, &ts->phases[i]));
+	}
+
 	/* Additional output if description is set */
 	if (strlen(ts->description))
 		json_object_add_value_string(root, "desc", ts->description);
@@ -1864,6 +2126,10 @@ static struct json_object *show_thread_status_json(struct thread_stat *ts,
 		}
 	}
 
+	if (ts->heatmap)
+		json_object_add_value_object(root, "lat_heatmap",
+					     lat_heatmap_json(ts->heatmap));
+
 	if (ts->ss_dur) {
 		struct json_object *data;
 		struct json_array *iops, *bw;
@@ -2079,6 +2345,49 @@ int alloc_clat_prio_stat_ddir(struct thread_stat *ts, enum fio_ddir ddir,
 	return 0;
 }
 
+/*
+ * Allocate the ilat histogram of a job. Like the clat_prio_stat arrays, it
+ * lives in smalloc memory.
+ */
+int alloc_ilat_plat(struct thread_stat *ts)
+{
+	ts->ilat_plat = scalloc(FIO_ILAT_PLAT_NR, sizeof(uint64_t));
+	if (!ts->ilat_plat) {
+		log_err("fio: failed to allocate ts ilat data\n");
+		return 1;
+	}
+
+	return 0;
+}
+
+void free_ilat_plat(struct thread_stat *ts)
+{
+	if (!ts)
+		return;
+
+	sfree(ts->ilat_plat);
+	ts->ilat_plat = NULL;
+}
+
+static void sum_ilat_plat(struct thread_stat *dst, struct thread_stat *src)
+{
+	int l, m;
+
+	if (!src->ilat_plat)
+		return;
+	if (!dst->ilat_plat && alloc_ilat_plat(dst))
+		return;
+
+	for (l = 0; l < DDIR_RWDIR_CNT; l++)
+		for (m = 0; m < FIO_IO_U_PLAT_NR; m++)
+			if (dst->unified_rw_rep != UNIFIED_MIXED)
+				dst->ilat_plat[l * FIO_IO_U_PLAT_NR + m] +=
+					src->ilat_plat[l * FIO_IO_U_PLAT_NR + m];
+			else
+				dst->ilat_plat[m] +=
+					src->ilat_plat[l * FIO_IO_U_PLAT_NR + m];
+}
+
 static int grow_clat_prio_stat(struct thread_stat *dst, enum fio_ddir ddir)
 {
 	int curr_len = dst->nr_clat_prio[ddir];
@@ -2248,6 +2557,36 @@ static int sum_clat_prio_stats(struct thread_stat *dst, struct thread_stat *src,
 	return sum_clat_prio_stats_src_multi_prio(dst, src, dst_ddir, src_ddir);
 }
 
+/*
+ * Periods of a group are summed up by index. Their percentiles can't be,
+ * so report the worst of them.
+ */
+static void sum_period_stats(struct period_stat *dst, uint32_t *dst_nr,
+			     struct period_stat *src, uint32_t src_nr)
+{
+	int i, j;
+
+	for (i = 0; i < src_nr; i++) {
+		struct period_stat *d = &dst[i];
+		struct period_stat *s = &src[i];
+
+		if (i >= *dst_nr) {
+			d->depth = s->depth;
+			d->start = s->start;
+		}
+		if (d->runtime < s->runtime)
+			d->runtime = s->runtime;
+		d->ios += s->ios;
+		d->bytes += s->bytes;
+		d->clat_sum += s->clat_sum;
+		for (j = 0; j < FIO_IO_U_LIST_MAX_LEN; j++)
+			if (d->clat_percentiles[j] < s->clat_percentiles[j])
+				d->clat_percentiles[j] = s->clat_percentiles[j];
+	}
+	if (*dst_nr < src_nr)
+		*dst_nr = src_nr;
+}
+
 void sum_thread_stats(struct thread_stat *dst, struct thread_stat *src)
 {
 	int k, l, m;
@@ -2257,6 +2596,7 @@ void sum_thread_stats(struct thread_stat *dst, struct thread_stat *src)
 			sum_stat(&dst->clat_stat[l], &src->clat_stat[l], false);
 			sum_stat(&dst->slat_stat[l], &src->slat_stat[l], false);
 			sum_stat(&dst->lat_stat[l], &src->lat_stat[l], false);
+			sum_stat(&dst->ilat_stat[l], &src->ilat_stat[l], false);
 			sum_stat(&dst->bw_stat[l], &src->bw_stat[l], true);
 			sum_stat(&dst->iops_stat[l], &src->iops_stat[l], true);
 			sum_clat_prio_stats(dst, src, l, l);
@@ -2269,6 +2609,7 @@ void sum_thread_stats(struct thread_stat *dst, struct thread_stat *src)
 			sum_stat(&dst->clat_stat[0], &src->clat_stat[l], false);
 			sum_stat(&dst->slat_stat[0], &src->slat_stat[l], false);
 			sum_stat(&dst->lat_stat[0], &src->lat_stat[l], false);
+			sum_stat(&dst->ilat_stat[0], &src->ilat_stat[l], false);
 			sum_stat(&dst->bw_stat[0], &src->bw_stat[l], true);
 			sum_stat(&dst->iops_stat[0], &src->iops_stat[l], true);
 			sum_clat_prio_stats(dst, src, 0, l);
@@ -2305,10 +2646,12 @@ void sum_thread_stats(struct thread_stat *dst, struct thread_stat *src)
 			dst->total_io_u[k] += src->total_io_u[k];
 			dst->short_io_u[k] += src->short_io_u[k];
 			dst->drop_io_u[k] += src->drop_io_u[k];
+			dst->timeout_io_u[k] += src->timeout_io_u[k];
 		} else {
 			dst->total_io_u[0] += src->total_io_u[k];
 			dst->short_io_u[0] += src->short_io_u[k];
 			dst->drop_io_u[0] += src->drop_io_u[k];
+			dst->timeout_io_u[0] += src->timeout_io_u[k];
 		}
 	}
 
@@ -2322,6 +2665,8 @@ void sum_thread_stats(struct thread_stat *dst, struct thread_stat *src)
 				else
 					dst->io_u_plat[k][0][m] += src->io_u_plat[k][l][m];
 
+	sum_ilat_plat(dst, src);
+
 	for (k = 0; k < FIO_IO_U_PLAT_NR; k++)
 		dst->io_u_sync_plat[k] += src->io_u_sync_plat[k];
 
@@ -2331,6 +2676,21 @@ void sum_thread_stats(struct thread_stat *dst, struct thread_stat *src)
 	dst->nr_zone_resets += src->nr_zone_resets;
 	dst->cachehit += src->cachehit;
 	dst->cachemiss += src->cachemiss;
+	dst->inline_complete += src->inline_complete;
+	dst->deferred_complete += src->deferred_complete;
+
+	if (dst->cycles_per_msec < src->cycles_per_msec)
+		dst->cycles_per_msec = src->cycles_per_msec;
+	for (k = 0; k < FIO_STAGE_NR; k++)
+		dst->stage_cycles[k] += src->stage_cycles[k];
+
+	for (k = 0; k < FIO_IO_U_SG_LAT_NR; k++)
+		sum_stat(&dst->sg_clat_stat[k], &src->sg_clat_stat[k], false);
+
+	sum_period_stats(dst->sweep_steps, &dst->nr_sweep_steps,
+			 src->sweep_steps, src->nr_sweep_steps);
+	sum_period_stats(dst->phases, &dst->nr_phases, src->phases,
+			 src->nr_phases);
 }
 
 void init_group_run_stat(struct group_run_stats *gs)
@@ -2350,10 +2710,14 @@ void init_thread_stat_min_vals(struct thread_stat *ts)
 		ts->clat_stat[i].min_val = ULONG_MAX;
 		ts->slat_stat[i].min_val = ULONG_MAX;
 		ts->lat_stat[i].min_val = ULONG_MAX;
+		ts->ilat_stat[i].min_val = ULONG_MAX;
 		ts->bw_stat[i].min_val = ULONG_MAX;
 		ts->iops_stat[i].min_val = ULONG_MAX;
 	}
 	ts->sync_stat.min_val = ULONG_MAX;
+
+	for (i = 0; i < FIO_IO_U_SG_LAT_NR; i++)
+		ts->sg_clat_stat[i].min_val = ULONG_MAX;
 }
 
 void init_thread_stat(struct thread_stat *ts)
@@ -2544,6 +2908,8 @@ void __show_run_stats(void)
 		}
 
 		ts->latency_depth = td->latency_qd;
+		if (td->o.stage_cycles)
+			ts->cycles_per_msec = fio_cycles_per_msec();
 		ts->latency_target = td->o.latency_target;
 		ts->latency_percentile = td->o.latency_percentile;
 		ts->latency_window = td->o.latency_window;
@@ -2553,6 +2919,9 @@ void __show_run_stats(void)
 			ts->block_infos[k] = td->ts.block_infos[k];
 
 		sum_thread_stats(ts, &td->ts);
+		if (td->offload_ts)
+			sum_thread_stats(ts, td->offload_ts);
+		lat_heatmap_sum(&ts->heatmap, td->ts.heatmap);
 
 		ts->members++;
 
@@ -2715,6 +3084,8 @@ void __show_run_stats(void)
 	for (i = 0; i < nr_ts; i++) {
 		ts = &threadstats[i];
 		free_clat_prio_stats(ts);
+		free_ilat_plat(ts);
+		lat_heatmap_free(ts->heatmap);
 	}
 	free(threadstats);
 	free(opt_lists);
@@ -2966,6 +3337,7 @@ void regrow_logs(struct thread_data *td)
 	regrow_log(td->slat_log);
 	regrow_log(td->clat_log);
 	regrow_log(td->clat_hist_log);
+	regrow_log(td->clat_pctile_log);
 	regrow_log(td->lat_log);
 	regrow_log(td->bw_log);
 	regrow_log(td->iops_log);
@@ -3089,6 +3461,7 @@ void reset_io_stats(struct thread_data *td)
 		reset_io_stat(&ts->clat_stat[i]);
 		reset_io_stat(&ts->slat_stat[i]);
 		reset_io_stat(&ts->lat_stat[i]);
+		reset_io_stat(&ts->ilat_stat[i]);
 		reset_io_stat(&ts->bw_stat[i]);
 		reset_io_stat(&ts->iops_stat[i]);
 
@@ -3097,6 +3470,7 @@ void reset_io_stats(struct thread_data *td)
 		ts->total_io_u[i] = 0;
 		ts->short_io_u[i] = 0;
 		ts->drop_io_u[i] = 0;
+		ts->timeout_io_u[i] = 0;
 	}
 
 	for (i = 0; i < FIO_LAT_CNT; i++)
@@ -3104,6 +3478,8 @@ void reset_io_stats(struct thread_data *td)
 			reset_io_u_plat(ts->io_u_plat[i][j]);
 
 	reset_clat_prio_stats(ts);
+	if (ts->ilat_plat)
+		memset(ts->ilat_plat, 0, FIO_ILAT_PLAT_NR * sizeof(uint64_t));
 
 	ts->total_io_u[DDIR_SYNC] = 0;
 	reset_io_u_plat(ts->io_u_sync_plat);
@@ -3125,6 +3501,13 @@ void reset_io_stats(struct thread_data *td)
 	ts->total_complete = 0;
 	ts->nr_zone_resets = 0;
 	ts->cachehit = ts->cachemiss = 0;
+	ts->inline_complete = ts->deferred_complete = 0;
+	memset(ts->stage_cycles, 0, sizeof(ts->stage_cycles));
+
+	for (i = 0; i < FIO_IO_U_SG_LAT_NR; i++)
+		reset_io_stat(&ts->sg_clat_stat[i]);
+
+	lat_heatmap_reset(ts->heatmap);
 }
 
 static void __add_stat_to_log(struct io_log *iolog, enum fio_ddir ddir,
@@ -3246,6 +3629,24 @@ void add_sync_clat_sample(struct thread_stat *ts, unsigned long long nsec)
 	add_stat_sample(&ts->sync_stat, nsec);
 }
 
+/*
+ * Offload workers pass in their own td, and account samples in their own
+ * td->ts without locking. The logs are shared by all workers of a job, so
+ * these are written through the job's td, under its io_u_lock.
+ */
+static inline struct thread_data *log_td(struct thread_data *td)
+{
+	return td->parent ? td->parent : td;
+}
+
+void add_sg_clat_sample(struct thread_data *td, unsigned int nr_segs,
+			unsigned long long nsec)
+{
+	int idx = min(__fls(nr_segs) - 1, FIO_IO_U_SG_LAT_NR - 1);
+
+	add_stat_sample(&td->ts.sg_clat_stat[idx], nsec);
+}
+
 static inline void add_lat_percentile_sample(struct thread_stat *ts,
 					     unsigned long long nsec,
 					     enum fio_ddir ddir,
@@ -3268,18 +3669,235 @@ add_lat_percentile_prio_sample(struct thread_stat *ts, unsigned long long nsec,
 		ts->clat_prio[ddir][clat_prio_index].io_u_plat[idx]++;
 }
 
+/*
+ * With offload, the workers keep updating their stats without a lock while
+ * other threads sum them here. Each value is loaded whole, but they aren't
+ * read as a consistent set: a completion may already be in the histogram
+ * and not yet in the mean, or the other way round. Windowed logs and
+ * periods are only approximate for that.
+ */
+static void plat_add_relaxed(uint64_t *dst, uint64_t *src)
+{
+	int i;
+
+	for (i = 0; i < FIO_IO_U_PLAT_NR; i++)
+		dst[i] += atomic_load_relaxed(&src[i]);
+}
+
+static void period_snapshot_ts(struct thread_stat *ts, uint64_t *plat,
+			       double *clat_sum)
+{
+	for_each_rw_ddir(ddir) {
+		struct io_stat *is = &ts->clat_stat[ddir];
+
+		plat_add_relaxed(plat, ts->io_u_plat[FIO_CLAT][ddir]);
+		*clat_sum += atomic_load_relaxed(&is->mean.u.f) *
+				atomic_load_relaxed(&is->samples);
+	}
+}
+
+/*
+ * Sum up the read/write/trim completion latency stats, so the results of a
+ * period can be taken as the difference between its start and end.
+ */
+static void period_snapshot(struct thread_data *td, uint64_t *plat,
+			    uint64_t *ios, uint64_t *bytes, double *clat_sum)
+{
+	struct thread_stat *ts;
+	unsigned int i;
+
+	memset(plat, 0, FIO_IO_U_PLAT_NR * sizeof(uint64_t));
+	*clat_sum = 0.0;
+	period_snapshot_ts(&td->ts, plat, clat_sum);
+	for (i = 0; (ts = rate_submit_worker_ts(td, i)); i++)
+		period_snapshot_ts(ts, plat, clat_sum);
+
+	*ios = ddir_rw_sum(td->io_blocks);
+	*bytes = ddir_rw_sum(td->io_bytes);
+}
+
+void period_stat_start(struct thread_data *td)
+{
+	if (!td->period_plat)
+		td->period_plat = malloc(FIO_IO_U_PLAT_NR * sizeof(uint64_t));
+
+	period_snapshot(td, td->period_plat, &td->period_ios,
+			&td->period_bytes, &td->period_clat_sum);
+	fio_gettime(&td->period_ts, NULL);
+	td->period_running = true;
+}
+
+void period_stat_end(struct thread_data *td, struct period_stat *ps)
+{
+	unsigned long long *ovals = NULL;
+	unsigned long long minv, maxv;
+	uint64_t plat[FIO_IO_U_PLAT_NR];
+	uint64_t ios, bytes, samples;
+	double clat_sum;
+	unsigned int i, len;
+
+	period_snapshot(td, plat, &ios, &bytes, &clat_sum);
+
+	memset(ps, 0, sizeof(*ps));
+	ps->start = mtime_since(&td->epoch, &td->period_ts);
+	ps->runtime = utime_since_now(&td->period_ts);
+	ps->ios = ios - td->period_ios;
+	ps->bytes = bytes - td->period_bytes;
+	if (clat_sum > td->period_clat_sum)
+		ps->clat_sum = clat_sum - td->period_clat_sum;
+
+	samples = 0;
+	for (i = 0; i < FIO_IO_U_PLAT_NR; i++) {
+		plat[i] -= td->period_plat[i];
+		samples += plat[i];
+	}
+	if (samples) {
+		len = calc_clat_percentiles(plat, samples,
+					    td->ts.percentile_list, &ovals,
+					    &maxv, &minv);
+		for (i = 0; i < len; i++)
+			ps->clat_percentiles[i] = ovals[i];
+		free(ovals);
+	}
+
+	td->period_running = false;
+}
+
+void add_ilat_sample(struct thread_data *td, enum fio_ddir ddir,
+		     unsigned long long nsec)
+{
+	struct thread_stat *ts = &td->ts;
+
+	add_stat_sample(&ts->ilat_stat[ddir], nsec);
+	if (ts->clat_percentiles && ts->ilat_plat) {
+		unsigned int idx = plat_val_to_idx(nsec);
+
+		assert(idx < FIO_IO_U_PLAT_NR);
+		ts->ilat_plat[ddir * FIO_IO_U_PLAT_NR + idx]++;
+	}
+}
+
+/*
+ * The completion latency histogram that the windowed logs of 'td' work
+ * from. With offload, it's spread over td->ts and those of the workers,
+ * see plat_add_relaxed().
+ */
+static uint64_t *log_clat_plat(struct thread_data *td, struct io_hist *hw,
+			       enum fio_ddir ddir)
+{
+	struct thread_stat *ts;
+	unsigned int i;
+
+	if (td->o.io_submit_mode != IO_MODE_OFFLOAD)
+		return td->ts.io_u_plat[FIO_CLAT][ddir];
+
+	if (!hw->plat_sum)
+		hw->plat_sum = malloc(FIO_IO_U_PLAT_NR * sizeof(uint64_t));
+
+	memset(hw->plat_sum, 0, FIO_IO_U_PLAT_NR * sizeof(uint64_t));
+	plat_add_relaxed(hw->plat_sum, td->ts.io_u_plat[FIO_CLAT][ddir]);
+	for (i = 0; (ts = rate_submit_worker_ts(td, i)); i++)
+		plat_add_relaxed(hw->plat_sum, ts->io_u_plat[FIO_CLAT][ddir]);
+
+	return hw->plat_sum;
+}
+
+/*
+ * Build a sparse histogram sample holding the buckets of 'cur' that moved
+ * since 'last', and bring 'last' up to date.
+ */
+static struct io_u_plat_delta *hist_delta(uint64_t *cur, uint64_t *last)
+{
+	struct io_u_plat_delta *d;
+	unsigned int i, nr = 0;
+
+	for (i = 0; i < FIO_IO_U_PLAT_NR; i++)
+		if (cur[i] != last[i])
+			nr++;
+
+	d = malloc(sizeof(*d) + nr * sizeof(d->bins[0]));
+	d->nr = 0;
+	for (i = 0; i < FIO_IO_U_PLAT_NR && d->nr < nr; i++) {
+		if (cur[i] == last[i])
+			continue;
+		d->bins[d->nr].idx = i;
+		d->bins[d->nr].val = cur[i] - last[i];
+		d->nr++;
+		last[i] = cur[i];
+	}
+
+	return d;
+}
+
+/*
+ * Log the percentile_list values of the completion latencies seen over the
+ * last log_percentiles_msec window, as one sample per percentile. They are
+ * taken from the difference between io_u_plat and a copy of it made at the
+ * end of the previous window, so no per-IO state is kept.
+ */
+static void add_clat_pctile_samples(struct thread_data *td,
+				    enum fio_ddir ddir)
+{
+	struct io_log *iolog = td->clat_pctile_log;
+	struct io_hist *hw = &iolog->hist_window[ddir];
+	fio_fp64_t *plist = td->ts.percentile_list;
+	uint64_t *io_u_plat;
+	unsigned long long nr = 0, sum = 0;
+	unsigned long elapsed, this_window;
+	unsigned int i, j, len, last = 0;
+
+	elapsed = mtime_since_now(&td->epoch);
+	if (!hw->hist_last)
+		hw->hist_last = elapsed;
+	this_window = elapsed - hw->hist_last;
+	if (this_window < iolog->hist_msec)
+		return;
+
+	io_u_plat = log_clat_plat(td, hw, ddir);
+
+	len = 0;
+	while (len < FIO_IO_U_LIST_MAX_LEN && plist[len].u.f != 0.0)
+		len++;
+	if (len > 1)
+		qsort(plist, len, sizeof(plist[0]), double_cmp);
+
+	for (i = 0; i < FIO_IO_U_PLAT_NR; i++) {
+		if (io_u_plat[i] == hw->plat_last[i])
+			continue;
+		nr += io_u_plat[i] - hw->plat_last[i];
+		last = i;
+	}
+
+	for (i = 0, j = 0; i <= last && j < len; i++) {
+		sum += io_u_plat[i] - hw->plat_last[i];
+		while (j < len &&
+		       sum >= ((long double) plist[j].u.f / 100.0 * nr)) {
+			__add_log_sample(iolog, sample_val(plat_idx_to_val(i)),
+					 ddir, j, elapsed, 0, len);
+			j++;
+		}
+	}
+
+	/* rounding may leave the top of the list unmatched */
+	for (; j < len; j++)
+		__add_log_sample(iolog, sample_val(plat_idx_to_val(last)),
+				 ddir, j, elapsed, 0, len);
+
+	memcpy(hw->plat_last, io_u_plat, FIO_IO_U_PLAT_NR * sizeof(uint64_t));
+	hw->hist_last = elapsed - (this_window - iolog->hist_msec);
+}
+
 void add_clat_sample(struct thread_data *td, enum fio_ddir ddir,
 		     unsigned long long nsec, unsigned long long bs,
 		     uint64_t offset, unsigned int ioprio,
 		     unsigned short clat_prio_index)
 {
-	const bool needs_lock = td_async_processing(td);
+	struct thread_data *ltd = log_td(td);
+	const bool needs_lock = td_async_processing(ltd);
+	uint64_t start = stage_start(td);
 	unsigned long elapsed, this_window;
 	struct thread_stat *ts = &td->ts;
-	struct io_log *iolog = td->clat_hist_log;
-
-	if (needs_lock)
-		__td_io_u_lock(td);
+	struct io_log *iolog = ltd->clat_hist_log;
 
 	add_stat_sample(&ts->clat_stat[ddir], nsec);
 
@@ -3296,10 +3914,6 @@ void add_clat_sample(struct thread_data *td, enum fio_ddir ddir,
 		add_stat_prio_sample(ts->clat_prio[ddir], clat_prio_index,
 				     nsec);
 
-	if (td->clat_log)
-		add_log_sample(td, td->clat_log, sample_val(nsec), ddir, bs,
-			       offset, ioprio);
-
 	if (ts->clat_percentiles) {
 		/*
 		 * Because of the above definition, add a prio lat percentile
@@ -3312,31 +3926,36 @@ void add_clat_sample(struct thread_data *td, enum fio_ddir ddir,
 						       clat_prio_index);
 	}
 
+	if (!ltd->clat_log && !iolog && !ltd->clat_pctile_log)
+		goto out;
+
+	if (needs_lock)
+		__td_io_u_lock(ltd);
+
+	if (ltd->clat_log)
+		add_log_sample(ltd, ltd->clat_log, sample_val(nsec), ddir, bs,
+			       offset, ioprio);
+
 	if (iolog && iolog->hist_msec) {
 		struct io_hist *hw = &iolog->hist_window[ddir];
 
 		hw->samples++;
-		elapsed = mtime_since_now(&td->epoch);
+		elapsed = mtime_since_now(&ltd->epoch);
 		if (!hw->hist_last)
 			hw->hist_last = elapsed;
 		this_window = elapsed - hw->hist_last;
 
 		if (this_window >= iolog->hist_msec) {
-			uint64_t *io_u_plat;
-			struct io_u_plat_entry *dst;
+			struct io_u_plat_delta *dst;
 
 			/*
-			 * Make a byte-for-byte copy of the latency histogram
-			 * stored in td->ts.io_u_plat[ddir], recording it in a
-			 * log sample. Note that the matching call to free() is
-			 * located in iolog.c after printing this sample to the
-			 * log file.
+			 * Record what changed in the clat histogram of ddir
+			 * since the last window in a log sample. Note that the
+			 * matching call to free() is located in iolog.c after
+			 * printing this sample to the log file.
 			 */
-			io_u_plat = (uint64_t *) td->ts.io_u_plat[FIO_CLAT][ddir];
-			dst = malloc(sizeof(struct io_u_plat_entry));
-			memcpy(&(dst->io_u_plat), io_u_plat,
-				FIO_IO_U_PLAT_NR * sizeof(uint64_t));
-			flist_add(&dst->list, &hw->list);
+			dst = hist_delta(log_clat_plat(ltd, hw, ddir),
+					 hw->plat_last);
 			__add_log_sample(iolog, sample_plat(dst), ddir, bs,
 					 elapsed, offset, ioprio);
 
@@ -3350,34 +3969,39 @@ void add_clat_sample(struct thread_data *td, enum fio_ddir ddir,
 		}
 	}
 
+	if (ltd->clat_pctile_log)
+		add_clat_pctile_samples(ltd, ddir);
+
 	if (needs_lock)
-		__td_io_u_unlock(td);
+		__td_io_u_unlock(ltd);
+out:
+	stage_end(td, FIO_STAGE_CLAT, start);
 }
 
 void add_slat_sample(struct thread_data *td, enum fio_ddir ddir,
 		     unsigned long long nsec, unsigned long long bs,
 		     uint64_t offset, unsigned int ioprio)
 {
-	const bool needs_lock = td_async_processing(td);
+	struct thread_data *ltd = log_td(td);
+	const bool needs_lock = td_async_processing(ltd);
 	struct thread_stat *ts = &td->ts;
 
 	if (!ddir_rw(ddir))
 		return;
 
-	if (needs_lock)
-		__td_io_u_lock(td);
-
 	add_stat_sample(&ts->slat_stat[ddir], nsec);
 
-	if (td->slat_log)
-		add_log_sample(td, td->slat_log, sample_val(nsec), ddir, bs,
-			       offset, ioprio);
-
 	if (ts->slat_percentiles)
 		add_lat_percentile_sample(ts, nsec, ddir, FIO_SLAT);
 
-	if (needs_lock)
-		__td_io_u_unlock(td);
+	if (ltd->slat_log) {
+		if (needs_lock)
+			__td_io_u_lock(ltd);
+		add_log_sample(ltd, ltd->slat_log, sample_val(nsec), ddir, bs,
+			       offset, ioprio);
+		if (needs_lock)
+			__td_io_u_unlock(ltd);
+	}
 }
 
 void add_lat_sample(struct thread_data *td, enum fio_ddir ddir,
@@ -3385,21 +4009,15 @@ void add_lat_sample(struct thread_data *td, enum fio_ddir ddir,
 		    uint64_t offset, unsigned int ioprio,
 		    unsigned short clat_prio_index)
 {
-	const bool needs_lock = td_async_processing(td);
+	struct thread_data *ltd = log_td(td);
+	const bool needs_lock = td_async_processing(ltd);
 	struct thread_stat *ts = &td->ts;
 
 	if (!ddir_rw(ddir))
 		return;
 
-	if (needs_lock)
-		__td_io_u_lock(td);
-
 	add_stat_sample(&ts->lat_stat[ddir], nsec);
 
-	if (td->lat_log)
-		add_log_sample(td, td->lat_log, sample_val(nsec), ddir, bs,
-			       offset, ioprio);
-
 	/*
 	 * When lat_percentiles=1 (default 0), the reported per priority
 	 * percentiles and stats are used for describing total latency values,
@@ -3416,15 +4034,22 @@ void add_lat_sample(struct thread_data *td, enum fio_ddir ddir,
 		add_stat_prio_sample(ts->clat_prio[ddir], clat_prio_index,
 				     nsec);
 	}
-	if (needs_lock)
-		__td_io_u_unlock(td);
+
+	if (ltd->lat_log) {
+		if (needs_lock)
+			__td_io_u_lock(ltd);
+		add_log_sample(ltd, ltd->lat_log, sample_val(nsec), ddir, bs,
+			       offset, ioprio);
+		if (needs_lock)
+			__td_io_u_unlock(ltd);
+	}
 }
 
 void add_bw_sample(struct thread_data *td, struct io_u *io_u,
 		   unsigned int bytes, unsigned long long spent)
 {
-	const bool needs_lock = td_async_processing(td);
-	struct thread_stat *ts = &td->ts;
+	struct thread_data *ltd = log_td(td);
+	const bool needs_lock = td_async_processing(ltd);
 	unsigned long rate;
 
 	if (spent)
@@ -3432,21 +4057,20 @@ void add_bw_sample(struct thread_data *td, struct io_u *io_u,
 	else
 		rate = 0;
 
-	if (needs_lock)
-		__td_io_u_lock(td);
+	add_stat_sample(&td->ts.bw_stat[io_u->ddir], rate);
 
-	add_stat_sample(&ts->bw_stat[io_u->ddir], rate);
+	if (needs_lock)
+		__td_io_u_lock(ltd);
 
-	if (td->bw_log)
-		add_log_sample(td, td->bw_log, sample_val(rate), io_u->ddir,
+	if (ltd->bw_log)
+		add_log_sample(ltd, ltd->bw_log, sample_val(rate), io_u->ddir,
 			       bytes, io_u->offset, io_u->ioprio);
 
-	td->stat_io_bytes[io_u->ddir] = td->this_io_bytes[io_u->ddir];
+	ltd->stat_io_bytes[io_u->ddir] = ltd->this_io_bytes[io_u->ddir];
 
 	if (needs_lock)
-		__td_io_u_unlock(td);
+		__td_io_u_unlock(ltd);
 }
-
 static int __add_samples(struct thread_data *td, struct timespec *parent_tv,
 			 struct timespec *t, unsigned int avg_time,
 			 uint64_t *this_io_bytes, uint64_t *stat_io_bytes,
@@ -3524,22 +4148,22 @@ static int add_bw_samples(struct thread_data *td, struct timespec *t)
 void add_iops_sample(struct thread_data *td, struct io_u *io_u,
 		     unsigned int bytes)
 {
-	const bool needs_lock = td_async_processing(td);
-	struct thread_stat *ts = &td->ts;
+	struct thread_data *ltd = log_td(td);
+	const bool needs_lock = td_async_processing(ltd);
 
-	if (needs_lock)
-		__td_io_u_lock(td);
+	add_stat_sample(&td->ts.iops_stat[io_u->ddir], 1);
 
-	add_stat_sample(&ts->iops_stat[io_u->ddir], 1);
+	if (needs_lock)
+		__td_io_u_lock(ltd);
 
-	if (td->iops_log)
-		add_log_sample(td, td->iops_log, sample_val(1), io_u->ddir,
+	if (ltd->iops_log)
+		add_log_sample(ltd, ltd->iops_log, sample_val(1), io_u->ddir,
 			       bytes, io_u->offset, io_u->ioprio);
 
-	td->stat_io_blocks[io_u->ddir] = td->this_io_blocks[io_u->ddir];
+	ltd->stat_io_blocks[io_u->ddir] = ltd->this_io_blocks[io_u->ddir];
 
 	if (needs_lock)
-		__td_io_u_unlock(td);
+		__td_io_u_unlock(ltd);
 }
 
 static int add_iops_samples(struct thread_data *td, struct timespec *t)
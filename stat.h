@@ -26,6 +26,12 @@ struct group_run_stats {
 #define FIO_IO_U_LAT_U_NR 10
 #define FIO_IO_U_LAT_M_NR 12
 
+/*
+ * Completion latency is also kept per number of iovec segments, bucketed
+ * by power of 2: 1, 2-3, 4-7, ... 1024.
+ */
+#define FIO_IO_U_SG_LAT_NR 11
+
 /*
  * Constants for clat percentiles
  */
@@ -33,9 +39,27 @@ struct group_run_stats {
 #define FIO_IO_U_PLAT_VAL (1 << FIO_IO_U_PLAT_BITS)
 #define FIO_IO_U_PLAT_GROUP_NR 29
 #define FIO_IO_U_PLAT_NR (FIO_IO_U_PLAT_GROUP_NR * FIO_IO_U_PLAT_VAL)
+#define FIO_ILAT_PLAT_NR (DDIR_RWDIR_CNT * FIO_IO_U_PLAT_NR)
 #define FIO_IO_U_LIST_MAX_LEN 20 /* The size of the default and user-specified
 					list of percentiles */
 
+#define IODEPTH_SWEEP_MAX	16	/* Max number of iodepth_sweep steps */
+#define FIO_PHASES_MAX		16	/* Max number of phases */
+
+/*
+ * Stages of the IO path that stage_cycles counts CPU cycles for. They
+ * nest: get_io_u includes fill_io_u, and reaping includes the completion
+ * latency accounting. Waiting for completions in the engine isn't counted.
+ */
+enum fio_stage {
+	FIO_STAGE_GET_IO_U = 0,
+	FIO_STAGE_FILL_IO_U,
+	FIO_STAGE_QUEUE,
+	FIO_STAGE_REAP,
+	FIO_STAGE_CLAT,
+	FIO_STAGE_NR,
+};
+
 /*
  * Aggregate latency samples for reporting percentile(s).
  *
@@ -163,6 +187,22 @@ struct clat_prio_stat {
 	uint32_t ioprio;
 };
 
+/*
+ * Results for one period of a job, an iodepth_sweep step or a phase
+ */
+struct period_stat {
+	uint32_t depth;
+	uint32_t pad;
+	uint64_t start;		/* msec since the job started */
+	uint64_t runtime;	/* usec */
+	uint64_t ios;
+	uint64_t bytes;
+	uint64_t clat_sum;	/* nsec, over all ios */
+	uint64_t clat_percentiles[FIO_IO_U_LIST_MAX_LEN];
+};
+
+struct lat_heatmap;
+
 struct thread_stat {
 	char name[FIO_JOBNAME_SIZE];
 	char verror[FIO_VERROR_SIZE];
@@ -215,6 +255,7 @@ struct thread_stat {
 	uint64_t total_io_u[DDIR_RWDIR_SYNC_CNT];
 	uint64_t short_io_u[DDIR_RWDIR_CNT];
 	uint64_t drop_io_u[DDIR_RWDIR_CNT];
+	uint64_t timeout_io_u[DDIR_RWDIR_CNT];
 	uint64_t total_submit;
 	uint64_t total_complete;
 
@@ -294,6 +335,56 @@ struct thread_stat {
 
 	uint64_t cachehit;
 	uint64_t cachemiss;
+
+	/*
+	 * With io_uring count_inline, submitted IOs that had completed by
+	 * the time the submit call returned, vs those that completed later,
+	 * either on the device or after a punt to io-wq.
+	 */
+	uint64_t inline_complete;
+	uint64_t deferred_complete;
+
+	struct io_stat sg_clat_stat[FIO_IO_U_SG_LAT_NR] __attribute__((aligned(8)));
+
+	/*
+	 * Latency measured from the intended arrival time of each IO, as
+	 * set by the rate schedule, rather than from when it was issued.
+	 */
+	struct io_stat ilat_stat[DDIR_RWDIR_CNT] __attribute__((aligned(8)));
+
+	/*
+	 * Percentile histogram of ilat, FIO_IO_U_PLAT_NR entries per ddir.
+	 * Only allocated for jobs with rate_open_loop.
+	 */
+	union {
+		uint64_t *ilat_plat;
+		/*
+		 * For FIO_NET_CMD_TS, the pointed to data will temporarily
+		 * be stored at this offset from the start of the payload.
+		 */
+		uint64_t ilat_plat_offset;
+		uint64_t pad10;
+	};
+
+	uint32_t nr_sweep_steps;
+	uint32_t pad7;
+	struct period_stat sweep_steps[IODEPTH_SWEEP_MAX] __attribute__((aligned(8)));
+
+	uint32_t nr_phases;
+	uint32_t pad8;
+	struct period_stat phases[FIO_PHASES_MAX] __attribute__((aligned(8)));
+
+	uint64_t cycles_per_msec;
+	uint64_t stage_cycles[FIO_STAGE_NR];
+
+	/*
+	 * Not sent over the network, a job's heatmap is only reported
+	 * where it ran.
+	 */
+	union {
+		struct lat_heatmap *heatmap;
+		uint64_t pad9;
+	};
 } __attribute__((packed));
 
 #define JOBS_ETA {							\
@@ -335,6 +426,18 @@ struct io_u_plat_entry {
 	uint64_t io_u_plat[FIO_IO_U_PLAT_NR];
 };
 
+/*
+ * Histogram log sample: only the buckets that changed since the previous
+ * window of the same direction, and by how much.
+ */
+struct io_u_plat_delta {
+	unsigned int nr;
+	struct {
+		uint32_t idx;
+		uint64_t val;
+	} bins[];
+};
+
 extern struct fio_sem *stat_sem;
 
 extern struct jobs_eta *get_jobs_eta(bool force, size_t *size);
@@ -379,8 +482,16 @@ extern void add_bw_sample(struct thread_data *, struct io_u *,
 				unsigned int, unsigned long long);
 extern void add_sync_clat_sample(struct thread_stat *ts,
 				unsigned long long nsec);
+extern void add_sg_clat_sample(struct thread_data *, unsigned int,
+				unsigned long long);
+extern void period_stat_start(struct thread_data *);
+extern void period_stat_end(struct thread_data *, struct period_stat *);
+extern void add_ilat_sample(struct thread_data *, enum fio_ddir,
+				unsigned long long);
 extern int calc_log_samples(void);
 extern void free_clat_prio_stats(struct thread_stat *);
+extern int alloc_ilat_plat(struct thread_stat *);
+extern void free_ilat_plat(struct thread_stat *);
 extern int alloc_clat_prio_stat_ddir(struct thread_stat *, enum fio_ddir, int);
 
 extern void print_disk_util(struct disk_util_stat *, struct disk_util_agg *, int terse, struct buf_output *);
@@ -0,0 +1,228 @@
+/*
+ * Worker pool for synchronous io engines, io_submit_mode=pool
+ *
+ * The job thread prepares, queues and reaps io_us as it would for an async
+ * engine. Each worker only takes a committed io_u off the submit list and
+ * runs the engine ->queue() on it against the job's own thread_data, so
+ * offsets, random map, files and statistics all stay with the job. Up to
+ * iodepth calls are in flight, one per worker.
+ */
+#include <assert.h>
+#include <limits.h>
+#include <pthread.h>
+
+#include "fio.h"
+#include "ioengines.h"
+#include "sync-pool.h"
+
+struct sync_pool {
+	pthread_mutex_t lock;
+	pthread_cond_t work_cond;
+	pthread_cond_t done_cond;
+
+	/*
+	 * Queued but not yet committed, only seen by the job thread
+	 */
+	struct flist_head pending;
+	unsigned int nr_pending;
+
+	/*
+	 * Committed io_us waiting for a worker, and completed ones
+	 * waiting to be reaped
+	 */
+	struct flist_head submit;
+	struct flist_head done;
+	unsigned int nr_done;
+
+	/*
+	 * Completions the job thread is waiting for, 0 if it isn't
+	 */
+	unsigned int wait_nr;
+
+	/*
+	 * Committed and not reaped yet, only seen by the job thread
+	 */
+	unsigned int in_flight;
+
+	struct io_u **events;
+
+	pthread_t *threads;
+	unsigned int nr_threads;
+	bool exit;
+};
+
+static void *sync_pool_thread(void *data)
+{
+	struct thread_data *td = data;
+	struct sync_pool *sp = td->sync_pool;
+	struct io_u *io_u;
+	enum fio_q_status ret;
+
+	pthread_mutex_lock(&sp->lock);
+	while (1) {
+		while (flist_empty(&sp->submit) && !sp->exit)
+			pthread_cond_wait(&sp->work_cond, &sp->lock);
+		if (flist_empty(&sp->submit))
+			break;
+
+		io_u = flist_first_entry(&sp->submit, struct io_u, work.list);
+		flist_del(&io_u->work.list);
+		pthread_mutex_unlock(&sp->lock);
+
+		ret = td->io_ops->queue(td, io_u);
+		assert(ret == FIO_Q_COMPLETED);
+
+		pthread_mutex_lock(&sp->lock);
+		flist_add_tail(&io_u->work.list, &sp->done);
+		if (++sp->nr_done == sp->wait_nr)
+			pthread_cond_signal(&sp->done_cond);
+	}
+	pthread_mutex_unlock(&sp->lock);
+
+	return NULL;
+}
+
+enum fio_q_status sync_pool_queue(struct thread_data *td, struct io_u *io_u)
+{
+	struct sync_pool *sp = td->sync_pool;
+
+	flist_add_tail(&io_u->work.list, &sp->pending);
+	sp->nr_pending++;
+	return FIO_Q_QUEUED;
+}
+
+/*
+ * Hand everything queued since the last commit to the workers
+ */
+void sync_pool_commit(struct thread_data *td)
+{
+	struct sync_pool *sp = td->sync_pool;
+	unsigned int nr = sp->nr_pending;
+
+	if (!nr)
+		return;
+
+	pthread_mutex_lock(&sp->lock);
+	flist_splice_tail_init(&sp->pending, &sp->submit);
+	if (nr == 1)
+		pthread_cond_signal(&sp->work_cond);
+	else
+		pthread_cond_broadcast(&sp->work_cond);
+	pthread_mutex_unlock(&sp->lock);
+
+	sp->nr_pending = 0;
+	sp->in_flight += nr;
+	io_u_mark_submit(td, nr);
+}
+
+int sync_pool_getevents(struct thread_data *td, unsigned int min,
+			unsigned int max, const struct timespec fio_unused *t)
+{
+	struct sync_pool *sp = td->sync_pool;
+	unsigned int nr = 0;
+
+	if (min > sp->in_flight)
+		min = sp->in_flight;
+
+	pthread_mutex_lock(&sp->lock);
+	if (sp->nr_done < min) {
+		sp->wait_nr = min;
+		while (sp->nr_done < min)
+			pthread_cond_wait(&sp->done_cond, &sp->lock);
+		sp->wait_nr = 0;
+	}
+
+	while (nr < max && !flist_empty(&sp->done)) {
+		sp->events[nr] = flist_first_entry(&sp->done, struct io_u,
+							work.list);
+		flist_del(&sp->events[nr]->work.list);
+		nr++;
+	}
+	sp->nr_done -= nr;
+	pthread_mutex_unlock(&sp->lock);
+
+	sp->in_flight -= nr;
+	return nr;
+}
+
+struct io_u *sync_pool_event(struct thread_data *td, int event)
+{
+	return td->sync_pool->events[event];
+}
+
+static void sync_pool_stop(struct sync_pool *sp)
+{
+	unsigned int i;
+
+	pthread_mutex_lock(&sp->lock);
+	sp->exit = true;
+	pthread_cond_broadcast(&sp->work_cond);
+	pthread_mutex_unlock(&sp->lock);
+
+	for (i = 0; i < sp->nr_threads; i++)
+		pthread_join(sp->threads[i], NULL);
+}
+
+int sync_pool_init(struct thread_data *td)
+{
+	struct sync_pool *sp;
+	pthread_attr_t attr;
+	unsigned int i;
+	int ret = 0;
+
+	sp = calloc(1, sizeof(*sp));
+	pthread_mutex_init(&sp->lock, NULL);
+	pthread_cond_init(&sp->work_cond, NULL);
+	pthread_cond_init(&sp->done_cond, NULL);
+	INIT_FLIST_HEAD(&sp->pending);
+	INIT_FLIST_HEAD(&sp->submit);
+	INIT_FLIST_HEAD(&sp->done);
+	sp->events = calloc(td->o.iodepth, sizeof(struct io_u *));
+	sp->threads = calloc(td->o.iodepth, sizeof(pthread_t));
+	td->sync_pool = sp;
+
+	/*
+	 * The workers only sit in a system call, a small stack does
+	 */
+	pthread_attr_init(&attr);
+	pthread_attr_setstacksize(&attr, 2 * PTHREAD_STACK_MIN);
+
+	for (i = 0; i < td->o.iodepth; i++) {
+		ret = pthread_create(&sp->threads[i], &attr, sync_pool_thread,
+					td);
+		if (ret) {
+			log_err("fio: sync pool thread creation failed: %s\n",
+					strerror(ret));
+			break;
+		}
+		sp->nr_threads++;
+	}
+
+	pthread_attr_destroy(&attr);
+
+	if (ret) {
+		sync_pool_exit(td);
+		td_verror(td, ret, "sync_pool_init");
+		return 1;
+	}
+
+	return 0;
+}
+
+void sync_pool_exit(struct thread_data *td)
+{
+	struct sync_pool *sp = td->sync_pool;
+
+	if (!sp)
+		return;
+
+	sync_pool_stop(sp);
+
+	pthread_cond_destroy(&sp->done_cond);
+	pthread_cond_destroy(&sp->work_cond);
+	pthread_mutex_destroy(&sp->lock);
+	free(sp->threads);
+	free(sp->events);
+	free(sp);
+	td->sync_pool = NULL;
+}
@@ -0,0 +1,12 @@
+#ifndef FIO_SYNC_POOL_H
+#define FIO_SYNC_POOL_H
+
+int sync_pool_init(struct thread_data *);
+void sync_pool_exit(struct thread_data *);
+enum fio_q_status sync_pool_queue(struct thread_data *, struct io_u *);
+void sync_pool_commit(struct thread_data *);
+int sync_pool_getevents(struct thread_data *, unsigned int, unsigned int,
+			const struct timespec *);
+struct io_u *sync_pool_event(struct thread_data *, int);
+
+#endif
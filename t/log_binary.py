@@ -0,0 +1,144 @@
+#!/usr/bin/env python3
+#
+# log_binary.py
+#
+# Test log_binary and tools/fio_binlog2csv. Uses null ioengine. Runs the
+# same sequential write job writing text and binary latency and bandwidth
+# logs, converts the binary logs back to text and compares them with the
+# text ones. Times and values differ between the two runs, so only the
+# direction, block size, offset and priority columns are compared.
+#
+# Expected result: 2048 entries in each log, the same in both
+# Buggy result: entries missing or out of order, columns misplaced, or
+#   the offset column missing or added
+#
+# USAGE
+# python log_binary.py [-f fio-executable]
+#
+# EXAMPLES
+# python t/log_binary.py
+# python t/log_binary.py -f ./fio
+#
+# REQUIREMENTS
+# Python 3.5+
+#
+# ===TEST MATRIX===
+#
+# With log_offset=0 and log_offset=1
+# With and without log_compression=10K
+
+import os
+import sys
+import argparse
+import subprocess
+
+FILESIZE = 8 * 1024 * 1024
+BS = 4096
+LOGS = ['clat', 'bw']
+
+
+def parse_args():
+    """Parse command-line arguments."""
+    parser = argparse.ArgumentParser()
+    parser.add_argument('-f', '--fio',
+                        help='path to fio executable (e.g., ./fio)')
+    return parser.parse_args()
+
+
+def run_fio(fio, prefix, log_binary, log_offset, log_compression):
+    for log in LOGS + ['lat', 'slat']:
+        filename = '{}_{}.log{}'.format(prefix, log,
+                                        '.bin' if log_binary else '')
+        if os.path.exists(filename):
+            os.remove(filename)
+
+    fio_args = [
+        '--name=job',
+        '--ioengine=null',
+        '--filesize={}'.format(FILESIZE),
+        '--bs={}'.format(BS),
+        '--rw=write',
+        '--iodepth=1',
+        '--write_lat_log={}'.format(prefix),
+        '--write_bw_log={}'.format(prefix),
+        '--per_job_logs=0',
+        '--log_offset={}'.format(log_offset),
+        '--log_binary={}'.format(log_binary),
+        ]
+    if log_compression:
+        fio_args.append('--log_compression=10K')
+
+    subprocess.check_output([fio] + fio_args)
+
+
+def binlog2csv(filename):
+    tool = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                        '../tools/fio_binlog2csv')
+    out = subprocess.check_output([sys.executable, tool, filename])
+    return out.decode()
+
+
+def log_entries(data):
+    return [x.split(', ') for x in data.split('\n') if len(x.strip()) != 0]
+
+
+def check_logs(text, binary, log_offset):
+    if len(text) != FILESIZE // BS:
+        print('wrong number of ios ({}) in text log; should be {}'.format(
+            len(text), FILESIZE // BS))
+        return False
+
+    if len(binary) != len(text):
+        print('binary log has {} entries, text log {}'.format(len(binary),
+                                                            len(text)))
+        return False
+
+    for line_number, (t, b) in enumerate(zip(text, binary)):
+        if len(t) != 5 + log_offset or t[2:] != b[2:]:
+            print('entry {} differs: text {}, binary {}'.format(
+                line_number, t, b))
+            return False
+    return True
+
+
+def main():
+    """Entry point for this script."""
+    args = parse_args()
+    if args.fio:
+        fio_path = args.fio
+    else:
+        fio_path = os.path.join(os.path.dirname(__file__), '../fio')
+        if not os.path.exists(fio_path):
+            fio_path = 'fio'
+    print("fio path is", fio_path)
+
+    passed_count = 0
+    failed_count = 0
+    for log_offset in [0, 1]:
+        for log_compression in [False, True]:
+            run_fio(fio_path, 'text', 0, log_offset, log_compression)
+            run_fio(fio_path, 'binary', 1, log_offset, log_compression)
+
+            passed = True
+            for log in LOGS:
+                with open('text_{}.log'.format(log), 'rt') as f:
+                    text = log_entries(f.read())
+                binary = binlog2csv('binary_{}.log.bin'.format(log))
+                binary = log_entries(binary)
+                if not check_logs(text, binary, log_offset):
+                    print('{} log mismatch'.format(log))
+                    passed = False
+
+            print('Test with log_offset={} log_compression={} {}'.format(
+                log_offset, log_compression, 'PASSED' if passed else 'FAILED'))
+            if passed:
+                passed_count += 1
+            else:
+                failed_count += 1
+
+    print('{} tests passed, {} failed'.format(passed_count, failed_count))
+
+    sys.exit(failed_count)
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,152 @@
+#!/usr/bin/env python3
+#
+# log_hist_sparse.py
+#
+# Test log_hist_sparse and tools/hist/fio-histo-log-decode.py. Uses null
+# ioengine. Runs the same rate limited job writing a dense (log_hist_sparse=0)
+# and a sparse (log_hist_sparse=1) histogram log, decodes both and compares
+# them. Latencies differ between the two runs, so the bin counts can't be
+# compared one to one; the check is that both decode to the same layout.
+#
+# Expected result: the decoded logs have the same windows, give or take the
+#   last one, each with the same direction, block size and number of bins,
+#   the sparse log only lists non-zero bins in increasing order, and the
+#   decoder leaves the dense log unchanged
+# Buggy result: lines missing, bins misplaced or dropped in the sparse log
+#
+# USAGE
+# python log_hist_sparse.py [-f fio-executable]
+#
+# EXAMPLES
+# python t/log_hist_sparse.py
+# python t/log_hist_sparse.py -f ./fio
+#
+# REQUIREMENTS
+# Python 3.5+
+#
+# ===TEST MATRIX===
+#
+# With log_hist_sparse=0 and log_hist_sparse=1
+
+import os
+import sys
+import argparse
+import subprocess
+
+LOG_HIST_MSEC = 100
+
+
+def parse_args():
+    """Parse command-line arguments."""
+    parser = argparse.ArgumentParser()
+    parser.add_argument('-f', '--fio',
+                        help='path to fio executable (e.g., ./fio)')
+    return parser.parse_args()
+
+
+def run_fio(fio, sparse):
+    fio_args = [
+        '--name=job',
+        '--ioengine=null',
+        '--size=64M',
+        '--bs=4K',
+        '--rw=randrw',
+        '--rate_iops=2000',
+        '--number_ios=4000',
+        '--write_hist_log=sparse{}'.format(sparse),
+        '--log_hist_msec={}'.format(LOG_HIST_MSEC),
+        '--log_hist_sparse={}'.format(sparse),
+        ]
+
+    subprocess.check_output([fio] + fio_args)
+    return 'sparse{}_clat_hist.1.log'.format(sparse)
+
+
+def decode_log(filename):
+    decoder = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                           '../tools/hist/fio-histo-log-decode.py')
+    out = subprocess.check_output([sys.executable, decoder, filename])
+    return [x.split(', ') for x in out.decode().split('\n') if x.strip()]
+
+
+def read_log(filename):
+    with open(filename, 'rt') as f:
+        return [x.rstrip('\n').split(', ') for x in f if x.strip()]
+
+
+def check_sparse(raw):
+    for line_number, vals in enumerate(raw):
+        last = -1
+        for pair in vals[4:]:
+            idx, count = map(int, pair.split(':'))
+            if idx <= last or idx >= int(vals[3]) or count == 0:
+                print('bad bin {} on line {} of sparse log'.format(
+                    pair, line_number))
+                return False
+            last = idx
+    return True
+
+
+def compare_logs(dense_raw, dense, sparse):
+    if dense != dense_raw:
+        print('decoding changed the dense log')
+        return False
+
+    if not dense:
+        print('dense log is empty')
+        return False
+
+    # the last window of either run may or may not make it in the log
+    if abs(len(dense) - len(sparse)) > 2:
+        print('dense log has {} lines, sparse log {}'.format(len(dense),
+                                                            len(sparse)))
+        return False
+
+    for line_number, (d, s) in enumerate(zip(dense, sparse)):
+        if d[1:3] != s[1:3] or len(d) != len(s):
+            print('line {} differs: dense {}, sparse {}'.format(
+                line_number, d[:3] + [len(d) - 3], s[:3] + [len(s) - 3]))
+            return False
+        if abs(int(d[0]) - int(s[0])) > LOG_HIST_MSEC:
+            print('line {} time differs: dense {}, sparse {}'.format(
+                line_number, d[0], s[0]))
+            return False
+    return True
+
+
+def main():
+    """Entry point for this script."""
+    args = parse_args()
+    if args.fio:
+        fio_path = args.fio
+    else:
+        fio_path = os.path.join(os.path.dirname(__file__), '../fio')
+        if not os.path.exists(fio_path):
+            fio_path = 'fio'
+    print("fio path is", fio_path)
+
+    dense_log = run_fio(fio_path, 0)
+    sparse_log = run_fio(fio_path, 1)
+
+    passed_count = 0
+    failed_count = 0
+    tests = [
+        ('sparse log format', lambda: check_sparse(read_log(sparse_log))),
+        ('decoded logs match', lambda: compare_logs(read_log(dense_log),
+                                                    decode_log(dense_log),
+                                                    decode_log(sparse_log))),
+        ]
+    for name, test in tests:
+        passed = test()
+        print('Test {} {}'.format(name, 'PASSED' if passed else 'FAILED'))
+        if passed:
+            passed_count += 1
+        else:
+            failed_count += 1
+
+    print('{} tests passed, {} failed'.format(passed_count, failed_count))
+
+    sys.exit(failed_count)
+
+if __name__ == '__main__':
+    main()
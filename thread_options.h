@@ -167,6 +167,9 @@ struct thread_options {
 	unsigned int log_avg_msec;
 	unsigned int log_hist_msec;
 	unsigned int log_hist_coarseness;
+	unsigned int log_hist_sparse;
+	unsigned int log_pctile_msec;
+	unsigned int log_binary;
 	unsigned int log_max;
 	unsigned int log_offset;
 	unsigned int log_gz;
@@ -224,6 +227,8 @@ struct thread_options {
 	unsigned long long lockmem;
 	enum fio_memtype mem_type;
 	unsigned int mem_align;
+	unsigned int sg_segments;
+	unsigned int sg_segment_size;
 
 	unsigned long long max_latency[DDIR_RWDIR_CNT];
 
@@ -322,6 +327,9 @@ struct thread_options {
 	unsigned int rate_iops_min[DDIR_RWDIR_CNT];
 	unsigned int rate_process;
 	unsigned int rate_ign_think;
+	unsigned int rate_burst_on;
+	unsigned int rate_burst_off;
+	unsigned int rate_open_loop;
 
 	char *ioscheduler;
 
@@ -357,6 +365,19 @@ struct thread_options {
 	fio_fp64_t latency_percentile;
 	uint32_t latency_run;
 
+	unsigned int iodepth_sweep[IODEPTH_SWEEP_MAX];
+	unsigned int iodepth_sweep_nr;
+	unsigned long long iodepth_sweep_time;
+
+	char *phases;
+
+	unsigned int stage_cycles;
+
+	unsigned int create_threads;
+
+	unsigned int lat_heatmap;
+	char *lat_heatmap_file;
+
 	/*
 	 * flow support
 	 */
@@ -540,6 +561,8 @@ struct thread_options_pack {
 	uint32_t zone_skip_nz;
 	uint32_t mem_type;
 	uint32_t mem_align;
+	uint32_t sg_segments;
+	uint32_t sg_segment_size;
 
 	uint32_t exit_what;
 	uint32_t stonewall;
@@ -636,6 +659,10 @@ struct thread_options_pack {
 	uint32_t rate_iops_min[DDIR_RWDIR_CNT];
 	uint32_t rate_process;
 	uint32_t rate_ign_think;
+	uint32_t rate_burst_on;
+	uint32_t rate_burst_off;
+	uint32_t rate_open_loop;
+	uint32_t pad6;
 
 	uint8_t ioscheduler[FIO_TOP_STR_MAX];
 
@@ -670,6 +697,20 @@ struct thread_options_pack {
 	fio_fp64_t latency_percentile;
 	uint32_t latency_run;
 
+	uint32_t iodepth_sweep[IODEPTH_SWEEP_MAX];
+	uint32_t iodepth_sweep_nr;
+	uint64_t iodepth_sweep_time;
+
+	uint8_t phases[FIO_TOP_STR_MAX];
+	uint8_t lat_heatmap_file[FIO_TOP_STR_MAX];
+
+	uint32_t stage_cycles;
+	uint32_t create_threads;
+	uint32_t log_hist_sparse;
+	uint32_t log_binary;
+	uint32_t log_pctile_msec;
+	uint32_t lat_heatmap;
+
 	/*
 	 * flow support
 	 */
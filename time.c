@@ -23,6 +23,14 @@ void timespec_add_msec(struct timespec *ts, unsigned int msec)
 	}
 }
 
+void timespec_add_usec(struct timespec *ts, uint64_t usec)
+{
+	uint64_t nsec = ts->tv_nsec + 1000ULL * usec;
+
+	ts->tv_sec += nsec / 1000000000;
+	ts->tv_nsec = nsec % 1000000000;
+}
+
 /*
  * busy looping version for the last few usec
  */
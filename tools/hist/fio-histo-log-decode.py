@@ -0,0 +1,52 @@
+#!/usr/bin/env python3
+""" Expand a sparse fio histogram log (log_hist_sparse=1) into the dense
+    format that fiologparser_hist.py and the other tools here expect.
+    Example usage:
+
+        $ fio-histo-log-decode.py output_clat_hist.1.log > dense_clat_hist.1.log
+
+    Each sparse line holds the time, direction and block size of the sample,
+    the number of bins in the histogram and an index:count pair for every bin
+    that isn't zero:
+
+        1000, 0, 4096, 1856, 54:2, 55:26, 56:151
+
+    Dense lines are passed through unchanged, so the output of a job that
+    didn't use log_hist_sparse can be fed in as well. Bins may optionally be
+    merged further, as with half-bins.py.
+"""
+import sys
+
+def decode(line):
+    vals = line.rstrip('\n').split(', ')
+    if len(vals) > 4 and ':' not in vals[4]:
+        return vals[:3], list(map(int, vals[3:]))
+
+    hist = [0] * int(vals[3])
+    for pair in vals[4:]:
+        idx, count = pair.split(':')
+        hist[int(idx)] += int(count)
+    return vals[:3], hist
+
+def main(ctx):
+    stride = 1 << ctx.coarseness
+    fp = sys.stdin if ctx.FILENAME == '-' else open(ctx.FILENAME, 'r')
+    for line in fp:
+        if not line.strip():
+            continue
+        head, hist = decode(line)
+        bins = [sum(hist[i : i + stride]) for i in range(0, len(hist), stride)]
+        sys.stdout.write(', '.join(head + list(map(str, bins))) + '\n')
+
+if __name__ == '__main__':
+    import argparse
+    p = argparse.ArgumentParser()
+    arg = p.add_argument
+    arg('FILENAME', help='clat_hist file to decode, or - for stdin.')
+    arg('-c', '--coarseness',
+       default=0,
+       type=int,
+       help='number of times to reduce number of bins by half, '
+            'e.g. coarseness of 4 merges each 2^4 = 16 consecutive '
+            'bins.')
+    main(p.parse_args())
@@ -54,7 +54,7 @@ bool get_next_trim(struct thread_data *td, struct io_u *io_u)
 		}
 	}
 
-	get_file(io_u->file);
+	get_file(td, io_u->file);
 	assert(fio_file_open(io_u->file));
 	io_u->ddir = DDIR_TRIM;
 	io_u->xfer_buf = NULL;
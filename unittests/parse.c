@@ -0,0 +1,114 @@
+/*
+ * Check that option lookups through the hash of the main option table
+ * return the same entry as a linear scan of the table.
+ */
+#include <stddef.h>
+#include <string.h>
+
+#include "../parse.h"
+#include "../options.h"
+#include "../optgroup.h"
+#include "./unittest.h"
+
+/*
+ * First supported entry whose name or alias is opt, what find_option() did
+ * before the table was hashed.
+ */
+static const struct fio_option *scan_option(const char *opt)
+{
+	const struct fio_option *o;
+
+	for (o = &fio_options[0]; o->name; o++) {
+		if (o->type == FIO_OPT_UNSUPPORTED)
+			continue;
+		if (!strcmp(o->name, opt) || (o->alias && !strcmp(o->alias, opt)))
+			return o;
+	}
+
+	return NULL;
+}
+
+static void check_lookup(const char *opt)
+{
+	const struct fio_option *o = scan_option(opt);
+
+	CU_ASSERT_PTR_EQUAL(find_option(fio_options, opt), o);
+	CU_ASSERT_PTR_EQUAL(find_option_c(fio_options, opt), o);
+}
+
+static int init_parse(void)
+{
+	options_init(fio_options);
+	options_hash_init(fio_options);
+	return 0;
+}
+
+/*
+ * Every name and alias in the table, including the ones that are listed
+ * more than once or are FIO_OPT_UNSUPPORTED in this build.
+ */
+static void test_parse_names(void)
+{
+	const struct fio_option *o;
+
+	for (o = &fio_options[0]; o->name; o++) {
+		check_lookup(o->name);
+		if (o->alias)
+			check_lookup(o->alias);
+	}
+}
+
+static void test_parse_missing(void)
+{
+	CU_ASSERT_PTR_NULL(find_option(fio_options, "no_such_option"));
+	CU_ASSERT_PTR_NULL(find_option_c(fio_options, ""));
+	CU_ASSERT_PTR_NULL(find_option_c(fio_options, "bs="));
+}
+
+/*
+ * Options appended by add_option(), one new and one reusing the name of an
+ * existing entry, which must still be found first.
+ */
+static void test_parse_add_option(void)
+{
+	struct fio_option new_opt = {
+		.name		= "unittest_parse_opt",
+		.type		= FIO_OPT_STR_SET,
+		.category	= FIO_OPT_C_PROFILE,
+		.group		= FIO_OPT_G_INVALID,
+	};
+	struct fio_option dup_opt = new_opt;
+
+	dup_opt.name = "bs";
+
+	CU_ASSERT_EQUAL(add_option(&new_opt), 0);
+	CU_ASSERT_EQUAL(add_option(&dup_opt), 0);
+
+	check_lookup("unittest_parse_opt");
+	check_lookup("bs");
+	CU_ASSERT_PTR_NOT_NULL(find_option(fio_options, "unittest_parse_opt"));
+	test_parse_names();
+}
+
+static struct fio_unittest_entry tests[] = {
+	{
+		.name	= "parse/names",
+		.fn	= test_parse_names,
+	},
+	{
+		.name	= "parse/missing",
+		.fn	= test_parse_missing,
+	},
+	{
+		.name	= "parse/add_option",
+		.fn	= test_parse_add_option,
+	},
+	{
+		.name	= NULL,
+	},
+};
+
+CU_ErrorCode fio_unittest_parse(void)
+{
+	return fio_unittest_add_suite("parse.c", init_parse, NULL, tests);
+}
@@ -736,7 +736,7 @@ int verify_io_u_async(struct thread_data *td, struct io_u **io_u_ptr)
 		put_file_log(td, io_u->file);
 
 	if (io_u->flags & IO_U_F_IN_CUR_DEPTH) {
-		td->cur_depth--;
+		td_cur_depth_dec(td);
 		io_u_clear(td, io_u, IO_U_F_IN_CUR_DEPTH);
 	}
 	flist_add_tail(&io_u->verify_list, &td->verify_list);
@@ -1353,7 +1353,7 @@ int get_next_verify(struct thread_data *td, struct io_u *io_u)
 			}
 		}
 
-		get_file(ipo->file);
+		get_file(td, ipo->file);
 		assert(fio_file_open(io_u->file));
 		io_u->ddir = DDIR_READ;
 		io_u->xfer_buf = io_u->buf;
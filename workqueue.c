@@ -224,12 +224,6 @@ static void free_worker(struct submit_worker *sw, unsigned int *sum_cnt)
 		wq->ops.free_worker_fn(sw);
 }
 
-static void shutdown_worker(struct submit_worker *sw, unsigned int *sum_cnt)
-{
-	pthread_join(sw->thread, NULL);
-	free_worker(sw, sum_cnt);
-}
-
 void workqueue_exit(struct workqueue *wq)
 {
 	unsigned int shutdown, sum_cnt = 0;
@@ -248,6 +242,13 @@ void workqueue_exit(struct workqueue *wq)
 		pthread_mutex_unlock(&sw->lock);
 	}
 
+	/*
+	 * Join all workers before freeing any of them, a worker may look at
+	 * the state of the others until it exits.
+	 */
+	for (i = 0; i < wq->max_workers; i++)
+		pthread_join(wq->workers[i].thread, NULL);
+
 	do {
 		shutdown = 0;
 		for (i = 0; i < wq->max_workers; i++) {
@@ -257,7 +258,7 @@ void workqueue_exit(struct workqueue *wq)
 			pthread_mutex_lock(&sw->lock);
 			sw->flags |= SW_F_ACCOUNTED;
 			pthread_mutex_unlock(&sw->lock);
-			shutdown_worker(sw, &sum_cnt);
+			free_worker(sw, &sum_cnt);
 			shutdown++;
 		}
 	} while (shutdown && shutdown != wq->max_workers);
@@ -291,13 +292,15 @@ static int start_worker(struct workqueue *wq, unsigned int index,
 			return ret;
 	}
 
+	/*
+	 * Must be set before the worker runs, or we could clear the
+	 * SW_F_RUNNING it sets and wait for it forever in workqueue_init()
+	 */
+	sw->flags = SW_F_IDLE;
+
 	ret = pthread_create(&sw->thread, NULL, worker_thread, sw);
-	if (!ret) {
-		pthread_mutex_lock(&sw->lock);
-		sw->flags = SW_F_IDLE;
-		pthread_mutex_unlock(&sw->lock);
+	if (!ret)
 		return 0;
-	}
 
 	free_worker(sw, NULL);
 	return 1;
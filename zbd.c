@@ -120,7 +120,7 @@ static void zone_lock(struct thread_data *td, const struct fio_file *f,
 	 * zones unlocked.
 	 */
 	if (pthread_mutex_trylock(&z->mutex) != 0) {
-		if (!td_ioengine_flagged(td, FIO_SYNCIO))
+		if (!td_ioengine_flagged(td, FIO_SYNCIO) || td->sync_pool)
 			io_u_quiesce(td);
 		pthread_mutex_lock(&z->mutex);
 	}